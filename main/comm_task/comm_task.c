@@ -7,13 +7,34 @@
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "mqtt_client.h"
 #include "../queue_manager/queue_manager.h"
 #include "../json_protocol/json_protocol.h"
+#include "../telemetry_buffer/telemetry_buffer.h"
+#include "../telemetry_spool/telemetry_spool.h"
+#include "../mpu6050/mpu6050.h"
+#include "../i2c_bus/i2c_bus.h"
+#include "../input_latency/input_latency.h"
 #include "../config.h"
 
 static const char *TAG = "COMM";
 
+// Default telemetry wire format (override in config.h)
+#ifndef TELEMETRY_FORMAT
+#define TELEMETRY_FORMAT TELEMETRY_FORMAT_JSON
+#endif
+
+// Binary telemetry goes to a topic suffix so dashboards can tell formats apart
+#ifndef MQTT_TOPIC_TELEMETRY_CBOR
+#define MQTT_TOPIC_TELEMETRY_CBOR MQTT_TOPIC_TELEMETRY "/cbor"
+#endif
+
+// Binary accelerometer traces captured on movement alarms
+#ifndef MQTT_TOPIC_TRACE
+#define MQTT_TOPIC_TRACE MQTT_TOPIC_TELEMETRY "/trace"
+#endif
+
 // WiFi connection status
 #define WIFI_CONNECTED_BIT BIT0
 static EventGroupHandle_t wifi_event_group = NULL;
@@ -25,285 +46,424 @@ static volatile bool mqtt_connected = false;
 // Track initialization state
 static bool netif_initialized = false;
 
-// JSON buffer
-#define JSON_BUFFER_SIZE 256
-
-// Ring buffer for event buffering
-#define EVENT_BUFFER_SIZE 10
-
-typedef struct {
-    event_t event;
-    int msg_id;        // MQTT message ID for tracking delivery
-    bool pending;      // true if published but not confirmed
-    TickType_t timestamp; // Tick count when published (for timeout detection, wrap-safe)
-} buffered_event_t;
-
-typedef struct {
-    buffered_event_t events[EVENT_BUFFER_SIZE];
-    int head;   // Next write position
-    int tail;   // Next read position
-    int count;  // Number of events in buffer
-} event_ring_buffer_t;
-
-static event_ring_buffer_t event_buffer = {
-    .head = 0,
-    .tail = 0,
-    .count = 0
-};
-
-// Mutex for thread-safe access to event buffer
+// Wire format for newly serialized events (changed by set_format command)
+static volatile telemetry_format_t telemetry_format = TELEMETRY_FORMAT;
+
+// Batching: coalesce events arriving within a window into one MQTT message
+// (override in config.h)
+#ifndef TELEMETRY_BATCHING
+#define TELEMETRY_BATCHING 0
+#endif
+#ifndef TELEMETRY_BATCH_WINDOW_MS
+#define TELEMETRY_BATCH_WINDOW_MS 20
+#endif
+#ifndef TELEMETRY_BATCH_MAX_BYTES
+#define TELEMETRY_BATCH_MAX_BYTES 1024
+#endif
+// Every event must fit a buffer slot, or it is dropped when serialized
+_Static_assert(TELEMETRY_PAYLOAD_SIZE >= EVENT_JSON_MAX_SIZE, "TELEMETRY_PAYLOAD_SIZE too small for a calibration event");
+// A batch must hold at least one event, or the oldest would never be sent
+_Static_assert(TELEMETRY_BATCH_MAX_BYTES >= TELEMETRY_PAYLOAD_SIZE + TELEMETRY_BATCH_OVERHEAD,
+               "TELEMETRY_BATCH_MAX_BYTES too small for one event");
+
+// Queue and I2C bus statistics period, 0 disables (override in config.h)
+#ifndef QUEUE_STATS_INTERVAL_MS
+#define QUEUE_STATS_INTERVAL_MS 60000
+#endif
+
+// Pending events older than this are republished
+#define PENDING_TIMEOUT_MS 10000
+
+// Mutex for thread-safe access to the telemetry buffer and flash spool
+// (comm_task buffers and publishes; the MQTT task only marks deliveries)
 static SemaphoreHandle_t event_buffer_mutex = NULL;
 
+// Sequence number for the next event (continues from the spool after reboot)
+static uint32_t next_event_seq = 0;
+
+// Events evicted from RAM without reaching the spool
+static uint32_t ram_dropped = 0;
+
+// Set on disconnect: RAM-only events are written to the spool by comm_task
+static volatile bool spool_ram_requested = false;
+
+static const char *telemetry_topic(telemetry_format_t format)
+{
+    return (format == TELEMETRY_FORMAT_CBOR) ? MQTT_TOPIC_TELEMETRY_CBOR : MQTT_TOPIC_TELEMETRY;
+}
+
 // ============================================================================
-// Ring Buffer Functions
+// Buffer Functions
 // ============================================================================
 
-static int buffer_event(const event_t *event, int msg_id, bool pending)
+static bool buffer_event(const char *payload, int len, telemetry_format_t format)
 {
-    int buffered_index = -1;
+    if (len <= 0 || len > TELEMETRY_PAYLOAD_SIZE) {
+        ESP_LOGE(TAG, "Payload size %d not bufferable", len);
+        return false;
+    }
+
+    telemetry_entry_t entry;
+    memcpy(entry.payload, payload, len);
+    entry.payload_len = (uint16_t)len;
+    entry.format = format;
+    entry.spool_ref = TELEMETRY_SPOOL_REF_NONE;
     
-    if (xSemaphoreTake(event_buffer_mutex, portMAX_DELAY) == pdTRUE) {
-        if (event_buffer.count >= EVENT_BUFFER_SIZE) {
-            ESP_LOGW(TAG, "Buffer full, overwriting oldest event");
-            // Advance tail to overwrite oldest event
-            event_buffer.tail = (event_buffer.tail + 1) % EVENT_BUFFER_SIZE;
-            event_buffer.count--;
+    if (xSemaphoreTake(event_buffer_mutex, portMAX_DELAY) != pdTRUE) {
+        return false;
+    }
+
+    entry.seq = next_event_seq++;
+
+    // Offline, behind older spooled events, or RAM full: persist to flash so
+    // delivery order is kept and a reboot does not lose the event
+    bool spooled = false;
+    if (telemetry_spool_available() &&
+        (!mqtt_connected || telemetry_spool_has_unread() || telemetry_buffer_full())) {
+        spooled = telemetry_spool_append(&entry);
+    }
+
+    telemetry_entry_t evicted;
+    bool was_evicted = false;
+    if (!spooled) {
+        was_evicted = telemetry_buffer_add(&entry, &evicted);
+        if (was_evicted) {
+            ram_dropped++;
+            if (evicted.spool_ref != TELEMETRY_SPOOL_REF_NONE) {
+                telemetry_spool_consume(evicted.spool_ref, evicted.seq);
+            }
         }
+    }
+    int count = spooled ? telemetry_spool_count() : telemetry_buffer_count();
 
-        // Copy event to buffer with tracking info
-        buffered_index = event_buffer.head;
-        memcpy(&event_buffer.events[buffered_index].event, event, sizeof(event_t));
-        event_buffer.events[buffered_index].msg_id = msg_id;
-        event_buffer.events[buffered_index].pending = pending;
-        event_buffer.events[buffered_index].timestamp = xTaskGetTickCount();
-        event_buffer.head = (event_buffer.head + 1) % EVENT_BUFFER_SIZE;
-        event_buffer.count++;
-
-        ESP_LOGI(TAG, "Event buffered (buffer: %d/%d, msg_id=%d, pending=%d)", 
-                 event_buffer.count, EVENT_BUFFER_SIZE, msg_id, pending);
-        
-        xSemaphoreGive(event_buffer_mutex);
+    xSemaphoreGive(event_buffer_mutex);
+
+    if (was_evicted) {
+        ESP_LOGW(TAG, "Buffer full, dropped oldest event (seq=%lu)", (unsigned long)evicted.seq);
     }
-    
-    return buffered_index;
+    if (spooled) {
+        ESP_LOGI(TAG, "Event spooled to flash (spool: %d, seq=%lu)", count, (unsigned long)entry.seq);
+    } else {
+        ESP_LOGI(TAG, "Event buffered (buffer: %d/%d, seq=%lu)",
+                 count, telemetry_buffer_capacity(), (unsigned long)entry.seq);
+    }
+    return true;
 }
 
-static int find_next_non_pending_event(event_t *event)
+// Delivered events that came from the flash spool are marked consumed there
+static void consume_spooled(const telemetry_entry_t *entry)
+{
+    if (entry->spool_ref != TELEMETRY_SPOOL_REF_NONE) {
+        telemetry_spool_consume(entry->spool_ref, entry->seq);
+    }
+}
+
+static void mark_event_delivered(int msg_id)
 {
-    int found_index = -1;
-    
     if (xSemaphoreTake(event_buffer_mutex, portMAX_DELAY) == pdTRUE) {
-        // Find first non-pending event
-        for (int i = 0; i < event_buffer.count; i++) {
-            int index = (event_buffer.tail + i) % EVENT_BUFFER_SIZE;
-            if (!event_buffer.events[index].pending) {
-                // Copy event from buffer (but don't remove it yet)
-                memcpy(event, &event_buffer.events[index].event, sizeof(event_t));
-                found_index = index;
-                break;
-            }
-        }
-        
+        // A batch shares one msg_id, so every event published under it is delivered
+        int delivered = telemetry_buffer_ack(msg_id, consume_spooled);
+        int remaining = telemetry_buffer_count();
         xSemaphoreGive(event_buffer_mutex);
+
+        if (delivered > 0) {
+            ESP_LOGI(TAG, "Marked %d event(s) as delivered (msg_id=%d, remaining: %d)",
+                     delivered, msg_id, remaining);
+        }
     }
-    
-    return found_index;
 }
 
-static void mark_event_pending(int index, int msg_id)
+// Move spooled events into RAM for publishing, oldest first, keeping half
+// the buffer free for new events. Caller must hold event_buffer_mutex.
+static void import_spooled_locked(void)
 {
+    telemetry_entry_t entry;
+    int limit = (telemetry_buffer_capacity() + 1) / 2;
+    while (telemetry_buffer_count() < limit && telemetry_spool_read_next(&entry)) {
+        telemetry_buffer_add(&entry, NULL);
+    }
+}
+
+// Write staged spool records once they have waited TELEMETRY_SPOOL_FLUSH_MS
+static void sync_spool(void)
+{
+    if (!telemetry_spool_available()) {
+        return;
+    }
     if (xSemaphoreTake(event_buffer_mutex, portMAX_DELAY) == pdTRUE) {
-        event_buffer.events[index].msg_id = msg_id;
-        event_buffer.events[index].pending = true;
-        event_buffer.events[index].timestamp = xTaskGetTickCount();
-        ESP_LOGI(TAG, "Marked event as pending (index=%d, msg_id=%d, buffer: %d/%d)",
-                 index, msg_id, event_buffer.count, EVENT_BUFFER_SIZE);
+        telemetry_spool_sync();
         xSemaphoreGive(event_buffer_mutex);
     }
 }
 
-static bool has_buffered_events(void)
+static int ram_spooled;
+
+static void spool_ram_entry(telemetry_entry_t *entry)
 {
-    bool has_events = false;
-    
+    if (entry->spool_ref == TELEMETRY_SPOOL_REF_NONE &&
+        telemetry_spool_append_imported(entry, &entry->spool_ref)) {
+        ram_spooled++;
+    }
+}
+
+// After a disconnect, copy events held only in RAM to the spool so a reboot
+// before reconnecting does not lose them. They stay in RAM for publishing;
+// the PUBACK consumes the spool copy.
+static void spool_ram_events(void)
+{
+    if (!spool_ram_requested || !telemetry_spool_available()) {
+        return;
+    }
+    spool_ram_requested = false;
     if (xSemaphoreTake(event_buffer_mutex, portMAX_DELAY) == pdTRUE) {
-        has_events = (event_buffer.count > 0);
+        ram_spooled = 0;
+        telemetry_buffer_for_each(spool_ram_entry);
+        int spooled = ram_spooled;
         xSemaphoreGive(event_buffer_mutex);
+
+        if (spooled > 0) {
+            ESP_LOGI(TAG, "Disconnected, %d buffered event(s) copied to the spool", spooled);
+        }
     }
-    
-    return has_events;
 }
 
-static void mark_event_delivered(int msg_id)
+// Erase the next spool sector ahead of time. The erase takes tens of
+// milliseconds, so it runs without event_buffer_mutex: delivery acks from
+// the MQTT handler do not wait for it.
+static void erase_spool_ahead(void)
 {
+    if (!telemetry_spool_available()) {
+        return;
+    }
+    bool pending = false;
     if (xSemaphoreTake(event_buffer_mutex, portMAX_DELAY) == pdTRUE) {
-        // Search buffer for matching msg_id
-        for (int i = 0; i < event_buffer.count; i++) {
-            int index = (event_buffer.tail + i) % EVENT_BUFFER_SIZE;
-            if (event_buffer.events[index].msg_id == msg_id && event_buffer.events[index].pending) {
-                ESP_LOGI(TAG, "Marking event as delivered (msg_id=%d)", msg_id);
-                
-                // Optimize removal based on position
-                if (i == 0) {
-                    // Event is at tail - just advance tail pointer (O(1))
-                    event_buffer.tail = (event_buffer.tail + 1) % EVENT_BUFFER_SIZE;
-                } else if (i == event_buffer.count - 1) {
-                    // Event is at head - just move head back (O(1))
-                    event_buffer.head = (event_buffer.head - 1 + EVENT_BUFFER_SIZE) % EVENT_BUFFER_SIZE;
-                } else {
-                    // Event is in the middle - mark as not pending (invalid) instead of shifting
-                    event_buffer.events[index].pending = false;
-                    // Note: The count is decremented below, and processing code should skip non-pending events.
-                }
-                
-                event_buffer.count--;
-                ESP_LOGI(TAG, "Event removed from buffer (remaining: %d)", event_buffer.count);
-                break;
-            }
-        }
-        
+        pending = telemetry_spool_reclaim();
         xSemaphoreGive(event_buffer_mutex);
     }
+    if (pending) {
+        telemetry_spool_erase_ahead();
+    }
 }
 
 static void check_pending_timeouts(void)
 {
-    TickType_t current_ticks = xTaskGetTickCount();
-    const TickType_t timeout_ticks = pdMS_TO_TICKS(10000); // 10 seconds
     const TickType_t mutex_timeout = pdMS_TO_TICKS(100); // 100ms timeout to avoid blocking
     
-    // Structure to hold timed-out events for republishing
-    typedef struct {
-        event_t event;
-        int old_msg_id;
-    } timed_out_event_t;
-    
-    timed_out_event_t timed_out[EVENT_BUFFER_SIZE];
-    int timed_out_count = 0;
-    
-    // Phase 1: Collect all timed-out events while holding mutex (minimize hold time)
-    if (xSemaphoreTake(event_buffer_mutex, mutex_timeout) == pdTRUE) {
-        for (int i = 0; i < event_buffer.count && timed_out_count < EVENT_BUFFER_SIZE; i++) {
-            int index = (event_buffer.tail + i) % EVENT_BUFFER_SIZE;
-            buffered_event_t *buffered = &event_buffer.events[index];
-            
-            // Wrap-safe comparison: works correctly even when tick counter wraps around
-            if (buffered->pending && (current_ticks - buffered->timestamp) >= timeout_ticks) {
-                if (mqtt_connected && mqtt_client != NULL) {
-                    // Copy only essential data (fast operation)
-                    memcpy(&timed_out[timed_out_count].event, &buffered->event, sizeof(event_t));
-                    timed_out[timed_out_count].old_msg_id = buffered->msg_id;
-                    timed_out_count++;
-                } else {
-                    // Not connected, mark as not pending so it can be flushed when reconnected
-                    ESP_LOGW(TAG, "Marking timed-out event as not pending (msg_id=%d)", buffered->msg_id);
-                    buffered->pending = false;
-                }
-            }
-        }
-        xSemaphoreGive(event_buffer_mutex);
-    } else {
+    if (xSemaphoreTake(event_buffer_mutex, mutex_timeout) != pdTRUE) {
         // Failed to acquire mutex, skip this check cycle
         ESP_LOGV(TAG, "Skipping timeout check, mutex busy");
         return;
     }
-    
-    // Phase 2: Republish all timed-out events without holding mutex
-    if (timed_out_count == 0) {
-        return; // Nothing to republish
+
+    // Timed-out events go back to the front of the ready list; publish_ready_events()
+    // resends them (re-batched if batching is enabled) with the stored payload
+    int requeued = telemetry_buffer_expire(xTaskGetTickCount(), pdMS_TO_TICKS(PENDING_TIMEOUT_MS));
+
+    xSemaphoreGive(event_buffer_mutex);
+
+    if (requeued > 0) {
+        ESP_LOGW(TAG, "%d pending event(s) timed out, will republish", requeued);
     }
-    
-    // Prepare results for batch update
-    typedef struct {
-        int old_msg_id;
-        int new_msg_id;
-    } update_result_t;
-    
-    update_result_t results[EVENT_BUFFER_SIZE];
-    
-    for (int i = 0; i < timed_out_count; i++) {
-        char json_buffer[JSON_BUFFER_SIZE];
-        int len = event_to_json(&timed_out[i].event, json_buffer, JSON_BUFFER_SIZE);
-        
-        results[i].old_msg_id = timed_out[i].old_msg_id;
-        results[i].new_msg_id = -1;
-        
-        if (len > 0 && mqtt_connected && mqtt_client != NULL) {
-            results[i].new_msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_TELEMETRY, 
-                                                            json_buffer, len, 1, 0);
-        }
+}
+
+// Claim the oldest ready events (one, or a batch in a single format) and
+// build the outgoing message. Returns message length, 0 if nothing is ready.
+static int claim_ready_events(char *out, size_t out_size, telemetry_format_t *format, int *claimed_count)
+{
+    int len = 0;
+    *claimed_count = 0;
+
+    if (xSemaphoreTake(event_buffer_mutex, portMAX_DELAY) != pdTRUE) {
+        return 0;
     }
-    
-    // Phase 3: Batch update all results with single mutex acquisition
-    if (xSemaphoreTake(event_buffer_mutex, mutex_timeout) == pdTRUE) {
-        for (int i = 0; i < timed_out_count; i++) {
-            // Search by old_msg_id (robust to buffer modifications)
-            for (int j = 0; j < event_buffer.count; j++) {
-                int idx = (event_buffer.tail + j) % EVENT_BUFFER_SIZE;
-                buffered_event_t *buffered = &event_buffer.events[idx];
-                
-                if (buffered->pending && buffered->msg_id == results[i].old_msg_id) {
-                    if (results[i].new_msg_id >= 0) {
-                        ESP_LOGW(TAG, "Republishing timed-out event (old_msg_id=%d, new_msg_id=%d)", 
-                                results[i].old_msg_id, results[i].new_msg_id);
-                        buffered->msg_id = results[i].new_msg_id;
-                        buffered->timestamp = current_ticks;
-                    } else {
-                        ESP_LOGE(TAG, "Failed to republish timed-out event (msg_id=%d)", results[i].old_msg_id);
-                        buffered->pending = false; // Mark as not pending to retry later
-                    }
-                    break;
-                }
+
+    import_spooled_locked();
+
+    int slot = telemetry_buffer_ready_first();
+    if (slot == TELEMETRY_SLOT_NONE) {
+        xSemaphoreGive(event_buffer_mutex);
+        return 0;
+    }
+
+    const telemetry_entry_t *entry = telemetry_buffer_entry(slot);
+    *format = entry->format;
+
+    if (!TELEMETRY_BATCHING) {
+        // One event per message, published exactly as serialized
+        memcpy(out, entry->payload, entry->payload_len);
+        len = entry->payload_len;
+        *claimed_count = 1;
+    } else {
+        telemetry_batch_t batch;
+        telemetry_batch_init(&batch, *format, out, out_size);
+        for (; slot != TELEMETRY_SLOT_NONE; slot = telemetry_buffer_ready_next(slot)) {
+            entry = telemetry_buffer_entry(slot);
+            if (entry->format != *format) {
+                break;  // Keep order: a format switch starts the next batch
             }
+            if (!telemetry_batch_add(&batch, entry->seq, entry->payload, entry->payload_len)) {
+                break;  // Byte budget reached
+            }
+            (*claimed_count)++;
         }
-        xSemaphoreGive(event_buffer_mutex);
+        len = telemetry_batch_finish(&batch);
+    }
+
+    // Claimed events are pending without a msg_id until the publish returns
+    if (len > 0) {
+        telemetry_buffer_claim(*claimed_count, xTaskGetTickCount());
     } else {
-        ESP_LOGW(TAG, "Failed to update republished events, will retry next cycle");
+        *claimed_count = 0;
     }
-}
 
+    xSemaphoreGive(event_buffer_mutex);
+    return len;
+}
 
-static void flush_buffered_events(void)
+static void finish_claimed_events(int msg_id)
 {
-    if (!has_buffered_events()) {
+    if (xSemaphoreTake(event_buffer_mutex, portMAX_DELAY) != pdTRUE) {
         return;
     }
 
-    ESP_LOGI(TAG, "Flushing buffered events");
+    // Failed publishes go back to the front of the ready list for the next pass
+    telemetry_buffer_publish_done(msg_id);
 
-    event_t event;
-    int event_index;
-    while ((event_index = find_next_non_pending_event(&event)) >= 0) {
+    xSemaphoreGive(event_buffer_mutex);
+}
+
+// Publish every READY event (new, flushed after reconnect or timed out).
+// Only called from comm_task, so claims never race with another publisher.
+static void publish_ready_events(void)
+{
+    static char message[TELEMETRY_BATCHING ? TELEMETRY_BATCH_MAX_BYTES : TELEMETRY_PAYLOAD_SIZE];
+    int claimed_count = 0;
+    telemetry_format_t format = TELEMETRY_FORMAT_JSON;
+
+    while (1) {
         // Check connection state before attempting publish
         // Read volatile variables once to ensure consistency
         bool is_connected = mqtt_connected;
         esp_mqtt_client_handle_t client = mqtt_client;
         
         if (!is_connected || client == NULL) {
-            ESP_LOGW(TAG, "MQTT disconnected during flush, stopping flush");
-            break;
+            return;
         }
-        
-        char json_buffer[JSON_BUFFER_SIZE];
-        int len = event_to_json(&event, json_buffer, JSON_BUFFER_SIZE);
-
-        if (len > 0) {
-            int msg_id = esp_mqtt_client_publish(client, MQTT_TOPIC_TELEMETRY, json_buffer, len, 1, 0);
-            if (msg_id >= 0) {
-                ESP_LOGI(TAG, "Queued buffered event (msg_id=%d)", msg_id);
-                // Mark as pending to track delivery (event stays in buffer until confirmed)
-                mark_event_pending(event_index, msg_id);
-            } else {
-                ESP_LOGE(TAG, "Failed to queue buffered event (error=%d), leaving in buffer", msg_id);
-                break;
-            }
+
+        int len = claim_ready_events(message, sizeof(message), &format, &claimed_count);
+        if (len <= 0) {
+            return;
         }
 
-        // Small delay to avoid overwhelming the broker
-        vTaskDelay(pdMS_TO_TICKS(50));
+        int msg_id = esp_mqtt_client_publish(client, telemetry_topic(format), message, len, 1, 0);
+        finish_claimed_events(msg_id);
+
+        if (msg_id < 0) {
+            ESP_LOGE(TAG, "MQTT publish failed (error=%d), %d event(s) kept in buffer", msg_id, claimed_count);
+            return;
+        }
+        ESP_LOGI(TAG, "Queued %d event(s) for MQTT (msg_id=%d, %d bytes)", claimed_count, msg_id, len);
+    }
+}
+
+// Diagnostics messages (queue, I2C and input latency statistics), built one
+// at a time.
+// Worst case, every queue counter at ten digits, is about 2.1 KB.
+static char stats_message[2304];
+
+// Publish inter-task queue statistics. Diagnostic only: QoS 0, always JSON,
+// not buffered or spooled while offline.
+static void publish_queue_stats(void)
+{
+    char *message = stats_message;
+    queue_stats_t stats[QUEUE_STATS_COUNT];
+
+    esp_mqtt_client_handle_t client = mqtt_client;
+    if (!mqtt_connected || client == NULL) {
+        return;
+    }
+
+    int count = queue_manager_get_stats(stats, QUEUE_STATS_COUNT);
+    uint32_t ts = (uint32_t)(esp_timer_get_time() / 1000000);
+    int len = queue_stats_to_json(stats, count, ts, message, sizeof(stats_message));
+    if (len < 0) {
+        return;
+    }
+
+    int msg_id = esp_mqtt_client_publish(client, MQTT_TOPIC_TELEMETRY, message, len, 0, 0);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "Queue stats publish failed (error=%d)", msg_id);
+    }
+}
+
+// Publish I2C bus arbiter statistics (per-client wait and hold times);
+// diagnostic only, like the queue statistics
+static void publish_i2c_stats(void)
+{
+    i2c_bus_stats_t stats[I2C_DEV_COUNT];
+
+    esp_mqtt_client_handle_t client = mqtt_client;
+    if (!mqtt_connected || client == NULL) {
+        return;
+    }
+
+    int count = i2c_bus_get_stats(stats, I2C_DEV_COUNT);
+    uint32_t ts = (uint32_t)(esp_timer_get_time() / 1000000);
+    int len = i2c_bus_stats_to_json(stats, count, ts, stats_message, sizeof(stats_message));
+    if (len < 0) {
+        return;
+    }
+
+    int msg_id = esp_mqtt_client_publish(client, MQTT_TOPIC_TELEMETRY, stats_message, len, 0, 0);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "I2C stats publish failed (error=%d)", msg_id);
+    }
+}
+
+// Publish keypress-to-glass latency per stage; diagnostic only, like the
+// queue statistics
+static void publish_latency_stats(void)
+{
+    input_latency_stats_t stats[INPUT_STAGE_COUNT];
+
+    esp_mqtt_client_handle_t client = mqtt_client;
+    if (!mqtt_connected || client == NULL) {
+        return;
+    }
+
+    int count = input_latency_get_stats(stats, INPUT_STAGE_COUNT);
+    uint32_t ts = (uint32_t)(esp_timer_get_time() / 1000000);
+    int len = input_latency_to_json(stats, count, ts, stats_message, sizeof(stats_message));
+    if (len < 0) {
+        return;
+    }
+
+    int msg_id = esp_mqtt_client_publish(client, MQTT_TOPIC_TELEMETRY, stats_message, len, 0, 0);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "Latency stats publish failed (error=%d)", msg_id);
     }
 }
 
+// Publish the accelerometer trace frozen by the last movement alarm. Stays
+// frozen (and is retried next pass) until the publish is accepted.
+static void publish_alarm_trace(void)
+{
+    const uint8_t *data = NULL;
+    size_t len = mpu6050_trace_get(&data);
+    esp_mqtt_client_handle_t client = mqtt_client;
+    if (len == 0 || !mqtt_connected || client == NULL) {
+        return;
+    }
+
+    int msg_id = esp_mqtt_client_publish(client, MQTT_TOPIC_TRACE, (const char *)data, (int)len, 1, 0);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "Trace publish failed (error=%d), will retry", msg_id);
+        return;
+    }
+    ESP_LOGI(TAG, "Published alarm trace (%u bytes, msg_id=%d)", (unsigned)len, msg_id);
+    mpu6050_trace_release();
+}
+
 // ============================================================================
 // WiFi
 // ============================================================================
@@ -434,25 +594,22 @@ static void mqtt_event_handler(void *arg, esp_event_base_t event_base,
             } else {
                 ESP_LOGI(TAG, "Subscribed: %s (msg_id=%d)", MQTT_TOPIC_COMMAND, msg_id);
             }
-            // Flush any buffered events after successful connection
-            flush_buffered_events();
+            // Buffered events are flushed by comm_task on its next pass
             break;
 
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "MQTT disconnected");
             mqtt_connected = false;
+            spool_ram_requested = true;
             break;
 
         case MQTT_EVENT_DATA:
             ESP_LOGI(TAG, "Command: %.*s", event->data_len, event->data);
-            // Create null-terminated copy for safe JSON parsing
-            if (event->data_len > 0 && event->data_len < JSON_BUFFER_SIZE) {
-                char cmd_buffer[JSON_BUFFER_SIZE];
-                memcpy(cmd_buffer, event->data, event->data_len);
-                cmd_buffer[event->data_len] = '\0';
-                handle_mqtt_command(cmd_buffer, event->data_len);
+            // Parsed in place; the parser is length-bounded and needs no copy
+            if (event->data_len > 0 && event->data_len == event->total_data_len) {
+                handle_mqtt_command(event->data, event->data_len);
             } else {
-                ESP_LOGW(TAG, "Command too large or empty");
+                ESP_LOGW(TAG, "Command empty or fragmented");
             }
             break;
 
@@ -531,51 +688,71 @@ static void comm_cleanup(void)
 // Telemetry & Commands
 // ============================================================================
 
-static void publish_telemetry(event_t *event)
+// Serialize and buffer an event; publishing happens in publish_ready_events()
+static int buffer_telemetry(const event_t *event)
 {
-    char json_buffer[JSON_BUFFER_SIZE];
-    int len = event_to_json(event, json_buffer, JSON_BUFFER_SIZE);
+    // Every event reports how many events were lost so far (RAM evictions, spool drops)
+    event_t stamped = *event;
+    stamped.dropped = ram_dropped + telemetry_spool_dropped();
+
+    // Serialize once; the buffered copy is reused for batches, flushes and retries
+    telemetry_format_t format = telemetry_format;
+    char payload[TELEMETRY_PAYLOAD_SIZE];
+    int len = event_encode(&stamped, format, payload, sizeof(payload));
 
     if (len <= 0) {
-        ESP_LOGE(TAG, "JSON conversion failed");
-        return;
+        ESP_LOGE(TAG, "Telemetry encoding failed (format=%s)", telemetry_format_to_string(format));
+        return 0;
     }
 
-    ESP_LOGI(TAG, "Telemetry: %s", json_buffer);
+    if (format == TELEMETRY_FORMAT_JSON) {
+        ESP_LOGI(TAG, "Telemetry: %s", payload);
+    } else {
+        ESP_LOGI(TAG, "Telemetry: %s event, %d bytes", telemetry_format_to_string(format), len);
+    }
 
     // buffer first to ensure zero data loss
-    int buffered_index = buffer_event(event, -1, false);
+    if (!buffer_event(payload, len, format)) {
+        return 0;
+    }
+    if (!mqtt_connected) {
+        ESP_LOGW(TAG, "MQTT not connected, event buffered for later");
+    }
+    return len;
+}
 
-    // Then attempt to publish immediately if connected
-    if (mqtt_connected && mqtt_client != NULL) {
-        int msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_TELEMETRY, json_buffer, len, 1, 0);
-        if (msg_id >= 0) {
-            ESP_LOGI(TAG, "Queued for MQTT (msg_id=%d)", msg_id);
-            
-            // Update the buffered event with msg_id and mark as pending
-            if (buffered_index >= 0 && xSemaphoreTake(event_buffer_mutex, portMAX_DELAY) == pdTRUE) {
-                // Verify the event at buffered_index hasn't been removed/modified
-                // by checking if it still has msg_id=-1 and pending=false (our signature)
-                if (event_buffer.events[buffered_index].msg_id == -1 && 
-                    !event_buffer.events[buffered_index].pending) {
-                    event_buffer.events[buffered_index].msg_id = msg_id;
-                    event_buffer.events[buffered_index].pending = true;
-                    event_buffer.events[buffered_index].timestamp = xTaskGetTickCount();
-                } else {
-                    ESP_LOGW(TAG, "Buffered event was modified before update, re-buffering with msg_id");
-                    // Event was modified/removed, add new one with correct state
-                    buffer_event(event, msg_id, true);
-                }
-                xSemaphoreGive(event_buffer_mutex);
-            }
-        } else {
-            ESP_LOGE(TAG, "MQTT publish failed (error=%d), event already buffered", msg_id);
+// Buffer the event just received plus anything else arriving within the
+// batch window, up to the batch byte budget
+static void collect_telemetry(const event_t *first)
+{
+    int bytes = buffer_telemetry(first);
+
+    if (!TELEMETRY_BATCHING) {
+        return;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    const TickType_t window = pdMS_TO_TICKS(TELEMETRY_BATCH_WINDOW_MS);
+    while (bytes < TELEMETRY_BATCH_MAX_BYTES) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= window) {
+            break;
         }
-    } else {
-        ESP_LOGW(TAG, "MQTT not connected, event buffered for later");
+        event_t event;
+        if (!receive_event(&event, pdTICKS_TO_MS(window - elapsed))) {
+            break;
+        }
+        bytes += buffer_telemetry(&event);
     }
 }
 
+void comm_set_telemetry_format(telemetry_format_t format)
+{
+    telemetry_format = format;
+    ESP_LOGI(TAG, "Telemetry format set to %s (topic %s)",
+             telemetry_format_to_string(format), telemetry_topic(format));
+}
+
 void handle_mqtt_command(const char *data, int len)
 {
     command_t cmd;
@@ -607,6 +784,10 @@ void comm_task(void *pvParameters)
         return;
     }
     ESP_LOGI(TAG, "Event buffer mutex created");
+    telemetry_buffer_init();
+    if (telemetry_spool_init()) {
+        next_event_seq = telemetry_spool_next_seq();
+    }
 
     if (!wifi_init()) {
         ESP_LOGE(TAG, "WiFi initialization failed");
@@ -624,11 +805,12 @@ void comm_task(void *pvParameters)
 
     TickType_t last_timeout_check = xTaskGetTickCount();
     const TickType_t timeout_check_interval = pdMS_TO_TICKS(2000); // Check every 2 seconds
+    TickType_t last_stats = xTaskGetTickCount();
     
     while (1) {
         event_t event;
         if (receive_event(&event, 1000)) {
-            publish_telemetry(&event);
+            collect_telemetry(&event);
         }
         
         // Periodically check for timed-out pending events (wrap-safe comparison)
@@ -637,6 +819,21 @@ void comm_task(void *pvParameters)
             check_pending_timeouts();
             last_timeout_check = current_ticks;
         }
+
+        if (QUEUE_STATS_INTERVAL_MS > 0 &&
+            (current_ticks - last_stats) >= pdMS_TO_TICKS(QUEUE_STATS_INTERVAL_MS)) {
+            publish_queue_stats();
+            publish_i2c_stats();
+            publish_latency_stats();
+            last_stats = current_ticks;
+        }
+
+        // Publish new, spooled (after reconnect) and timed-out events
+        publish_ready_events();
+        spool_ram_events();
+        sync_spool();
+        erase_spool_ahead();
+        publish_alarm_trace();
     }
 
     // Cleanup on exit (if loop ever exits)
@@ -1,9 +1,15 @@
 #ifndef COMM_TASK_H
 #define COMM_TASK_H
 
+#include "../queue_manager/queue_manager.h"
+
 // Main comm task function
 void comm_task(void *pvParameters);
 
+// Select wire format for subsequently published telemetry (JSON or CBOR).
+// Already-buffered events keep the format they were serialized in.
+void comm_set_telemetry_format(telemetry_format_t format);
+
 // Handle incoming MQTT command (called by MQTT event handler)
 void handle_mqtt_command(const char *data, int len);
 
@@ -4,6 +4,7 @@
 #include "../pin_manager/pin_manager.h"
 #include "../event_publisher/event_publisher.h"
 #include "../mpu6050/mpu6050.h"
+#include "../comm_task/comm_task.h"
 
 static const char *TAG = "CMD_HANDLER";
 
@@ -73,7 +74,17 @@ void command_handler_process(command_t *cmd, safe_state_machine_t *sm)
 
         case CMD_SET_SENSITIVITY:
             ESP_LOGI(TAG, "Received SET_SENSITIVITY command: %ld", (long)cmd->sensitivity);
-            mpu6050_set_threshold(cmd->sensitivity);
+            mpu6050_override_threshold(cmd->sensitivity);
+            break;
+
+        case CMD_SET_FORMAT:
+            ESP_LOGI(TAG, "Received SET_FORMAT command: %d", cmd->format);
+            comm_set_telemetry_format(cmd->format);
+            break;
+
+        case CMD_CALIBRATE:
+            ESP_LOGI(TAG, "Received CALIBRATE command");
+            mpu6050_request_calibration();
             break;
 
         default:
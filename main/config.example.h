@@ -14,7 +14,48 @@
 #define MAX_WRONG_ATTEMPTS 3
 
 // Movement sensitivity (17000-45000, lower = more sensitive)
-#define INITIAL_SENSITIVITY 20000
+#define INITIAL_SENSITIVITY 19000
+
+// Accelerometer FIFO mode: sample into the MPU6050 FIFO at
+// MPU6050_FIFO_RATE_HZ and drain MPU6050_FIFO_BLOCK samples per wake
+// (far fewer I2C transactions than one interrupt per sample)
+#define MPU6050_FIFO_MODE 0
+#define MPU6050_FIFO_RATE_HZ 50
+#define MPU6050_FIFO_BLOCK 10
+
+// Wake-on-motion: keep the MPU6050 in low-power cycle mode with its motion
+// interrupt armed while quiet; sample at full rate only after a hit, until
+// MPU6050_WOM_IDLE_MS pass without movement. MPU6050_WOM_LP_WAKE selects
+// the cycle rate (0=1.25 Hz, 1=5 Hz, 2=20 Hz, 3=40 Hz)
+#define MPU6050_WAKE_ON_MOTION 0
+#define MPU6050_WOM_LP_WAKE 2
+#define MPU6050_WOM_IDLE_MS 2000
+
+// Samples kept in the accelerometer trace ring (8 bytes each, 0 disables).
+// The ring is frozen on a movement alarm and published on MQTT_TOPIC_TRACE;
+// replay it with tools/trace_replay
+#define MPU6050_TRACE_SAMPLES 512
+
+// Accelerometer calibration: MPU6050_CAL_SAMPLES samples at rest give the
+// resting vector and noise floor, and the sensitivity becomes
+// noise + MPU6050_CAL_K * sigma (at least MPU6050_CAL_MIN_MG). Runs on first
+// boot (then loaded from NVS), on the calibrate command and every
+// MPU6050_RECALIBRATE_MS (0 disables); overrides INITIAL_SENSITIVITY
+#define MPU6050_CAL_SAMPLES 150
+#define MPU6050_CAL_K 8
+#define MPU6050_CAL_MIN_MG 150
+#define MPU6050_RECALIBRATE_MS (6UL * 60 * 60 * 1000)
+
+// Keypad scanner: one matrix row per KEYPAD_SCAN_TICK_US while a key is
+// down; a key must read the same for KEYPAD_DEBOUNCE_MS to change state
+#define KEYPAD_SCAN_TICK_US 1000
+#define KEYPAD_DEBOUNCE_MS 20
+
+// Status LEDs (LEDC PWM): brightness in percent, duration of each half of
+// the breathing while unlocked, and of the fade back after a keypress blink
+#define LED_BRIGHTNESS 100
+#define LED_BREATH_MS 1500
+#define LED_ACK_MS 150
 
 // MQTT broker settings
 #define MQTT_BROKER_URI  "mqtt://your_broker_address:1883"
@@ -23,9 +64,42 @@
 // MQTT topics (built from device ID)
 #define MQTT_TOPIC_TELEMETRY "smartsafe/" MQTT_DEVICE_ID "/telemetry"
 #define MQTT_TOPIC_COMMAND   "smartsafe/" MQTT_DEVICE_ID "/command"
+#define MQTT_TOPIC_TELEMETRY_CBOR MQTT_TOPIC_TELEMETRY "/cbor"
+#define MQTT_TOPIC_TRACE     MQTT_TOPIC_TELEMETRY "/trace"
+
+// Telemetry wire format: TELEMETRY_FORMAT_JSON or TELEMETRY_FORMAT_CBOR
+// (can also be changed at runtime with {"command":"set_format","value":"cbor"})
+#define TELEMETRY_FORMAT TELEMETRY_FORMAT_JSON
+
+// Telemetry batching: events arriving within the window are sent as one
+// MQTT message (JSON array / CBOR array, each event tagged with "seq");
+// TELEMETRY_BATCH_MAX_BYTES must fit one event (at least 180)
+#define TELEMETRY_BATCHING 0
+#define TELEMETRY_BATCH_WINDOW_MS 20
+#define TELEMETRY_BATCH_MAX_BYTES 1024
+
+// Events buffered for delivery while offline or awaiting PUBACK
+// (about 150 bytes of RAM each, max 4096)
+#define TELEMETRY_BUFFER_SIZE 32
+
+// Offline spool in the "spool" flash partition (see partitions.csv):
+// oldest undelivered events beyond the cap are dropped and counted
+#define TELEMETRY_SPOOL_MAX_EVENTS 500
+#define TELEMETRY_SPOOL_FLUSH_MS 1000
+
+// Inter-task queue backend: QUEUE_BACKEND_FREERTOS (xQueue) or
+// QUEUE_BACKEND_SPSC (lock-free rings; sdkconfig.defaults enables the
+// second task notification slot it needs)
+#define QUEUE_BACKEND QUEUE_BACKEND_FREERTOS
+
+// Publish inter-task queue statistics (depth, drops, wait histogram) as a
+// "stats" telemetry message, I2C bus statistics (per-client wait and hold
+// times) as an "i2c" message and keypress-to-LCD latency as a "latency"
+// message, every N ms; 0 disables
+#define QUEUE_STATS_INTERVAL_MS 60000
 
 //Sensitivity of accelerometer
-#define INITIAL_SENSITIVITY 20000
+#define INITIAL_SENSITIVITY 19000
 
 // Maximum wrong PIN attempts before alarm triggers
 #define MAX_WRONG_ATTEMPTS 3
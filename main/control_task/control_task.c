@@ -5,6 +5,7 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_task_wdt.h"
+#include "esp_timer.h"
 #include "../queue_manager/queue_manager.h"
 #include "../state_machine/state_machine.h"
 #include "../json_protocol/json_protocol.h"
@@ -15,12 +16,29 @@
 
 static const char *TAG = "CTRL";
 
+// Maximum time to block waiting for input before feeding the watchdog
+#define INPUT_WAIT_TIMEOUT_MS 1000
+
 static safe_state_machine_t safe_sm;
 
 // PIN entry buffer
 static char pin_buffer[MAX_PIN_LENGTH] = {0};
 static int pin_index = 0;
 
+// Key press being handled; stamped into the first LCD command it causes
+// (its visible feedback) for keypress-to-glass latency
+static input_trace_t key_trace;
+
+static void send_lcd(lcd_cmd_t *cmd)
+{
+    if (key_trace.contact_us != 0) {
+        cmd->trace = key_trace;
+        cmd->trace.sent_us = esp_timer_get_time();
+        key_trace.contact_us = 0;
+    }
+    send_lcd_cmd(cmd);
+}
+
 // Helper to send LED command
 static void send_led_state(led_cmd_type_t type)
 {
@@ -35,7 +53,7 @@ static void send_lcd_state(safe_state_t state)
         .type = LCD_CMD_SHOW_STATE,
         .state = state
     };
-    send_lcd_cmd(&cmd);
+    send_lcd(&cmd);
 }
 
 // Helper to send LCD PIN entry
@@ -45,7 +63,7 @@ static void send_lcd_pin_entry(int length)
         .type = LCD_CMD_SHOW_PIN_ENTRY,
         .pin_length = length
     };
-    send_lcd_cmd(&cmd);
+    send_lcd(&cmd);
 }
 
 // Helper to send LCD message
@@ -58,21 +76,21 @@ static void send_lcd_message(const char *message, uint32_t duration_ms, safe_sta
     };
     strncpy(cmd.message, message, sizeof(cmd.message) - 1);
     cmd.message[sizeof(cmd.message) - 1] = '\0';
-    send_lcd_cmd(&cmd);
+    send_lcd(&cmd);
 }
 
 // Helper to send LCD clear PIN entry
 static void send_lcd_clear_pin(void)
 {
     lcd_cmd_t cmd = { .type = LCD_CMD_CLEAR_PIN_ENTRY };
-    send_lcd_cmd(&cmd);
+    send_lcd(&cmd);
 }
 
 // Helper to send LCD checking
 static void send_lcd_checking(void)
 {
     lcd_cmd_t cmd = { .type = LCD_CMD_SHOW_CHECKING };
-    send_lcd_cmd(&cmd);
+    send_lcd(&cmd);
 }
 
 static void process_pin_entry(const char *pin)
@@ -193,30 +211,53 @@ void control_task(void *pvParameters)
     esp_task_wdt_add(NULL);
     ESP_LOGI(TAG, "Control task registered with watchdog");
 
+    // Wake on key, sensor and command input instead of polling
+    queue_manager_set_input_listener(xTaskGetCurrentTaskHandle());
+
     ESP_LOGI(TAG, "Ready for input");
 
     while (1) {
         // Feed the watchdog
         esp_task_wdt_reset();
 
-        // Check for key events (non-blocking)
-        key_event_t key_evt;
-        if (receive_key_event(&key_evt, 0)) {
-            handle_key_press(key_evt.key);
-        }
+        // Block until input arrives (bounded so the watchdog keeps being fed)
+        queue_manager_wait_for_input(INPUT_WAIT_TIMEOUT_MS);
 
-        // Check for sensor events (non-blocking)
-        sensor_event_t sensor_evt;
-        if (receive_sensor_event(&sensor_evt, 0)) {
-            handle_movement(sensor_evt.movement_g);
-        }
+        // Drain all inputs in priority order: sensor, then command, then key.
+        // Higher priority queues are re-checked before each lower priority item.
+        while (1) {
+            sensor_event_t sensor_evt;
+            if (receive_sensor_event(&sensor_evt, 0)) {
+                if (sensor_evt.type == SENSOR_EVT_CALIBRATED) {
+                    event_publisher_calibration(&safe_sm, &sensor_evt.calibration);
+                } else {
+                    handle_movement(sensor_evt.movement_g);
+                }
+                continue;
+            }
 
-        // Check for remote commands (non-blocking)
-        command_t cmd;
-        if (receive_command(&cmd, 0)) {
-            command_handler_process(&cmd, &safe_sm);
-        }
+            command_t cmd;
+            if (receive_command(&cmd, 0)) {
+                command_handler_process(&cmd, &safe_sm);
+                continue;
+            }
 
-        vTaskDelay(pdMS_TO_TICKS(20));
+            key_event_t key_evt;
+            if (receive_key_event(&key_evt, 0)) {
+                if (key_evt.type == KEY_EVT_PRESS) {
+                    key_trace = (input_trace_t){
+                        .contact_us = key_evt.contact_us,
+                        .debounced_us = key_evt.time_us,
+                        .received_us = esp_timer_get_time(),
+                    };
+                    handle_key_press(key_evt.key);
+                    key_trace.contact_us = 0;
+                    send_led_state(LED_CMD_ACK);
+                }
+                continue;
+            }
+
+            break;
+        }
     }
 }
@@ -66,3 +66,18 @@ void event_publisher_code_changed(safe_state_machine_t *sm, bool success)
     };
     send_event(&event);
 }
+
+void event_publisher_calibration(safe_state_machine_t *sm, const sensor_calibration_t *cal)
+{
+    event_t event = {
+        .type = EVT_CALIBRATION,
+        .timestamp = get_timestamp(),
+        .state = sm->current_state,
+        .movement_amount = 0.0f,
+        .code_ok = false,
+        .calibration = *cal
+    };
+    send_event(&event);
+    ESP_LOGI(TAG, "Calibration: noise %u mg, sigma %u mg, threshold %ld",
+             cal->noise_mg, cal->sigma_mg, (long)cal->threshold);
+}
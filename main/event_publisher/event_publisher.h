@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "../state_machine/state_machine.h"
+#include "../queue_manager/queue_manager.h"
 
 /**
  * @brief Initialize the event publisher
@@ -42,4 +43,12 @@ void event_publisher_code_result(safe_state_machine_t *sm, bool correct);
  */
 void event_publisher_code_changed(safe_state_machine_t *sm, bool success);
 
+/**
+ * @brief Publish the result of an accelerometer calibration
+ * 
+ * @param sm Pointer to the safe state machine
+ * @param cal Learned resting vector, noise floor and threshold
+ */
+void event_publisher_calibration(safe_state_machine_t *sm, const sensor_calibration_t *cal);
+
 #endif // EVENT_PUBLISHER_H
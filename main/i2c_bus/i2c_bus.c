@@ -0,0 +1,403 @@
+#include "i2c_bus.h"
+#include <string.h>
+#include "driver/i2c_master.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "I2C_BUS";
+
+#define I2C_BUS_PORT I2C_NUM_0
+
+// Tasks that can wait for the bus at once (sensor, LCD, message timer,
+// control via set_threshold, plus headroom)
+#define I2C_BUS_MAX_WAITERS 8
+
+// Runtime downshift: a device at Fast-mode that fails this many of its
+// last I2C_BUS_ERROR_WINDOW transactions drops to I2C_BUS_FALLBACK_HZ
+#define I2C_BUS_ERROR_WINDOW    64
+#define I2C_BUS_ERROR_LIMIT     4
+
+// Bring-up: the check must pass this many times in a row at a speed
+#define I2C_BUS_CHECK_ROUNDS    8
+
+// Clients: priority (higher is served first), the longest transaction a
+// client may issue (0 = unbounded), which bounds how long one grant can hold
+// the bus, and the fastest clock the device takes. LCD writes are one DDRAM
+// run (address, 2 control bytes, 16 cells); the LCD controller needs ~40 us
+// per data byte and does not stretch the clock, so it is limited to 200 kHz
+// (45 us per byte). Backlight writes are at most one auto-increment run from
+// PWM0 to LEDOUT (register, 7 values): about 200 us at 400 kHz.
+typedef struct {
+    const char *name;
+    uint8_t priority;
+    uint16_t max_bytes;
+    uint32_t max_hz;
+} i2c_client_t;
+
+static const i2c_client_t clients[I2C_DEV_COUNT] = {
+    [I2C_DEV_MPU6050] = { "mpu6050", 2, 0,  400000 },
+    [I2C_DEV_LCD]     = { "lcd",     1, 19, 200000 },
+    [I2C_DEV_RGB]     = { "rgb",     1, 8,  400000 },
+};
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t errors;
+    uint64_t wait_total_us;
+    uint32_t wait_max_us;
+    uint64_t xfer_total_us;
+    uint32_t xfer_max_us;
+    uint32_t wait_hist[I2C_BUS_STATS_BUCKETS];
+} client_counters_t;
+
+typedef struct {
+    SemaphoreHandle_t wake;     // Given when the grant is handed to this waiter
+    bool used;
+    bool granted;
+    uint8_t priority;
+    uint32_t seq;               // Arrival order (FIFO within a priority)
+} waiter_t;
+
+static i2c_master_bus_handle_t bus = NULL;
+static i2c_master_dev_handle_t devices[I2C_DEV_COUNT];
+static uint16_t device_addr[I2C_DEV_COUNT];
+static uint32_t bus_freq_hz = 0;
+
+// Negotiated clock and error window per device, guarded by the bus grant
+static uint32_t device_hz[I2C_DEV_COUNT];
+static uint16_t window_count[I2C_DEV_COUNT];
+static uint16_t window_errors[I2C_DEV_COUNT];
+static uint32_t downshifts[I2C_DEV_COUNT];
+
+// Arbiter state and counters, guarded by arb_mutex (held only for bookkeeping,
+// never across a transfer)
+static SemaphoreHandle_t arb_mutex = NULL;
+static bool bus_granted = false;
+static waiter_t waiters[I2C_BUS_MAX_WAITERS];
+static uint32_t waiter_seq = 0;
+static client_counters_t counters[I2C_DEV_COUNT];
+
+// Bucket 0 counts waits under 1 us, bucket i (i >= 1) waits in
+// [2^(i-1), 2^i) us; the last bucket collects everything longer
+static int wait_bucket(uint32_t us)
+{
+    int bucket = (us == 0) ? 0 : 32 - __builtin_clz(us);
+    return (bucket < I2C_BUS_STATS_BUCKETS) ? bucket : I2C_BUS_STATS_BUCKETS - 1;
+}
+
+// ============================================================================
+// Arbiter
+// ============================================================================
+
+// One grant covers one transaction. A free bus is granted at once; otherwise
+// the caller queues and the releasing task hands the grant straight to the
+// highest priority waiter (oldest first), so a low priority client cannot
+// slip in between two waiting sensor reads.
+static bool arbiter_acquire(i2c_dev_t dev)
+{
+    xSemaphoreTake(arb_mutex, portMAX_DELAY);
+    if (!bus_granted) {
+        bus_granted = true;
+        xSemaphoreGive(arb_mutex);
+        return true;
+    }
+
+    waiter_t *w = NULL;
+    for (int i = 0; i < I2C_BUS_MAX_WAITERS; i++) {
+        if (!waiters[i].used) {
+            w = &waiters[i];
+            break;
+        }
+    }
+    if (w == NULL) {
+        xSemaphoreGive(arb_mutex);
+        ESP_LOGE(TAG, "Too many tasks waiting for the bus");
+        return false;
+    }
+    w->used = true;
+    w->granted = false;
+    w->priority = clients[dev].priority;
+    w->seq = waiter_seq++;
+    xSemaphoreGive(arb_mutex);
+
+    bool granted = (xSemaphoreTake(w->wake, pdMS_TO_TICKS(I2C_BUS_TIMEOUT_MS)) == pdTRUE);
+
+    xSemaphoreTake(arb_mutex, portMAX_DELAY);
+    if (!granted && w->granted) {
+        // Handed over just as we timed out: take it anyway
+        xSemaphoreTake(w->wake, 0);
+        granted = true;
+    }
+    w->used = false;
+    xSemaphoreGive(arb_mutex);
+    return granted;
+}
+
+// Account for the finished transaction and pass the grant on
+static void arbiter_release(i2c_dev_t dev, uint32_t wait_us, uint32_t xfer_us, bool ok)
+{
+    xSemaphoreTake(arb_mutex, portMAX_DELAY);
+
+    client_counters_t *c = &counters[dev];
+    c->transactions++;
+    if (!ok) {
+        c->errors++;
+    }
+    c->wait_total_us += wait_us;
+    c->xfer_total_us += xfer_us;
+    c->wait_hist[wait_bucket(wait_us)]++;
+    if (wait_us > c->wait_max_us) {
+        c->wait_max_us = wait_us;
+    }
+    if (xfer_us > c->xfer_max_us) {
+        c->xfer_max_us = xfer_us;
+    }
+
+    waiter_t *next = NULL;
+    for (int i = 0; i < I2C_BUS_MAX_WAITERS; i++) {
+        waiter_t *w = &waiters[i];
+        if (!w->used || w->granted) {
+            continue;
+        }
+        if (next == NULL || w->priority > next->priority ||
+            (w->priority == next->priority && (int32_t)(w->seq - next->seq) < 0)) {
+            next = w;
+        }
+    }
+    if (next != NULL) {
+        next->granted = true;   // Bus stays granted, now to next
+        xSemaphoreGive(next->wake);
+    } else {
+        bus_granted = false;
+    }
+
+    xSemaphoreGive(arb_mutex);
+}
+
+// ============================================================================
+// Clock speed
+// ============================================================================
+
+// (Re)attach a device at the given clock; the i2c_master driver fixes a
+// device's clock when it is added
+static esp_err_t device_attach(i2c_dev_t dev, uint32_t hz)
+{
+    if (devices[dev] != NULL) {
+        i2c_master_bus_rm_device(devices[dev]);
+        devices[dev] = NULL;
+    }
+
+    i2c_device_config_t conf = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = device_addr[dev],
+        .scl_speed_hz = hz,
+    };
+    esp_err_t err = i2c_master_bus_add_device(bus, &conf, &devices[dev]);
+    if (err != ESP_OK) {
+        devices[dev] = NULL;
+        return err;
+    }
+    device_hz[dev] = hz;
+    window_count[dev] = 0;
+    window_errors[dev] = 0;
+    return ESP_OK;
+}
+
+// Count a transaction result; too many errors at Fast-mode drop the device
+// to the fallback clock. Called with the grant held.
+static void track_errors(i2c_dev_t dev, bool ok)
+{
+    if (!ok) {
+        window_errors[dev]++;
+    }
+    if (window_errors[dev] >= I2C_BUS_ERROR_LIMIT && device_hz[dev] > I2C_BUS_FALLBACK_HZ) {
+        ESP_LOGW(TAG, "%s: %u errors in %u transactions at %lu Hz, falling back to %lu Hz",
+                 clients[dev].name, window_errors[dev], window_count[dev] + 1,
+                 (unsigned long)device_hz[dev], (unsigned long)I2C_BUS_FALLBACK_HZ);
+        if (device_attach(dev, I2C_BUS_FALLBACK_HZ) != ESP_OK) {
+            ESP_LOGE(TAG, "%s: failed to reattach at %lu Hz", clients[dev].name,
+                     (unsigned long)I2C_BUS_FALLBACK_HZ);
+        }
+        downshifts[dev]++;
+        return;
+    }
+    if (++window_count[dev] >= I2C_BUS_ERROR_WINDOW) {
+        window_count[dev] = 0;
+        window_errors[dev] = 0;
+    }
+}
+
+// Run one transaction under a grant, timing the wait and the transfer
+static esp_err_t bus_transfer(i2c_dev_t dev, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    // device_hz is set once a device is attached (the handle itself may be
+    // swapped by a downshift, so it is only read under the grant)
+    if (dev >= I2C_DEV_COUNT || device_hz[dev] == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (clients[dev].max_bytes > 0 && tx_len + rx_len > clients[dev].max_bytes) {
+        ESP_LOGE(TAG, "%s: %u-byte transaction exceeds its %u-byte limit",
+                 clients[dev].name, (unsigned)(tx_len + rx_len), clients[dev].max_bytes);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    int64_t t_request = esp_timer_get_time();
+    if (!arbiter_acquire(dev)) {
+        xSemaphoreTake(arb_mutex, portMAX_DELAY);
+        counters[dev].errors++;
+        xSemaphoreGive(arb_mutex);
+        ESP_LOGE(TAG, "%s: timed out waiting for the bus", clients[dev].name);
+        return ESP_ERR_TIMEOUT;
+    }
+    int64_t t_grant = esp_timer_get_time();
+
+    esp_err_t ret;
+    if (devices[dev] == NULL) {
+        ret = ESP_ERR_INVALID_STATE;    // Lost in a failed downshift
+    } else if (rx_len > 0) {
+        ret = i2c_master_transmit_receive(devices[dev], tx, tx_len, rx, rx_len, I2C_BUS_TIMEOUT_MS);
+    } else {
+        ret = i2c_master_transmit(devices[dev], tx, tx_len, I2C_BUS_TIMEOUT_MS);
+    }
+
+    int64_t t_done = esp_timer_get_time();
+    track_errors(dev, ret == ESP_OK);
+    arbiter_release(dev, (uint32_t)(t_grant - t_request), (uint32_t)(t_done - t_grant), ret == ESP_OK);
+    return ret;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+esp_err_t i2c_bus_init(int sda_pin, int scl_pin, uint32_t freq_hz)
+{
+    if (bus != NULL) {
+        return ESP_OK;
+    }
+
+    arb_mutex = xSemaphoreCreateMutex();
+    if (arb_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create arbiter mutex");
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < I2C_BUS_MAX_WAITERS; i++) {
+        waiters[i].wake = xSemaphoreCreateBinary();
+        if (waiters[i].wake == NULL) {
+            ESP_LOGE(TAG, "Failed to create arbiter semaphores");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    i2c_master_bus_config_t conf = {
+        .i2c_port = I2C_BUS_PORT,
+        .sda_io_num = sda_pin,
+        .scl_io_num = scl_pin,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&conf, &bus);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create I2C bus: %s", esp_err_to_name(err));
+        bus = NULL;
+        return err;
+    }
+
+    bus_freq_hz = freq_hz;
+    ESP_LOGI(TAG, "I2C bus initialized (SDA=%d, SCL=%d, up to %lu Hz)", sda_pin, scl_pin, (unsigned long)freq_hz);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_add_device(i2c_dev_t dev, uint16_t addr, i2c_bus_check_t check)
+{
+    if (bus == NULL || dev >= I2C_DEV_COUNT) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (devices[dev] != NULL) {
+        return ESP_OK;
+    }
+    device_addr[dev] = addr;
+
+    // Fastest clock both the bus and the device allow, then the fallback
+    uint32_t speeds[2] = {
+        (bus_freq_hz < clients[dev].max_hz) ? bus_freq_hz : clients[dev].max_hz,
+        I2C_BUS_FALLBACK_HZ,
+    };
+    int attempts = (speeds[0] > I2C_BUS_FALLBACK_HZ) ? 2 : 1;
+
+    esp_err_t err = ESP_FAIL;
+    for (int i = 0; i < attempts; i++) {
+        err = device_attach(dev, speeds[i]);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to add %s (0x%02X): %s", clients[dev].name, addr, esp_err_to_name(err));
+            return err;
+        }
+
+        bool ok = true;
+        for (int round = 0; check != NULL && ok && round < I2C_BUS_CHECK_ROUNDS; round++) {
+            ok = check(dev);
+        }
+        if (ok) {
+            ESP_LOGI(TAG, "Added %s at 0x%02X, %lu Hz (priority %d)", clients[dev].name, addr,
+                     (unsigned long)speeds[i], clients[dev].priority);
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "%s failed its check at %lu Hz", clients[dev].name, (unsigned long)speeds[i]);
+    }
+
+    // Detach so a later call probes again
+    ESP_LOGE(TAG, "%s (0x%02X) not responding", clients[dev].name, addr);
+    i2c_master_bus_rm_device(devices[dev]);
+    devices[dev] = NULL;
+    device_hz[dev] = 0;
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t i2c_bus_write(i2c_dev_t dev, const uint8_t *data, size_t len)
+{
+    return bus_transfer(dev, data, len, NULL, 0);
+}
+
+esp_err_t i2c_bus_write_reg(i2c_dev_t dev, uint8_t reg, uint8_t value)
+{
+    uint8_t buf[2] = { reg, value };
+    return bus_transfer(dev, buf, sizeof(buf), NULL, 0);
+}
+
+esp_err_t i2c_bus_read_reg(i2c_dev_t dev, uint8_t reg, uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return ESP_OK;
+    }
+    return bus_transfer(dev, &reg, 1, data, len);
+}
+
+int i2c_bus_get_stats(i2c_bus_stats_t *stats, int max)
+{
+    if (stats == NULL || arb_mutex == NULL) {
+        return 0;
+    }
+
+    int count = (max < I2C_DEV_COUNT) ? max : I2C_DEV_COUNT;
+    xSemaphoreTake(arb_mutex, portMAX_DELAY);
+    for (int i = 0; i < count; i++) {
+        const client_counters_t *c = &counters[i];
+        i2c_bus_stats_t *s = &stats[i];
+        s->name = clients[i].name;
+        s->priority = clients[i].priority;
+        s->transactions = c->transactions;
+        s->errors = c->errors;
+        s->wait_avg_us = c->transactions ? (uint32_t)(c->wait_total_us / c->transactions) : 0;
+        s->wait_max_us = c->wait_max_us;
+        s->xfer_avg_us = c->transactions ? (uint32_t)(c->xfer_total_us / c->transactions) : 0;
+        s->xfer_max_us = c->xfer_max_us;
+        s->speed_hz = device_hz[i];
+        s->downshifts = downshifts[i];
+        memcpy(s->wait_hist, c->wait_hist, sizeof(s->wait_hist));
+    }
+    xSemaphoreGive(arb_mutex);
+    return count;
+}
@@ -0,0 +1,110 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Shared I2C bus (MPU6050, LCD controller, RGB backlight) on the ESP-IDF
+ * i2c_master driver.
+ *
+ * Each device gets its own handle, registered by its driver with
+ * i2c_bus_add_device(). The driver serializes transactions on its bus lock,
+ * so callers no longer share a mutex, and every call is one complete
+ * transaction (start ... stop) that cannot interleave with another device.
+ *
+ * The calling task blocks on the driver's completion semaphore while the
+ * I2C ISR moves the bytes (the ESP32 I2C controller has no DMA).
+ *
+ * Arbiter: every transaction first takes a grant. Waiting clients are served
+ * by priority (MPU6050 above LCD and backlight), oldest first within a
+ * priority, and a grant covers exactly one transaction whose length is capped
+ * per client, so a sensor read waits at most for one short LCD write.
+ * Wait time, transfer time and errors are counted per client.
+ *
+ * Clock: each device is brought up at the fastest clock it and the bus allow
+ * (Fast-mode, 400 kHz; the LCD controller 200 kHz) and must pass its driver's
+ * check several times in a row, else it falls back to 100 kHz. At runtime a
+ * device that keeps failing at Fast-mode is downshifted to 100 kHz. Speeds
+ * are per device, so one marginal device does not slow the others.
+ */
+
+// Devices on the bus
+typedef enum {
+    I2C_DEV_MPU6050,
+    I2C_DEV_LCD,
+    I2C_DEV_RGB,
+    I2C_DEV_COUNT
+} i2c_dev_t;
+
+// Clock for devices that fail at Fast-mode
+#define I2C_BUS_FALLBACK_HZ 100000
+
+// Per-transaction timeout (also the longest wait for a grant)
+#define I2C_BUS_TIMEOUT_MS 1000
+
+// Wait histogram buckets: [0] < 1 us, [i] in [2^(i-1), 2^i) us, last open-ended
+#define I2C_BUS_STATS_BUCKETS 16
+
+// Per-client counters since boot
+typedef struct {
+    const char *name;
+    uint8_t priority;
+    uint32_t transactions;
+    uint32_t errors;            // Failed transfers and grant timeouts
+    uint32_t wait_avg_us;       // Request to grant
+    uint32_t wait_max_us;
+    uint32_t xfer_avg_us;       // Grant to completion (bus hold time)
+    uint32_t xfer_max_us;
+    uint32_t speed_hz;          // Negotiated SCL clock
+    uint32_t downshifts;        // Runtime fallbacks to I2C_BUS_FALLBACK_HZ
+    uint32_t wait_hist[I2C_BUS_STATS_BUCKETS];
+} i2c_bus_stats_t;
+
+// Bring-up check run on a freshly attached device (e.g. read WHO_AM_I);
+// returns true if the device answered correctly
+typedef bool (*i2c_bus_check_t)(i2c_dev_t dev);
+
+/**
+ * @brief Create the bus (call once from app_main before any device driver)
+ * @param sda_pin SDA GPIO
+ * @param scl_pin SCL GPIO
+ * @param freq_hz Fastest SCL clock to try (devices may negotiate lower)
+ */
+esp_err_t i2c_bus_init(int sda_pin, int scl_pin, uint32_t freq_hz);
+
+/**
+ * @brief Register a device and negotiate its clock (idempotent)
+ * @param dev Device slot
+ * @param addr 7-bit address
+ * @param check Run at each candidate clock (may use i2c_bus_* on dev), NULL to skip
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if the check failed at every clock
+ */
+esp_err_t i2c_bus_add_device(i2c_dev_t dev, uint16_t addr, i2c_bus_check_t check);
+
+/**
+ * @brief Write len bytes in one transaction
+ */
+esp_err_t i2c_bus_write(i2c_dev_t dev, const uint8_t *data, size_t len);
+
+/**
+ * @brief Write one register (reg, value)
+ */
+esp_err_t i2c_bus_write_reg(i2c_dev_t dev, uint8_t reg, uint8_t value);
+
+/**
+ * @brief Read len bytes starting at reg (register write, repeated start, read)
+ */
+esp_err_t i2c_bus_read_reg(i2c_dev_t dev, uint8_t reg, uint8_t *data, size_t len);
+
+/**
+ * @brief Snapshot the per-client counters
+ * @param stats Array receiving one entry per client, in i2c_dev_t order
+ * @param max Capacity of stats
+ * @return Number of entries filled
+ */
+int i2c_bus_get_stats(i2c_bus_stats_t *stats, int max);
+
+#endif // I2C_BUS_H
@@ -0,0 +1,95 @@
+#include "input_latency.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "LATENCY";
+
+static const char *const stage_names[INPUT_STAGE_COUNT] = {
+    [INPUT_STAGE_DEBOUNCE]  = "debounce",
+    [INPUT_STAGE_KEY_QUEUE] = "key_queue",
+    [INPUT_STAGE_CONTROL]   = "control",
+    [INPUT_STAGE_LCD_QUEUE] = "lcd_queue",
+    [INPUT_STAGE_RENDER]    = "render",
+    [INPUT_STAGE_TOTAL]     = "total",
+};
+
+typedef struct {
+    uint32_t count;
+    uint64_t sum_us;
+    uint32_t max_us;
+    uint32_t hist[INPUT_LATENCY_BUCKETS];
+} stage_counters_t;
+
+// Written by lcd_task, read by comm_task
+static stage_counters_t counters[INPUT_STAGE_COUNT];
+static portMUX_TYPE counters_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Same buckets as the queue statistics: log2 of the latency in us
+static int latency_bucket(uint32_t us)
+{
+    int bucket = (us == 0) ? 0 : 32 - __builtin_clz(us);
+    return (bucket < INPUT_LATENCY_BUCKETS) ? bucket : INPUT_LATENCY_BUCKETS - 1;
+}
+
+static uint32_t span_us(int64_t from, int64_t to)
+{
+    if (to <= from) {
+        return 0;
+    }
+    return (to - from > UINT32_MAX) ? UINT32_MAX : (uint32_t)(to - from);
+}
+
+void input_latency_record(const input_trace_t *trace, int64_t received_us, int64_t glass_us)
+{
+    uint32_t us[INPUT_STAGE_COUNT] = {
+        [INPUT_STAGE_DEBOUNCE]  = span_us(trace->contact_us, trace->debounced_us),
+        [INPUT_STAGE_KEY_QUEUE] = span_us(trace->debounced_us, trace->received_us),
+        [INPUT_STAGE_CONTROL]   = span_us(trace->received_us, trace->sent_us),
+        [INPUT_STAGE_LCD_QUEUE] = span_us(trace->sent_us, received_us),
+        [INPUT_STAGE_RENDER]    = span_us(received_us, glass_us),
+        [INPUT_STAGE_TOTAL]     = span_us(trace->contact_us, glass_us),
+    };
+
+    taskENTER_CRITICAL(&counters_lock);
+    for (int i = 0; i < INPUT_STAGE_COUNT; i++) {
+        stage_counters_t *c = &counters[i];
+        c->count++;
+        c->sum_us += us[i];
+        if (us[i] > c->max_us) {
+            c->max_us = us[i];
+        }
+        c->hist[latency_bucket(us[i])]++;
+    }
+    taskEXIT_CRITICAL(&counters_lock);
+
+    ESP_LOGD(TAG, "Key to glass %lu us (debounce %lu, key queue %lu, control %lu, LCD queue %lu, render %lu)",
+             (unsigned long)us[INPUT_STAGE_TOTAL], (unsigned long)us[INPUT_STAGE_DEBOUNCE],
+             (unsigned long)us[INPUT_STAGE_KEY_QUEUE], (unsigned long)us[INPUT_STAGE_CONTROL],
+             (unsigned long)us[INPUT_STAGE_LCD_QUEUE], (unsigned long)us[INPUT_STAGE_RENDER]);
+}
+
+int input_latency_get_stats(input_latency_stats_t *stats, int max)
+{
+    int count = (max < INPUT_STAGE_COUNT) ? max : INPUT_STAGE_COUNT;
+    if (stats == NULL || count <= 0) {
+        return 0;
+    }
+
+    stage_counters_t snapshot[INPUT_STAGE_COUNT];
+    taskENTER_CRITICAL(&counters_lock);
+    memcpy(snapshot, counters, sizeof(snapshot));
+    taskEXIT_CRITICAL(&counters_lock);
+
+    for (int i = 0; i < count; i++) {
+        const stage_counters_t *c = &snapshot[i];
+        input_latency_stats_t *out = &stats[i];
+        out->name = stage_names[i];
+        out->count = c->count;
+        out->avg_us = c->count ? (uint32_t)(c->sum_us / c->count) : 0;
+        out->max_us = c->max_us;
+        memcpy(out->hist, c->hist, sizeof(out->hist));
+    }
+    return count;
+}
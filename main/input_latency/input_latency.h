@@ -0,0 +1,59 @@
+#ifndef INPUT_LATENCY_H
+#define INPUT_LATENCY_H
+
+#include <stdint.h>
+#include "../queue_manager/queue_manager.h"
+
+/*
+ * Keypress-to-glass latency. A key press carries its timestamps
+ * (input_trace_t) from the keypad scanner through control_task into the
+ * first LCD command it causes; lcd_task records them once that command has
+ * been rendered. Each stage and the total are kept as histograms:
+ *
+ *   debounce   contact (column interrupt or scan) -> press event
+ *   key_queue  press event -> control_task receives it
+ *   control    control_task receives the key -> LCD command queued
+ *   lcd_queue  LCD command queued -> lcd_task receives it
+ *   render     lcd_task receives the command -> last I2C write done
+ *   total      contact -> glass
+ */
+
+typedef enum {
+    INPUT_STAGE_DEBOUNCE,
+    INPUT_STAGE_KEY_QUEUE,
+    INPUT_STAGE_CONTROL,
+    INPUT_STAGE_LCD_QUEUE,
+    INPUT_STAGE_RENDER,
+    INPUT_STAGE_TOTAL,
+    INPUT_STAGE_COUNT
+} input_stage_t;
+
+// Histogram buckets: [0] < 1 us, [i] in [2^(i-1), 2^i) us, last open-ended (> 0.5 s)
+#define INPUT_LATENCY_BUCKETS 20
+
+// Per-stage counters since boot
+typedef struct {
+    const char *name;
+    uint32_t count;
+    uint32_t avg_us;
+    uint32_t max_us;
+    uint32_t hist[INPUT_LATENCY_BUCKETS];
+} input_latency_stats_t;
+
+/**
+ * @brief Record one key press once its LCD feedback is on the glass
+ * @param trace Timestamps carried by the LCD command
+ * @param received_us lcd_task received the command
+ * @param glass_us Rendering finished
+ */
+void input_latency_record(const input_trace_t *trace, int64_t received_us, int64_t glass_us);
+
+/**
+ * @brief Snapshot the per-stage counters
+ * @param stats Array receiving one entry per stage, in input_stage_t order
+ * @param max Capacity of stats
+ * @return Number of entries filled
+ */
+int input_latency_get_stats(input_latency_stats_t *stats, int max);
+
+#endif // INPUT_LATENCY_H
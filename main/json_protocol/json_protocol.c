@@ -1,6 +1,10 @@
 #include "json_protocol.h"
 #include "esp_log.h"
-#include "cJSON.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "JSON";
@@ -26,138 +30,846 @@ int string_to_state(const char *str)
     return -1;
 }
 
+// ============================================================================
+// Bounded output writer (writes straight into the caller's buffer, no malloc)
+// ============================================================================
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} buf_writer_t;
+
+// Append raw bytes, always leaving room for the NUL terminator
+static void buf_put(buf_writer_t *w, const char *s, size_t n)
+{
+    if (w->overflow || w->len + n >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+#define JSON_PUT_LITERAL(w, lit) buf_put((w), (lit), sizeof(lit) - 1)
+
+// Strings written here are fixed protocol tokens, so no escaping is needed
+static void json_put_str(buf_writer_t *w, const char *s)
+{
+    buf_put(w, s, strlen(s));
+}
+
+static void json_put_u32(buf_writer_t *w, uint32_t value)
+{
+    char digits[10];
+    int n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n] = (char)('0' + (value % 10));
+        value /= 10;
+        n++;
+    } while (value != 0);
+    buf_put(w, &digits[sizeof(digits) - n], n);
+}
+
+static void json_put_i32(buf_writer_t *w, int32_t value)
+{
+    if (value < 0) {
+        JSON_PUT_LITERAL(w, "-");
+    }
+    json_put_u32(w, (value < 0) ? 0u - (uint32_t)value : (uint32_t)value);
+}
+
+// Histogram array with trailing empty buckets trimmed
+static void json_put_hist(buf_writer_t *w, const uint32_t *hist, int buckets)
+{
+    while (buckets > 0 && hist[buckets - 1] == 0) {
+        buckets--;
+    }
+    JSON_PUT_LITERAL(w, "[");
+    for (int b = 0; b < buckets; b++) {
+        if (b > 0) {
+            JSON_PUT_LITERAL(w, ",");
+        }
+        json_put_u32(w, hist[b]);
+    }
+    JSON_PUT_LITERAL(w, "]");
+}
+
+// Number exactly as cJSON's print_number writes it, so the payload does not
+// change with the encoder: whole values as integers, everything else as the
+// shortest of "%1.15g" / "%1.17g" that reads back as the same double
+static void json_put_number(buf_writer_t *w, double value)
+{
+    if (isnan(value) || isinf(value)) {
+        JSON_PUT_LITERAL(w, "null");
+        return;
+    }
+
+    // cJSON's valueint, saturated at the int range
+    int valueint = (value >= INT_MAX) ? INT_MAX : (value <= (double)INT_MIN) ? INT_MIN : (int)value;
+    if (value == (double)valueint) {
+        json_put_i32(w, valueint);
+        return;
+    }
+
+    char num[26];
+    int len = snprintf(num, sizeof(num), "%1.15g", value);
+    double test = strtod(num, NULL);
+    if (fabs(test - value) > fmax(fabs(test), fabs(value)) * DBL_EPSILON) {
+        len = snprintf(num, sizeof(num), "%1.17g", value);
+    }
+    if (len < 0 || len >= (int)sizeof(num)) {
+        w->overflow = true;
+        return;
+    }
+    buf_put(w, num, (size_t)len);
+}
+
+static const char *event_type_to_string(event_type_t type)
+{
+    switch (type) {
+        case EVT_STATE_CHANGE: return "state_change";
+        case EVT_MOVEMENT:     return "movement";
+        case EVT_CODE_RESULT:  return "code_entry";
+        case EVT_CODE_CHANGED: return "code_changed";
+        case EVT_CALIBRATION:  return "calibration";
+        default:               return NULL;
+    }
+}
+
 int event_to_json(const event_t *event, char *buffer, size_t buffer_size)
 {
     if (event == NULL || buffer == NULL || buffer_size == 0) {
         return -1;
     }
 
-    cJSON *root = cJSON_CreateObject();
-    if (root == NULL) {
-        ESP_LOGE(TAG, "Failed to create JSON object for event serialization");
+    buf_writer_t w = { .buf = buffer, .size = buffer_size, .len = 0, .overflow = false };
+
+    // Field order matches the protocol spec: ts, state, event, then event-specific fields
+    JSON_PUT_LITERAL(&w, "{\"ts\":");
+    json_put_u32(&w, event->timestamp);
+    JSON_PUT_LITERAL(&w, ",\"state\":\"");
+    json_put_str(&w, state_to_string(event->state));
+    JSON_PUT_LITERAL(&w, "\"");
+
+    const char *type_str = event_type_to_string(event->type);
+    if (type_str != NULL) {
+        JSON_PUT_LITERAL(&w, ",\"event\":\"");
+        json_put_str(&w, type_str);
+        JSON_PUT_LITERAL(&w, "\"");
+    }
+
+    if (event->type == EVT_MOVEMENT) {
+        JSON_PUT_LITERAL(&w, ",\"movement_amount\":");
+        json_put_number(&w, event->movement_amount);
+    } else if (event->type == EVT_CODE_RESULT) {
+        if (event->code_ok) {
+            JSON_PUT_LITERAL(&w, ",\"code_ok\":true");
+        } else {
+            JSON_PUT_LITERAL(&w, ",\"code_ok\":false");
+        }
+    } else if (event->type == EVT_CALIBRATION) {
+        const sensor_calibration_t *cal = &event->calibration;
+        JSON_PUT_LITERAL(&w, ",\"rest\":[");
+        for (int i = 0; i < 3; i++) {
+            if (i > 0) {
+                JSON_PUT_LITERAL(&w, ",");
+            }
+            json_put_i32(&w, cal->rest_mg[i]);
+        }
+        JSON_PUT_LITERAL(&w, "],\"noise_mg\":");
+        json_put_u32(&w, cal->noise_mg);
+        JSON_PUT_LITERAL(&w, ",\"sigma_mg\":");
+        json_put_u32(&w, cal->sigma_mg);
+        JSON_PUT_LITERAL(&w, ",\"threshold\":");
+        json_put_i32(&w, cal->threshold);
+    }
+
+    if (event->dropped > 0) {
+        JSON_PUT_LITERAL(&w, ",\"dropped\":");
+        json_put_u32(&w, event->dropped);
+    }
+
+    JSON_PUT_LITERAL(&w, "}");
+
+    if (w.overflow) {
+        ESP_LOGE(TAG, "JSON output truncated: buffer size %zu", buffer_size);
         return -1;
     }
 
-    // Add timestamp and state
-    cJSON_AddNumberToObject(root, "ts", event->timestamp);
-    cJSON_AddStringToObject(root, "state", state_to_string(event->state));
+    buffer[w.len] = '\0';
+    ESP_LOGD(TAG, "Event JSON: %s", buffer);
+    return (int)w.len;
+}
 
-    // Add event-specific fields
-    switch (event->type) {
-        case EVT_STATE_CHANGE:
-            cJSON_AddStringToObject(root, "event", "state_change");
-            break;
+int queue_stats_to_json(const queue_stats_t *stats, int count, uint32_t timestamp,
+                        char *buffer, size_t buffer_size)
+{
+    if (stats == NULL || buffer == NULL || buffer_size == 0) {
+        return -1;
+    }
 
-        case EVT_MOVEMENT:
-            cJSON_AddStringToObject(root, "event", "movement");
-            cJSON_AddNumberToObject(root, "movement_amount", event->movement_amount);
-            break;
+    buf_writer_t w = { .buf = buffer, .size = buffer_size, .len = 0, .overflow = false };
 
-        case EVT_CODE_RESULT:
-            cJSON_AddStringToObject(root, "event", "code_entry");
-            cJSON_AddBoolToObject(root, "code_ok", event->code_ok);
-            break;
+    JSON_PUT_LITERAL(&w, "{\"ts\":");
+    json_put_u32(&w, timestamp);
+    JSON_PUT_LITERAL(&w, ",\"event\":\"stats\",\"queues\":[");
 
-        case EVT_CODE_CHANGED:
-            cJSON_AddStringToObject(root, "event", "code_changed");
-            break;
+    for (int i = 0; i < count; i++) {
+        const queue_stats_t *q = &stats[i];
+        if (i > 0) {
+            JSON_PUT_LITERAL(&w, ",");
+        }
+        JSON_PUT_LITERAL(&w, "{\"name\":\"");
+        json_put_str(&w, q->name);
+        JSON_PUT_LITERAL(&w, "\",\"len\":");
+        json_put_u32(&w, q->length);
+        JSON_PUT_LITERAL(&w, ",\"depth\":");
+        json_put_u32(&w, q->depth);
+        JSON_PUT_LITERAL(&w, ",\"hwm\":");
+        json_put_u32(&w, q->high_water);
+        JSON_PUT_LITERAL(&w, ",\"sent\":");
+        json_put_u32(&w, q->sent);
+        JSON_PUT_LITERAL(&w, ",\"dropped\":");
+        json_put_u32(&w, q->dropped);
+        JSON_PUT_LITERAL(&w, ",\"max_us\":");
+        json_put_u32(&w, q->max_residence_us);
+
+        JSON_PUT_LITERAL(&w, ",\"hist\":");
+        json_put_hist(&w, q->residence_hist, QUEUE_STATS_BUCKETS);
+        JSON_PUT_LITERAL(&w, "}");
     }
 
-    // Print to buffer
-    char *json_str = cJSON_PrintUnformatted(root);
-    if (json_str == NULL) {
-        cJSON_Delete(root);
+    JSON_PUT_LITERAL(&w, "]}");
+
+    if (w.overflow) {
+        ESP_LOGE(TAG, "Stats JSON truncated: buffer size %zu", buffer_size);
         return -1;
     }
 
-    int len = snprintf(buffer, buffer_size, "%s", json_str);
+    buffer[w.len] = '\0';
+    return (int)w.len;
+}
 
-    free(json_str);
-    cJSON_Delete(root);
+int i2c_bus_stats_to_json(const i2c_bus_stats_t *stats, int count, uint32_t timestamp,
+                          char *buffer, size_t buffer_size)
+{
+    if (stats == NULL || buffer == NULL || buffer_size == 0) {
+        return -1;
+    }
+
+    buf_writer_t w = { .buf = buffer, .size = buffer_size, .len = 0, .overflow = false };
+
+    JSON_PUT_LITERAL(&w, "{\"ts\":");
+    json_put_u32(&w, timestamp);
+    JSON_PUT_LITERAL(&w, ",\"event\":\"i2c\",\"clients\":[");
+
+    for (int i = 0; i < count; i++) {
+        const i2c_bus_stats_t *c = &stats[i];
+        if (i > 0) {
+            JSON_PUT_LITERAL(&w, ",");
+        }
+        JSON_PUT_LITERAL(&w, "{\"name\":\"");
+        json_put_str(&w, c->name);
+        JSON_PUT_LITERAL(&w, "\",\"prio\":");
+        json_put_u32(&w, c->priority);
+        JSON_PUT_LITERAL(&w, ",\"n\":");
+        json_put_u32(&w, c->transactions);
+        JSON_PUT_LITERAL(&w, ",\"err\":");
+        json_put_u32(&w, c->errors);
+        JSON_PUT_LITERAL(&w, ",\"wait_avg_us\":");
+        json_put_u32(&w, c->wait_avg_us);
+        JSON_PUT_LITERAL(&w, ",\"wait_max_us\":");
+        json_put_u32(&w, c->wait_max_us);
+        JSON_PUT_LITERAL(&w, ",\"xfer_avg_us\":");
+        json_put_u32(&w, c->xfer_avg_us);
+        JSON_PUT_LITERAL(&w, ",\"xfer_max_us\":");
+        json_put_u32(&w, c->xfer_max_us);
+        JSON_PUT_LITERAL(&w, ",\"khz\":");
+        json_put_u32(&w, c->speed_hz / 1000);
+        JSON_PUT_LITERAL(&w, ",\"downshifts\":");
+        json_put_u32(&w, c->downshifts);
+
+        JSON_PUT_LITERAL(&w, ",\"hist\":");
+        json_put_hist(&w, c->wait_hist, I2C_BUS_STATS_BUCKETS);
+        JSON_PUT_LITERAL(&w, "}");
+    }
+
+    JSON_PUT_LITERAL(&w, "]}");
 
-    if (len >= buffer_size) {
-        ESP_LOGE(TAG, "JSON output truncated: required %d bytes, buffer size %zu", len + 1, buffer_size);
+    if (w.overflow) {
+        ESP_LOGE(TAG, "I2C stats JSON truncated: buffer size %zu", buffer_size);
         return -1;
     }
-    ESP_LOGD(TAG, "Event JSON: %s", buffer);
-    return len;
+
+    buffer[w.len] = '\0';
+    return (int)w.len;
 }
 
-bool json_to_command(const char *json, size_t len, command_t *cmd)
+int input_latency_to_json(const input_latency_stats_t *stats, int count, uint32_t timestamp,
+                          char *buffer, size_t buffer_size)
 {
-    if (json == NULL || cmd == NULL || len == 0) {
-        return false;
+    if (stats == NULL || buffer == NULL || buffer_size == 0) {
+        return -1;
     }
 
-    cJSON *root = cJSON_ParseWithLength(json, len);
-    if (root == NULL) {
-        ESP_LOGE(TAG, "Failed to parse JSON command");
-        return false;
+    buf_writer_t w = { .buf = buffer, .size = buffer_size, .len = 0, .overflow = false };
+
+    JSON_PUT_LITERAL(&w, "{\"ts\":");
+    json_put_u32(&w, timestamp);
+    JSON_PUT_LITERAL(&w, ",\"event\":\"latency\",\"stages\":[");
+
+    for (int i = 0; i < count; i++) {
+        const input_latency_stats_t *st = &stats[i];
+        if (i > 0) {
+            JSON_PUT_LITERAL(&w, ",");
+        }
+        JSON_PUT_LITERAL(&w, "{\"name\":\"");
+        json_put_str(&w, st->name);
+        JSON_PUT_LITERAL(&w, "\",\"n\":");
+        json_put_u32(&w, st->count);
+        JSON_PUT_LITERAL(&w, ",\"avg_us\":");
+        json_put_u32(&w, st->avg_us);
+        JSON_PUT_LITERAL(&w, ",\"max_us\":");
+        json_put_u32(&w, st->max_us);
+
+        JSON_PUT_LITERAL(&w, ",\"hist\":");
+        json_put_hist(&w, st->hist, INPUT_LATENCY_BUCKETS);
+        JSON_PUT_LITERAL(&w, "}");
     }
 
-    // Get command field
-    cJSON *command = cJSON_GetObjectItem(root, "command");
-    if (!cJSON_IsString(command)) {
-        ESP_LOGE(TAG, "Missing or invalid 'command' field");
-        cJSON_Delete(root);
-        return false;
+    JSON_PUT_LITERAL(&w, "]}");
+
+    if (w.overflow) {
+        ESP_LOGE(TAG, "Latency JSON truncated: buffer size %zu", buffer_size);
+        return -1;
     }
 
-    const char *cmd_str = command->valuestring;
+    buffer[w.len] = '\0';
+    return (int)w.len;
+}
+
+// ============================================================================
+// CBOR encoder (RFC 8949) - compact binary alternative to event_to_json
+// ============================================================================
 
-    // Parse command type
-    if (strcmp(cmd_str, "lock") == 0) {
-        cmd->type = CMD_LOCK;
-        cmd->code[0] = '\0';
+// CBOR major types (top three bits of the initial byte)
+#define CBOR_MAJOR_UINT  0x00
+#define CBOR_MAJOR_NINT  0x20
+#define CBOR_MAJOR_ARRAY 0x80
+#define CBOR_MAJOR_MAP   0xA0
+#define CBOR_FALSE       0xF4
+#define CBOR_TRUE        0xF5
+#define CBOR_FLOAT32     0xFA
+
+static void cbor_put_head(buf_writer_t *w, uint8_t major, uint32_t value)
+{
+    uint8_t head[5];
+    size_t n;
+
+    if (value < 24) {
+        head[0] = major | (uint8_t)value;
+        n = 1;
+    } else if (value <= 0xFF) {
+        head[0] = major | 24;
+        head[1] = (uint8_t)value;
+        n = 2;
+    } else if (value <= 0xFFFF) {
+        head[0] = major | 25;
+        head[1] = (uint8_t)(value >> 8);
+        head[2] = (uint8_t)value;
+        n = 3;
+    } else {
+        head[0] = major | 26;
+        head[1] = (uint8_t)(value >> 24);
+        head[2] = (uint8_t)(value >> 16);
+        head[3] = (uint8_t)(value >> 8);
+        head[4] = (uint8_t)value;
+        n = 5;
     }
-    else if (strcmp(cmd_str, "unlock") == 0) {
-        cmd->type = CMD_UNLOCK;
-        cmd->code[0] = '\0';
+    buf_put(w, (const char *)head, n);
+}
+
+// Signed integer: major type 1 encodes -1 - n
+static void cbor_put_int(buf_writer_t *w, int32_t value)
+{
+    if (value < 0) {
+        cbor_put_head(w, CBOR_MAJOR_NINT, (uint32_t)(-1 - value));
+    } else {
+        cbor_put_head(w, CBOR_MAJOR_UINT, (uint32_t)value);
     }
-    else if (strcmp(cmd_str, "set_code") == 0) {
-        cmd->type = CMD_SET_CODE;
+}
 
-        cJSON *code = cJSON_GetObjectItem(root, "code");
-        if (!cJSON_IsString(code)) {
-            ESP_LOGE(TAG, "set_code requires 'code' field");
-            cJSON_Delete(root);
-            return false;
+static void cbor_put_float32(buf_writer_t *w, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint8_t out[5] = {
+        CBOR_FLOAT32,
+        (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8), (uint8_t)bits
+    };
+    buf_put(w, (const char *)out, sizeof(out));
+}
+
+static void cbor_put_bool(buf_writer_t *w, bool value)
+{
+    uint8_t b = value ? CBOR_TRUE : CBOR_FALSE;
+    buf_put(w, (const char *)&b, 1);
+}
+
+int event_to_cbor(const event_t *event, uint8_t *buffer, size_t buffer_size)
+{
+    if (event == NULL || buffer == NULL || buffer_size == 0) {
+        return -1;
+    }
+
+    buf_writer_t w = { .buf = (char *)buffer, .size = buffer_size, .len = 0, .overflow = false };
+
+    bool has_movement = (event->type == EVT_MOVEMENT);
+    bool has_code_ok = (event->type == EVT_CODE_RESULT);
+    bool has_calibration = (event->type == EVT_CALIBRATION);
+    bool has_dropped = (event->dropped > 0);
+    uint32_t pairs = 3 + (has_movement ? 1 : 0) + (has_code_ok ? 1 : 0) +
+                     (has_calibration ? 4 : 0) + (has_dropped ? 1 : 0);
+
+    // Same fields as the JSON form, keyed by small integers (see json_protocol.h)
+    cbor_put_head(&w, CBOR_MAJOR_MAP, pairs);
+    cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_TS);
+    cbor_put_head(&w, CBOR_MAJOR_UINT, event->timestamp);
+    cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_STATE);
+    cbor_put_head(&w, CBOR_MAJOR_UINT, (uint32_t)event->state);
+    cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_EVENT);
+    cbor_put_head(&w, CBOR_MAJOR_UINT, (uint32_t)event->type);
+
+    if (has_movement) {
+        cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_MOVEMENT_AMOUNT);
+        cbor_put_float32(&w, event->movement_amount);
+    } else if (has_code_ok) {
+        cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_CODE_OK);
+        cbor_put_bool(&w, event->code_ok);
+    } else if (has_calibration) {
+        const sensor_calibration_t *cal = &event->calibration;
+        cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_REST);
+        cbor_put_head(&w, CBOR_MAJOR_ARRAY, 3);
+        for (int i = 0; i < 3; i++) {
+            cbor_put_int(&w, cal->rest_mg[i]);
         }
+        cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_NOISE_MG);
+        cbor_put_head(&w, CBOR_MAJOR_UINT, cal->noise_mg);
+        cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_SIGMA_MG);
+        cbor_put_head(&w, CBOR_MAJOR_UINT, cal->sigma_mg);
+        cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_THRESHOLD);
+        cbor_put_int(&w, cal->threshold);
+    }
+
+    if (has_dropped) {
+        cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_DROPPED);
+        cbor_put_head(&w, CBOR_MAJOR_UINT, event->dropped);
+    }
 
-        // Validate code length
-        size_t code_len = strlen(code->valuestring);
-        if (code_len >= sizeof(cmd->code)) {
-            ESP_LOGE(TAG, "Code too long (max %d chars)", (int)(sizeof(cmd->code) - 1));
-            cJSON_Delete(root);
+    if (w.overflow) {
+        ESP_LOGE(TAG, "CBOR output truncated: buffer size %zu", buffer_size);
+        return -1;
+    }
+    return (int)w.len;
+}
+
+int event_encode(const event_t *event, telemetry_format_t format, char *buffer, size_t buffer_size)
+{
+    switch (format) {
+        case TELEMETRY_FORMAT_JSON:
+            return event_to_json(event, buffer, buffer_size);
+        case TELEMETRY_FORMAT_CBOR:
+            return event_to_cbor(event, (uint8_t *)buffer, buffer_size);
+        default:
+            ESP_LOGE(TAG, "Invalid telemetry format: %d", format);
+            return -1;
+    }
+}
+
+const char* telemetry_format_to_string(telemetry_format_t format)
+{
+    switch (format) {
+        case TELEMETRY_FORMAT_JSON: return "json";
+        case TELEMETRY_FORMAT_CBOR: return "cbor";
+        default:                    return "unknown";
+    }
+}
+
+// ============================================================================
+// Telemetry batches (already-serialized events spliced into one message)
+// ============================================================================
+
+#define CBOR_ARRAY_INDEFINITE 0x9F
+#define CBOR_BREAK            0xFF
+
+void telemetry_batch_init(telemetry_batch_t *batch, telemetry_format_t format, char *buffer, size_t buffer_size)
+{
+    batch->buf = buffer;
+    batch->size = buffer_size;
+    batch->len = 0;
+    batch->format = format;
+    batch->count = 0;
+
+    // Opening byte: JSON array, or CBOR indefinite-length array (count unknown up front)
+    if (buffer_size > 2) {
+        buffer[0] = (format == TELEMETRY_FORMAT_CBOR) ? (char)CBOR_ARRAY_INDEFINITE : '[';
+        batch->len = 1;
+    }
+}
+
+bool telemetry_batch_add(telemetry_batch_t *batch, uint32_t seq, const char *payload, size_t len)
+{
+    if (batch->len == 0 || payload == NULL || len < 2) {
+        return false;
+    }
+
+    // Reserve one byte for the closing ']' / break (buf_put keeps one more for NUL)
+    buf_writer_t w = { .buf = batch->buf, .size = batch->size - 1, .len = batch->len, .overflow = false };
+
+    if (batch->format == TELEMETRY_FORMAT_CBOR) {
+        // Bump the map header by one pair and insert seq right after it
+        uint8_t head = (uint8_t)payload[0];
+        if (head < CBOR_MAJOR_MAP || head >= CBOR_MAJOR_MAP + 23) {
             return false;
         }
+        uint8_t new_head = head + 1;
+        buf_put(&w, (const char *)&new_head, 1);
+        cbor_put_head(&w, CBOR_MAJOR_UINT, CBOR_KEY_SEQ);
+        cbor_put_head(&w, CBOR_MAJOR_UINT, seq);
+        buf_put(&w, payload + 1, len - 1);
+    } else {
+        // {"seq":N, followed by the original object minus its opening brace
+        if (payload[0] != '{') {
+            return false;
+        }
+        if (batch->count > 0) {
+            JSON_PUT_LITERAL(&w, ",");
+        }
+        JSON_PUT_LITERAL(&w, "{\"seq\":");
+        json_put_u32(&w, seq);
+        if (payload[1] != '}') {
+            JSON_PUT_LITERAL(&w, ",");
+        }
+        buf_put(&w, payload + 1, len - 1);
+    }
+
+    if (w.overflow) {
+        return false;  // Batch left unchanged; caller publishes what it has
+    }
+    batch->len = w.len;
+    batch->count++;
+    return true;
+}
+
+int telemetry_batch_finish(telemetry_batch_t *batch)
+{
+    if (batch->len == 0 || batch->count == 0) {
+        return -1;
+    }
+
+    if (batch->format == TELEMETRY_FORMAT_CBOR) {
+        batch->buf[batch->len++] = (char)CBOR_BREAK;
+    } else {
+        batch->buf[batch->len++] = ']';
+        batch->buf[batch->len] = '\0';
+    }
+    return (int)batch->len;
+}
+
+// ============================================================================
+// In-place command parser (single pass over the MQTT payload, no copy, no DOM)
+// ============================================================================
+
+typedef enum {
+    JSON_KIND_NONE = 0,  // Field not present
+    JSON_KIND_STRING,    // Slice excludes the quotes, escapes left as-is
+    JSON_KIND_NUMBER,
+    JSON_KIND_LITERAL    // true / false / null
+} json_kind_t;
+
+typedef struct {
+    json_kind_t kind;
+    const char *ptr;
+    size_t len;
+    bool escaped;        // String contains backslash escapes
+} json_slice_t;
+
+typedef struct {
+    const char *p;
+    const char *end;
+} json_cursor_t;
+
+static void json_skip_ws(json_cursor_t *c)
+{
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r')) {
+        c->p++;
+    }
+}
+
+static bool json_expect(json_cursor_t *c, char ch)
+{
+    json_skip_ws(c);
+    if (c->p >= c->end || *c->p != ch) {
+        return false;
+    }
+    c->p++;
+    return true;
+}
+
+static bool json_scan_string(json_cursor_t *c, json_slice_t *out)
+{
+    // Opening quote already checked by caller
+    const char *start = ++c->p;
+    bool escaped = false;
+
+    while (c->p < c->end) {
+        unsigned char ch = (unsigned char)*c->p;
+        if (ch == '"') {
+            out->kind = JSON_KIND_STRING;
+            out->ptr = start;
+            out->len = (size_t)(c->p - start);
+            out->escaped = escaped;
+            c->p++;
+            return true;
+        }
+        if (ch < 0x20) {
+            return false;  // Raw control characters are not valid JSON
+        }
+        if (ch == '\\') {
+            escaped = true;
+            c->p++;  // Skip escaped character (\u digits are plain characters)
+            if (c->p >= c->end) {
+                return false;
+            }
+        }
+        c->p++;
+    }
+    return false;  // Unterminated string
+}
+
+static bool json_is_digit(const json_cursor_t *c)
+{
+    return c->p < c->end && *c->p >= '0' && *c->p <= '9';
+}
+
+// Validates the JSON number grammar: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool json_scan_number(json_cursor_t *c, json_slice_t *out)
+{
+    const char *start = c->p;
+
+    if (c->p < c->end && *c->p == '-') c->p++;
+    if (!json_is_digit(c)) return false;
+    if (*c->p == '0') {
+        c->p++;
+    } else {
+        while (json_is_digit(c)) c->p++;
+    }
+    if (c->p < c->end && *c->p == '.') {
+        c->p++;
+        if (!json_is_digit(c)) return false;
+        while (json_is_digit(c)) c->p++;
+    }
+    if (c->p < c->end && (*c->p == 'e' || *c->p == 'E')) {
+        c->p++;
+        if (c->p < c->end && (*c->p == '+' || *c->p == '-')) c->p++;
+        if (!json_is_digit(c)) return false;
+        while (json_is_digit(c)) c->p++;
+    }
+
+    out->kind = JSON_KIND_NUMBER;
+    out->ptr = start;
+    out->len = (size_t)(c->p - start);
+    out->escaped = false;
+    return true;
+}
+
+static bool json_scan_literal(json_cursor_t *c, const char *lit, size_t lit_len, json_slice_t *out)
+{
+    if ((size_t)(c->end - c->p) < lit_len || memcmp(c->p, lit, lit_len) != 0) {
+        return false;
+    }
+    out->kind = JSON_KIND_LITERAL;
+    out->ptr = c->p;
+    out->len = lit_len;
+    out->escaped = false;
+    c->p += lit_len;
+    return true;
+}
 
-        // Safe to copy - length already validated
-        strcpy(cmd->code, code->valuestring);
+// Scalar values only: commands are flat objects, nested values are rejected
+static bool json_scan_value(json_cursor_t *c, json_slice_t *out)
+{
+    json_skip_ws(c);
+    if (c->p >= c->end) {
+        return false;
     }
-    else if (strcmp(cmd_str, "reset_alarm") == 0) {
-        cmd->type = CMD_RESET_ALARM;
-        cmd->code[0] = '\0';
+    switch (*c->p) {
+        case '"': return json_scan_string(c, out);
+        case 't': return json_scan_literal(c, "true", 4, out);
+        case 'f': return json_scan_literal(c, "false", 5, out);
+        case 'n': return json_scan_literal(c, "null", 4, out);
+        default:  return json_scan_number(c, out);
     }
-    else if (strcmp(cmd_str, "set_sensitivity") == 0) {
-        cmd->type = CMD_SET_SENSITIVITY;
-        cmd->code[0] = '\0';
+}
+
+static bool json_slice_equals(const json_slice_t *s, const char *lit, size_t lit_len)
+{
+    return s->len == lit_len && memcmp(s->ptr, lit, lit_len) == 0;
+}
 
-        cJSON *sensitivity = cJSON_GetObjectItem(root, "value");
-        if (!cJSON_IsNumber(sensitivity)) {
-            ESP_LOGE(TAG, "set_sensitivity requires 'value' field");
-            cJSON_Delete(root);
+#define JSON_SLICE_IS(s, lit) json_slice_equals((s), (lit), sizeof(lit) - 1)
+
+// Map command string to command_type_t: switch on length, then one memcmp
+static int command_from_slice(const json_slice_t *s)
+{
+    switch (s->len) {
+        case 4:  return JSON_SLICE_IS(s, "lock") ? CMD_LOCK : -1;
+        case 6:  return JSON_SLICE_IS(s, "unlock") ? CMD_UNLOCK : -1;
+        case 8:  return JSON_SLICE_IS(s, "set_code") ? CMD_SET_CODE : -1;
+        case 9:  return JSON_SLICE_IS(s, "calibrate") ? CMD_CALIBRATE : -1;
+        case 10: return JSON_SLICE_IS(s, "set_format") ? CMD_SET_FORMAT : -1;
+        case 11: return JSON_SLICE_IS(s, "reset_alarm") ? CMD_RESET_ALARM : -1;
+        case 15: return JSON_SLICE_IS(s, "set_sensitivity") ? CMD_SET_SENSITIVITY : -1;
+        default: return -1;
+    }
+}
+
+// Convert a validated number slice to int32 (truncating, saturating like a clamp)
+static bool number_slice_to_int32(const json_slice_t *s, int32_t *out)
+{
+    char tmp[32];
+    if (s->len >= sizeof(tmp)) {
+        return false;
+    }
+    memcpy(tmp, s->ptr, s->len);
+    tmp[s->len] = '\0';
+
+    double value = strtod(tmp, NULL);
+    if (value >= (double)INT32_MAX) {
+        *out = INT32_MAX;
+    } else if (value <= (double)INT32_MIN) {
+        *out = INT32_MIN;
+    } else {
+        *out = (int32_t)value;
+    }
+    return true;
+}
+
+bool json_to_command(const char *json, size_t len, command_t *cmd)
+{
+    if (json == NULL || cmd == NULL || len == 0) {
+        return false;
+    }
+
+    json_cursor_t c = { .p = json, .end = json + len };
+    json_slice_t command = {0};
+    json_slice_t code = {0};
+    json_slice_t value = {0};
+
+    // Single pass over the top-level object, remembering only the fields we use.
+    // Like cJSON_GetObjectItem, the first occurrence of a duplicated key wins.
+    if (!json_expect(&c, '{')) {
+        ESP_LOGE(TAG, "Failed to parse JSON command");
+        return false;
+    }
+    json_skip_ws(&c);
+    if (c.p < c.end && *c.p == '}') {
+        c.p++;
+    } else {
+        while (1) {
+            json_slice_t key;
+            json_slice_t val;
+            json_skip_ws(&c);
+            if (c.p >= c.end || *c.p != '"' || !json_scan_string(&c, &key) ||
+                !json_expect(&c, ':') || !json_scan_value(&c, &val)) {
+                ESP_LOGE(TAG, "Failed to parse JSON command");
+                return false;
+            }
+
+            if (command.kind == JSON_KIND_NONE && JSON_SLICE_IS(&key, "command")) {
+                command = val;
+            } else if (code.kind == JSON_KIND_NONE && JSON_SLICE_IS(&key, "code")) {
+                code = val;
+            } else if (value.kind == JSON_KIND_NONE && JSON_SLICE_IS(&key, "value")) {
+                value = val;
+            }
+
+            json_skip_ws(&c);
+            if (c.p < c.end && *c.p == ',') {
+                c.p++;
+                continue;
+            }
+            if (c.p < c.end && *c.p == '}') {
+                c.p++;
+                break;
+            }
+            ESP_LOGE(TAG, "Failed to parse JSON command");
             return false;
         }
-        cmd->sensitivity = (int32_t)sensitivity->valuedouble;
     }
-    else {
-        ESP_LOGE(TAG, "Unknown command: %s", cmd_str);
-        cJSON_Delete(root);
+
+    // Only whitespace (or NUL padding from some clients) may follow the object
+    while (c.p < c.end && (*c.p == ' ' || *c.p == '\t' || *c.p == '\n' || *c.p == '\r' || *c.p == '\0')) {
+        c.p++;
+    }
+    if (c.p != c.end) {
+        ESP_LOGE(TAG, "Trailing data after JSON command");
+        return false;
+    }
+
+    if (command.kind != JSON_KIND_STRING) {
+        ESP_LOGE(TAG, "Missing or invalid 'command' field");
+        return false;
+    }
+
+    int type = command_from_slice(&command);
+    if (type < 0) {
+        ESP_LOGE(TAG, "Unknown command: %.*s", (int)command.len, command.ptr);
         return false;
     }
 
-    ESP_LOGI(TAG, "Parsed command: %s", cmd_str);
-    cJSON_Delete(root);
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->type = (command_type_t)type;
+
+    switch (cmd->type) {
+        case CMD_SET_CODE:
+            // PINs are plain digits, so escaped strings are never valid codes
+            if (code.kind != JSON_KIND_STRING || code.escaped) {
+                ESP_LOGE(TAG, "set_code requires 'code' field");
+                return false;
+            }
+            if (code.len >= sizeof(cmd->code)) {
+                ESP_LOGE(TAG, "Code too long (max %d chars)", (int)(sizeof(cmd->code) - 1));
+                return false;
+            }
+            memcpy(cmd->code, code.ptr, code.len);
+            cmd->code[code.len] = '\0';
+            break;
+
+        case CMD_SET_SENSITIVITY:
+            if (value.kind != JSON_KIND_NUMBER || !number_slice_to_int32(&value, &cmd->sensitivity)) {
+                ESP_LOGE(TAG, "set_sensitivity requires 'value' field");
+                return false;
+            }
+            break;
+
+        case CMD_SET_FORMAT:
+            if (value.kind == JSON_KIND_STRING && JSON_SLICE_IS(&value, "json")) {
+                cmd->format = TELEMETRY_FORMAT_JSON;
+            } else if (value.kind == JSON_KIND_STRING && JSON_SLICE_IS(&value, "cbor")) {
+                cmd->format = TELEMETRY_FORMAT_CBOR;
+            } else {
+                ESP_LOGE(TAG, "set_format requires 'value' of \"json\" or \"cbor\"");
+                return false;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    ESP_LOGI(TAG, "Parsed command: %.*s", (int)command.len, command.ptr);
     return true;
 }
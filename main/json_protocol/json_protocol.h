@@ -24,15 +24,119 @@
  *   {"ts":1234567890,"state":"locked","event":"code_entry","code_ok":true}
  *   {"ts":1234567890,"state":"locked","event":"code_entry","code_ok":false}
  *
+ * Calibration Event (accelerometer calibrated, at first boot, on the
+ * calibrate command and periodically while quiet):
+ *   {"ts":1234567890,"state":"locked","event":"calibration","rest":[12,-498,866],
+ *    "noise_mg":9,"sigma_mg":2,"threshold":18841}
+ *
  * Fields:
  *   ts              - Unix timestamp (seconds since epoch)
  *   state           - Current safe state: "locked", "unlocked", "alarm"
  *                     - locked:   Red LED solid ON
  *                     - unlocked: Green LED solid ON
  *                     - alarm:    Red LED FLASHING (tamper or 3+ wrong PINs)
- *   event           - Event type: "state_change", "movement", "code_entry"
- *   movement_amount - Float (g units), present only for movement events
+ *   event           - Event type: "state_change", "movement", "code_entry",
+ *                     "code_changed", "calibration"
+ *   movement_amount - Float (g units, as cJSON prints it), present only for
+ *                     movement events: tamper score, the RMS dynamic
+ *                     acceleration with gravity removed
  *   code_ok         - Boolean, present only for code entry events
+ *   rest            - Resting acceleration per axis in mg (X, Y, Z; gravity
+ *                     and mounting angle), calibration events only
+ *   noise_mg        - Tamper score at rest (noise floor), calibration only
+ *   sigma_mg        - Standard deviation of the score at rest, calibration only
+ *   threshold       - Sensitivity derived from the noise floor (same scale as
+ *                     set_sensitivity), calibration only
+ *   dropped         - Number of telemetry events lost since boot (buffer and
+ *                     flash spool full); present only when non-zero
+ *
+ * -------------------------------------------------------------------------
+ * BINARY TELEMETRY (CBOR, RFC 8949)
+ * -------------------------------------------------------------------------
+ *
+ * Selected with TELEMETRY_FORMAT in config.h or the set_format command.
+ * Published on smartsafe/<device_id>/telemetry/cbor so dashboards can tell
+ * the formats apart. Same fields as JSON, as a map with integer keys and
+ * integer-coded enums:
+ *
+ *   0 ts              - uint
+ *   1 state           - uint (safe_state_t: 0=locked, 1=unlocked, 2=alarm)
+ *   2 event           - uint (event_type_t: 0=state_change, 1=movement,
+ *                             2=code_entry, 3=code_changed, 4=calibration)
+ *   3 movement_amount - float32, movement events only
+ *   4 code_ok         - bool, code entry events only
+ *   6 dropped         - uint, only when non-zero
+ *   7 rest            - array of 3 ints, calibration events only
+ *   8 noise_mg        - uint, calibration events only
+ *   9 sigma_mg        - uint, calibration events only
+ *  10 threshold       - int, calibration events only
+ *
+ *   {"ts":1234,"state":"locked","event":"state_change"}  (51 bytes JSON)
+ *   A3 00 19 04 D2 01 00 02 00                           (9 bytes CBOR)
+ *
+ * -------------------------------------------------------------------------
+ * BATCHED TELEMETRY (TELEMETRY_BATCHING enabled in config.h)
+ * -------------------------------------------------------------------------
+ *
+ * Events queued within the batch window are published as one message on the
+ * same topic: an array of the events above, each with a leading sequence
+ * number (key 5 in CBOR, an indefinite-length array). Sequence numbers let
+ * dashboards drop duplicates after a QoS 1 retry; with the flash spool they
+ * continue across reboots.
+ *
+ *   [{"seq":7,"ts":1234,"state":"locked","event":"code_entry","code_ok":false},
+ *    {"seq":8,"ts":1234,"state":"alarm","event":"state_change"}]
+ *
+ * -------------------------------------------------------------------------
+ * QUEUE STATISTICS (every QUEUE_STATS_INTERVAL_MS, always JSON, QoS 0)
+ * -------------------------------------------------------------------------
+ *
+ * Health of the inter-task queues, published on the telemetry topic:
+ *
+ *   {"ts":1234,"event":"stats","queues":[
+ *     {"name":"Key","len":10,"depth":0,"hwm":2,"sent":41,"dropped":0,
+ *      "max_us":5210,"hist":[0,0,0,0,0,3,12,20,6]}, ...]}
+ *
+ * Fields (per queue, counters since boot):
+ *   len     - Capacity
+ *   depth   - Items queued when the snapshot was taken
+ *   hwm     - Most items ever queued at once
+ *   sent    - Items enqueued
+ *   dropped - Sends rejected because the queue was full
+ *   max_us  - Longest time an item waited in the queue (microseconds)
+ *   hist    - Wait time histogram: hist[0] < 1 us, hist[i] in [2^(i-1), 2^i) us,
+ *             last of 20 buckets open-ended; trailing zero buckets omitted
+ *
+ * I2C bus arbiter statistics, published on the telemetry topic:
+ *
+ *   {"ts":1234,"event":"i2c","clients":[
+ *     {"name":"mpu6050","prio":2,"n":30012,"err":0,"wait_avg_us":41,
+ *      "wait_max_us":1890,"xfer_avg_us":180,"xfer_max_us":330,"khz":400,
+ *      "downshifts":0,"hist":[29870,0,0,0,0,0,12,90,31,8,1]}, ...]}
+ *
+ * Fields (per client, counters since boot):
+ *   prio        - Arbitration priority (higher is served first)
+ *   n           - Transactions
+ *   err         - Failed transfers and timed out bus grants
+ *   wait_avg_us, wait_max_us - Time from request to bus grant
+ *   xfer_avg_us, xfer_max_us - Time the transaction held the bus
+ *   khz         - Current SCL clock of the device
+ *   downshifts  - Times it fell back to 100 kHz after repeated errors
+ *   hist        - Wait histogram, buckets as for queue stats (16 buckets)
+ *
+ * Keypress-to-glass latency (see input_latency.h), published on the
+ * telemetry topic after the I2C statistics:
+ *
+ *   {"ts":1234,"event":"latency","stages":[
+ *     {"name":"debounce","n":52,"avg_us":19870,"max_us":23950,
+ *      "hist":[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,49,3]}, ...,
+ *     {"name":"total","n":52,"avg_us":21400,"max_us":27110,"hist":[...]}]}
+ *
+ * Fields (per stage, counters since boot):
+ *   name    - debounce, key_queue, control, lcd_queue, render or total
+ *   n       - Key presses measured (those that changed the LCD)
+ *   avg_us, max_us - Time spent in the stage
+ *   hist    - Histogram, buckets as for queue stats (20 buckets)
  *
  * -------------------------------------------------------------------------
  * COMMAND MESSAGES (received by ESP32)
@@ -50,18 +154,100 @@
  * Reset Alarm Command:
  *   {"command":"reset_alarm"}
  *
+ * Calibrate Command (re-learn the accelerometer noise floor; keep the safe
+ * still for a few seconds, the result is reported as a calibration event):
+ *   {"command":"calibrate"}
+ *
+ * Set Telemetry Format Command:
+ *   {"command":"set_format","value":"cbor"}
+ *   {"command":"set_format","value":"json"}
+ *
  * Fields:
- *   command - Command type: "lock", "unlock", "set_code", "reset_alarm"
+ *   command - Command type: "lock", "unlock", "set_code", "reset_alarm",
+ *             "set_sensitivity", "set_format", "calibrate"
  *   code    - New PIN code (required only for set_code command)
+ *   value   - Sensitivity number, or "json"/"cbor" for set_format
  */
 
 #include "../queue_manager/queue_manager.h"
+#include "../i2c_bus/i2c_bus.h"
+#include "../input_latency/input_latency.h"
 #include <stdbool.h>
 
-// Convert event to JSON string for MQTT publishing
+// Convert event to JSON string for MQTT publishing.
+// Writes directly into buffer without heap allocation; returns length or -1.
+// Byte-identical to the cJSON encoder it replaced (tools/json_bench).
 int event_to_json(const event_t *event, char *buffer, size_t buffer_size);
 
-// Parse JSON command string into command struct
+// Convert queue statistics to the "stats" telemetry message (no heap);
+// returns length or -1
+int queue_stats_to_json(const queue_stats_t *stats, int count, uint32_t timestamp,
+                        char *buffer, size_t buffer_size);
+
+// Convert I2C bus statistics to the "i2c" telemetry message (no heap);
+// returns length or -1
+int i2c_bus_stats_to_json(const i2c_bus_stats_t *stats, int count, uint32_t timestamp,
+                          char *buffer, size_t buffer_size);
+
+// Convert keypress-to-glass latency to the "latency" telemetry message
+// (no heap); returns length or -1
+int input_latency_to_json(const input_latency_stats_t *stats, int count, uint32_t timestamp,
+                          char *buffer, size_t buffer_size);
+
+// CBOR map keys for binary telemetry
+#define CBOR_KEY_TS              0
+#define CBOR_KEY_STATE           1
+#define CBOR_KEY_EVENT           2
+#define CBOR_KEY_MOVEMENT_AMOUNT 3
+#define CBOR_KEY_CODE_OK         4
+#define CBOR_KEY_SEQ             5  // Batched telemetry only
+#define CBOR_KEY_DROPPED         6
+#define CBOR_KEY_REST            7
+#define CBOR_KEY_NOISE_MG        8
+#define CBOR_KEY_SIGMA_MG        9
+#define CBOR_KEY_THRESHOLD       10
+
+// Convert event to CBOR for MQTT publishing (no heap); returns length or -1
+int event_to_cbor(const event_t *event, uint8_t *buffer, size_t buffer_size);
+
+// Encode event in the given wire format; returns length or -1
+int event_encode(const event_t *event, telemetry_format_t format, char *buffer, size_t buffer_size);
+
+// Convert telemetry_format_t to string ("json", "cbor")
+const char* telemetry_format_to_string(telemetry_format_t format);
+
+// Batch of serialized events being assembled into one MQTT message
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    telemetry_format_t format;
+    int count;
+} telemetry_batch_t;
+
+// Longest event_to_json() output plus the NUL: a calibration event with
+// every field at the widest its type allows (CBOR is smaller)
+#define EVENT_JSON_MAX_SIZE sizeof("{\"ts\":4294967295,\"state\":\"unlocked\",\"event\":\"calibration\"," \
+                                   "\"rest\":[-32768,-32768,-32768],\"noise_mg\":65535,\"sigma_mg\":65535," \
+                                   "\"threshold\":-2147483648,\"dropped\":4294967295}")
+
+// Bytes a batch adds around one event of its payload: the array brackets,
+// "seq":<10 digits>, and the NUL (JSON; CBOR needs less)
+#define TELEMETRY_BATCH_OVERHEAD 20
+
+// Start a batch in buffer (writes the array opener)
+void telemetry_batch_init(telemetry_batch_t *batch, telemetry_format_t format, char *buffer, size_t buffer_size);
+
+// Append an event serialized by event_encode() in the batch's format, tagging
+// it with seq. Returns false (batch unchanged) if it does not fit.
+bool telemetry_batch_add(telemetry_batch_t *batch, uint32_t seq, const char *payload, size_t len);
+
+// Close the array; returns total length or -1 if the batch is empty
+int telemetry_batch_finish(telemetry_batch_t *batch);
+
+// Parse JSON command into command struct.
+// Works in place on json[0..len) (no NUL terminator or copy needed) and
+// never allocates; rejects malformed or nested input.
 bool json_to_command(const char *json, size_t len, command_t *cmd);
 
 // Convert safe_state_t to string ("locked", "unlocked", "alarm")
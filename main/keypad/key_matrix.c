@@ -0,0 +1,66 @@
+#include "key_matrix.h"
+#include <string.h>
+
+void key_matrix_init(key_matrix_t *km, uint8_t debounce_scans)
+{
+    memset(km, 0, sizeof(*km));
+    km->debounce_scans = debounce_scans ? debounce_scans : 1;
+}
+
+uint16_t key_matrix_ghost_rows(uint16_t raw)
+{
+    uint16_t blocked = 0;
+    for (int a = 0; a < 3; a++) {
+        for (int b = a + 1; b < 4; b++) {
+            uint16_t shared = (raw >> (a * 4)) & (raw >> (b * 4)) & 0xF;
+            if (shared & (shared - 1)) {
+                blocked |= (0xF << (a * 4)) | (0xF << (b * 4));
+            }
+        }
+    }
+    return blocked;
+}
+
+int key_matrix_scan(key_matrix_t *km, uint16_t raw, int64_t since_us, int64_t now_us, key_change_t *changes)
+{
+    uint16_t blocked = key_matrix_ghost_rows(raw);
+    int count = 0;
+
+    for (int i = 0; i < KEY_MATRIX_KEYS; i++) {
+        uint16_t bit = 1u << i;
+        uint8_t *integ = &km->integrator[i];
+
+        if (raw & bit) {
+            if ((blocked & bit) || *integ >= km->debounce_scans) {
+                continue;
+            }
+            if (*integ == 0) {
+                km->contact_us[i] = since_us;
+            }
+            if (++*integ == km->debounce_scans && !(km->pressed & bit)) {
+                km->pressed |= bit;
+                km->pressed_us[i] = now_us;
+                changes[count++] = (key_change_t){
+                    .index = (uint8_t)i, .pressed = true, .contact_us = km->contact_us[i],
+                };
+            }
+        } else if (*integ > 0 && --*integ == 0 && (km->pressed & bit)) {
+            km->pressed &= ~bit;
+            changes[count++] = (key_change_t){
+                .index = (uint8_t)i, .pressed = false,
+                .hold_ms = (uint32_t)((now_us - km->pressed_us[i]) / 1000),
+            };
+        }
+    }
+    return count;
+}
+
+bool key_matrix_idle(const key_matrix_t *km)
+{
+    for (int i = 0; i < KEY_MATRIX_KEYS; i++) {
+        if (km->integrator[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef KEY_MATRIX_H
+#define KEY_MATRIX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Key matrix debouncer: turns complete scans of a 4x4 matrix (a bitmap of
+ * closed contacts, bit row * 4 + col) into press and release changes.
+ *
+ *   integrator - per key, counts up on scans with the contact closed and
+ *                down on open ones; the key becomes pressed at the top of
+ *                the range and released at zero
+ *   ghosting   - without diodes, three closed keys on the corners of a
+ *                rectangle also close the fourth. Rows sharing two or more
+ *                closed columns are ambiguous; their keys may not become
+ *                pressed that scan (they may still be released)
+ *   timing     - each key remembers when its contact was first seen and
+ *                when it was pressed, for latency and hold times
+ *
+ * Host-buildable (no ESP-IDF dependencies) so tools/key_bench runs the
+ * exact device code on synthetic key bursts.
+ */
+
+#define KEY_MATRIX_KEYS 16
+
+typedef struct {
+    uint8_t integrator[KEY_MATRIX_KEYS];   // 0 = released ... debounce_scans = pressed
+    uint8_t debounce_scans;
+    uint16_t pressed;                      // Debounced state
+    int64_t contact_us[KEY_MATRIX_KEYS];   // Contact first seen (integrator left zero)
+    int64_t pressed_us[KEY_MATRIX_KEYS];   // Press change
+} key_matrix_t;
+
+typedef struct {
+    uint8_t index;          // Key bit (row * 4 + col)
+    bool pressed;           // Press or release
+    int64_t contact_us;     // Press: contact first seen
+    uint32_t hold_ms;       // Release: time since the press
+} key_change_t;
+
+/**
+ * @brief Reset the debouncer (all keys released)
+ * @param debounce_scans Scans a key must read the same to change state (1-255)
+ */
+void key_matrix_init(key_matrix_t *km, uint8_t debounce_scans);
+
+/**
+ * @brief Debounce one complete scan
+ * @param raw Contacts closed in the scan
+ * @param since_us Earliest time a newly closed contact can have closed (the
+ *                 previous scan, or the wake-up interrupt); used as its contact time
+ * @param now_us Time of the scan
+ * @param changes Receives up to KEY_MATRIX_KEYS changes, in key order
+ * @return Number of changes
+ */
+int key_matrix_scan(key_matrix_t *km, uint16_t raw, int64_t since_us, int64_t now_us, key_change_t *changes);
+
+/**
+ * @brief True once every key has read open for long enough to be released
+ */
+bool key_matrix_idle(const key_matrix_t *km);
+
+/**
+ * @brief Rows made ambiguous by ghosting in raw, as a key bitmap
+ */
+uint16_t key_matrix_ghost_rows(uint16_t raw);
+
+#endif // KEY_MATRIX_H
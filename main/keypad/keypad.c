@@ -1,11 +1,15 @@
 #include "keypad.h"
+#include "key_matrix.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
 #include "esp_task_wdt.h"
-#include "rom/ets_sys.h"
+#include "esp_timer.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "../config.h"
 #include "../queue_manager/queue_manager.h"
 
 static const char *TAG = "KEYPAD";
@@ -27,6 +31,11 @@ static const char *TAG = "KEYPAD";
 static const gpio_num_t row_pins[4] = {ROW1_PIN, ROW2_PIN, ROW3_PIN, ROW4_PIN};
 static const gpio_num_t col_pins[4] = {COL1_PIN, COL2_PIN, COL3_PIN, COL4_PIN};
 
+// Columns are read together from GPIO_IN_REG, which covers GPIO 0-31
+#define COL_MASK ((1UL << COL1_PIN) | (1UL << COL2_PIN) | (1UL << COL3_PIN) | (1UL << COL4_PIN))
+_Static_assert(COL1_PIN < 32 && COL2_PIN < 32 && COL3_PIN < 32 && COL4_PIN < 32,
+               "keypad columns must be in GPIO_IN_REG");
+
 // Keypad layout mapping (standard 4x4 layout)
 static const char key_map[4][4] = {
     {'1', '2', '3', 'A'},
@@ -35,106 +44,217 @@ static const char key_map[4][4] = {
     {'*', '0', '#', 'D'}
 };
 
-// Queue to send key events from ISR to task context
+// Scanner timing: one row per tick, so a full matrix scan takes 4 ticks.
+// A row is driven for a whole tick before its columns are read, which
+// replaces the settling busy-wait.
+#ifndef KEYPAD_SCAN_TICK_US
+#define KEYPAD_SCAN_TICK_US 1000
+#endif
+
+// A key must read the same for this long to change state
+#ifndef KEYPAD_DEBOUNCE_MS
+#define KEYPAD_DEBOUNCE_MS 20
+#endif
+
+#define SCAN_FRAME_US   (4 * KEYPAD_SCAN_TICK_US)
+#define DEBOUNCE_SCANS  ((KEYPAD_DEBOUNCE_MS * 1000 + SCAN_FRAME_US - 1) / SCAN_FRAME_US)
+_Static_assert(DEBOUNCE_SCANS >= 1 && DEBOUNCE_SCANS <= 255, "KEYPAD_DEBOUNCE_MS out of range");
+
+// keypad_task waits this long for an event before feeding the watchdog
+#define KEYPAD_WDT_FEED_MS 2000
+
+// Events from the scanner (and wake-ups from the ISR, key '\0') to keypad_task
 static QueueHandle_t keypad_queue = NULL;
 #define KEYPAD_QUEUE_SIZE 10
 
-// Debounce timer for ISR
-static volatile TickType_t last_interrupt_time = 0;
+static esp_timer_handle_t scan_timer = NULL;
+
+// Scanner state, owned by the scan timer callback while it runs.
+// Key bitmaps use bit row * 4 + col (see key_event_t).
+static int scan_row;                    // Row driven during the current tick
+static uint16_t raw_keys;               // Contacts closed in the current scan
+static key_matrix_t matrix;
+static int64_t last_scan_us;            // Previous scan, or the wake-up interrupt
+static volatile int64_t wake_us;        // Column interrupt time
+
+// ============================================================================
+// Column interrupts (idle)
+// ============================================================================
+
+static void column_interrupts_enable(bool enable)
+{
+    for (int i = 0; i < 4; i++) {
+        if (enable) {
+            gpio_intr_enable(col_pins[i]);
+        } else {
+            gpio_intr_disable(col_pins[i]);
+        }
+    }
+}
+
+// Closed contacts of the driven row as 4 bits (bit col), one register read
+static uint16_t read_columns(void)
+{
+    uint32_t low = ~REG_READ(GPIO_IN_REG) & COL_MASK;
+    return ((low >> COL1_PIN) & 1) | (((low >> COL2_PIN) & 1) << 1) |
+           (((low >> COL3_PIN) & 1) << 2) | (((low >> COL4_PIN) & 1) << 3);
+}
+
+static bool any_column_low(void)
+{
+    return read_columns() != 0;
+}
 
-#define DEBOUNCE_DELAY_MS 50
+// Drive one row low and release the others, or all rows low for row < 0
+static void drive_row(int row)
+{
+    for (int i = 0; i < 4; i++) {
+        gpio_set_level(row_pins[i], row >= 0 && i != row);
+    }
+}
 
-// ISR handler - called when any column pin goes LOW
+// ISR handler - called when any column pin goes LOW while idle.
+// Column interrupts stay off until the scanner goes idle again; the scan
+// itself runs on scan_timer, started by keypad_task.
 // IRAM_ATTR places in internal RAM -> faster than flash memory
 static void IRAM_ATTR keypad_isr_handler(void *arg)
 {
-    TickType_t current_time = xTaskGetTickCountFromISR();
-    
-    // Debounce check
-    if ((current_time - last_interrupt_time) < (DEBOUNCE_DELAY_MS / portTICK_PERIOD_MS)) {
-        return;
-    }
-    last_interrupt_time = current_time;
-    
-    // Set flag to trigger scan in task context (we are in ISR here)
+    wake_us = esp_timer_get_time();
+    column_interrupts_enable(false);
+
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    uint8_t dummy = 1;
-    xQueueSendFromISR(keypad_queue, &dummy, &xHigherPriorityTaskWoken);
-    
+    key_event_t wake = { .type = KEY_EVT_PRESS, .key = '\0' };
+    xQueueSendFromISR(keypad_queue, &wake, &xHigherPriorityTaskWoken);
+
     if (xHigherPriorityTaskWoken) {
         portYIELD_FROM_ISR();
     }
 }
 
-// Scan the keypad matrix to detect which key is pressed
-static char keypad_scan(void)
+// ============================================================================
+// Scanner
+// ============================================================================
+
+// Called from keypad_task only, so a stopped timer stays stopped meanwhile
+static void scan_start(void)
 {
-    char detected_key = '\0';
-    
-    // Scan each row
-    for (int row = 0; row < 4; row++) {
-        // Set all rows HIGH
-        for (int i = 0; i < 4; i++) {
-            gpio_set_level(row_pins[i], 1);
-        }
-        
-        // Drive current row LOW
-        gpio_set_level(row_pins[row], 0);
-        
-        // Short delay for stable signal (100 us)
-        ets_delay_us(100);
-        
-        // Read all columns (if LOW then key pressed)
-        for (int col = 0; col < 4; col++) {
-            if (gpio_get_level(col_pins[col]) == 0) {
-                detected_key = key_map[row][col];
-                break;
+    if (esp_timer_is_active(scan_timer)) {
+        return;     // Already scanning (duplicate wake-up)
+    }
+    scan_row = 0;
+    raw_keys = 0;
+    last_scan_us = wake_us;
+    drive_row(0);
+    esp_err_t ret = esp_timer_start_periodic(scan_timer, KEYPAD_SCAN_TICK_US);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to start scan timer: %s", esp_err_to_name(ret));
+        drive_row(-1);
+        column_interrupts_enable(true);
+    }
+}
+
+static void emit(const key_event_t *evt)
+{
+    if (xQueueSend(keypad_queue, evt, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Keypad queue full, key '%c' %s lost", evt->key,
+                 evt->type == KEY_EVT_PRESS ? "press" : "release");
+    }
+}
+
+// Debounce a complete scan (key_matrix) and queue its changes
+static void debounce_scan(uint16_t raw, int64_t now_us)
+{
+    key_change_t changes[KEY_MATRIX_KEYS];
+    int count = key_matrix_scan(&matrix, raw, last_scan_us, now_us, changes);
+    last_scan_us = now_us;
+
+    for (int i = 0; i < count; i++) {
+        const key_change_t *c = &changes[i];
+        key_event_t evt = {
+            .type = c->pressed ? KEY_EVT_PRESS : KEY_EVT_RELEASE,
+            .key = key_map[c->index / 4][c->index % 4],
+            .keys = matrix.pressed,
+            .hold_ms = c->hold_ms,
+            .time_us = now_us,
+            .contact_us = c->pressed ? c->contact_us : now_us,
+        };
+        emit(&evt);
+    }
+}
+
+// Every tick: read the row driven since the last tick into the scan bitmap,
+// then drive the next row. Each complete scan is debounced; after one with
+// every integrator at zero, go back to waiting for a column interrupt.
+static void scan_timer_callback(void *arg)
+{
+    raw_keys |= read_columns() << (scan_row * 4);
+    scan_row = (scan_row + 1) % 4;
+
+    if (scan_row == 0) {
+        debounce_scan(raw_keys, esp_timer_get_time());
+        raw_keys = 0;
+        if (key_matrix_idle(&matrix)) {
+            esp_timer_stop(scan_timer);
+            drive_row(-1);
+            column_interrupts_enable(true);
+            // A press between the last scan and re-enabling has no edge left
+            if (any_column_low()) {
+                column_interrupts_enable(false);
+                key_event_t wake = { .type = KEY_EVT_PRESS, .key = '\0' };
+                wake_us = esp_timer_get_time();
+                emit(&wake);                    // Wake-up, as from the ISR
             }
+            return;
         }
-        
-        if (detected_key != '\0') {
-            break;
-        }
-    }
-    
-    // Return all rows to LOW for next interrupt detection
-    for (int i = 0; i < 4; i++) {
-        gpio_set_level(row_pins[i], 0);
     }
-    
-    return detected_key;
+    drive_row(scan_row);
 }
 
+// ============================================================================
+// Public API
+// ============================================================================
+
 void keypad_init(void)
 {
     ESP_LOGI(TAG, "Initializing 4x4 keypad with interrupts");
-    
+
     // Create queue for key events
-    keypad_queue = xQueueCreate(KEYPAD_QUEUE_SIZE, sizeof(uint8_t));
+    keypad_queue = xQueueCreate(KEYPAD_QUEUE_SIZE, sizeof(key_event_t));
     if (keypad_queue == NULL) {
         ESP_LOGE(TAG, "Failed to create keypad queue");
         return;
     }
-    
-    // Row pins configed as outputs (low by default)
+
+    key_matrix_init(&matrix, DEBOUNCE_SCANS);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = scan_timer_callback,
+        .name = "keypad_scan"
+    };
+    if (esp_timer_create(&timer_args, &scan_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create scan timer");
+        return;
+    }
+
+    // Row pins configed as open-drain outputs (low by default). Rows not
+    // being scanned float instead of driving high, so two held keys in one
+    // column do not short a high row to a low one.
     gpio_config_t row_conf = {
-        .pin_bit_mask = ((1ULL << ROW1_PIN) | (1ULL << ROW2_PIN) | 
+        .pin_bit_mask = ((1ULL << ROW1_PIN) | (1ULL << ROW2_PIN) |
                          (1ULL << ROW3_PIN) | (1ULL << ROW4_PIN)),
-        .mode = GPIO_MODE_OUTPUT,
+        .mode = GPIO_MODE_OUTPUT_OD,
         .pull_up_en = GPIO_PULLUP_DISABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
         .intr_type = GPIO_INTR_DISABLE,
     };
     gpio_config(&row_conf);
-    
+
     // Set all rows LOW initially (key press will pull column LOW)
-    for (int i = 0; i < 4; i++) {
-        gpio_set_level(row_pins[i], 0);
-    }
-    
+    drive_row(-1);
+
     // Configure column pins as inputs with pull-ups and FALLING edge interrupts
     gpio_config_t col_conf = {
-        .pin_bit_mask = ((1ULL << COL1_PIN) | (1ULL << COL2_PIN) | 
+        .pin_bit_mask = ((1ULL << COL1_PIN) | (1ULL << COL2_PIN) |
                          (1ULL << COL3_PIN) | (1ULL << COL4_PIN)),
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,
@@ -142,63 +262,24 @@ void keypad_init(void)
         .intr_type = GPIO_INTR_NEGEDGE, // Interrupt on falling edge
     };
     gpio_config(&col_conf);
-    
+
     // Install GPIO ISR service
-    esp_err_t isr_ret = gpio_install_isr_service(0);  
-    if (isr_ret != ESP_OK && isr_ret != ESP_ERR_INVALID_STATE) {  
-        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(isr_ret));  
-        return;  
-    }  
-    
+    esp_err_t isr_ret = gpio_install_isr_service(0);
+    if (isr_ret != ESP_OK && isr_ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(isr_ret));
+        return;
+    }
+
     // Add ISR handlers for each column pin
     for (int i = 0; i < 4; i++) {
         gpio_isr_handler_add(col_pins[i], keypad_isr_handler, (void*)(col_pins[i]));
     }
-    
+
     ESP_LOGI(TAG, "Keypad initialized with interrupts");
     ESP_LOGI(TAG, "Row pins: %d, %d, %d, %d", ROW1_PIN, ROW2_PIN, ROW3_PIN, ROW4_PIN);
     ESP_LOGI(TAG, "Col pins: %d, %d, %d, %d", COL1_PIN, COL2_PIN, COL3_PIN, COL4_PIN);
-}
-
-char keypad_get_key(void)
-{
-    uint8_t dummy;
-    static bool key_is_pressed = false;
-    static TickType_t last_press_time = 0;
-    
-    // Check for interrupt signal (non-blocking)
-    if (xQueueReceive(keypad_queue, &dummy, 0) == pdTRUE) {
-        // Interrupt occurred, scan matrix
-        char key = keypad_scan();
-        
-        // Additional debounce: wait a bit and scan again
-        vTaskDelay(20 / portTICK_PERIOD_MS);
-        char key2 = keypad_scan();
-        
-        if (key == key2 && key != '\0') {
-            // Key is pressed
-            if (!key_is_pressed) {
-                // First press of this key
-                key_is_pressed = true;
-                last_press_time = xTaskGetTickCount();
-                return key;  // Return the key
-            }
-            // Else: key still held down, ignore (prevents repeat)
-        } else {
-            // No key detected or mismatch = key released
-            key_is_pressed = false;
-        }
-    } else {
-        // Auto-reset if no activity for 500ms (safety fallback for stuck keys)
-        if (key_is_pressed) {
-            TickType_t now = xTaskGetTickCount();
-            if ((now - last_press_time) > pdMS_TO_TICKS(500)) {
-                key_is_pressed = false;
-            }
-        }
-    }
-    
-    return '\0';
+    ESP_LOGI(TAG, "Scan: %d us per row, debounce %d scans (%d ms)",
+             KEYPAD_SCAN_TICK_US, DEBOUNCE_SCANS, DEBOUNCE_SCANS * SCAN_FRAME_US / 1000);
 }
 
 void keypad_task(void *pvParameters)
@@ -214,12 +295,22 @@ void keypad_task(void *pvParameters)
         // Feed the watchdog
         esp_task_wdt_reset();
 
-        char key = keypad_get_key();
-        if (key != '\0') {
-            key_event_t evt = { .key = key };
-            send_key_event(&evt);
-            ESP_LOGI(TAG, "Key '%c' sent to queue", key);
+        // Sleeps until the column ISR or the scanner has something
+        key_event_t evt;
+        if (xQueueReceive(keypad_queue, &evt, pdMS_TO_TICKS(KEYPAD_WDT_FEED_MS)) != pdTRUE) {
+            continue;
+        }
+
+        if (evt.key == '\0') {
+            scan_start();
+            continue;
+        }
+
+        send_key_event(&evt);
+        if (evt.type == KEY_EVT_PRESS) {
+            ESP_LOGI(TAG, "Key '%c' press sent to queue (keys 0x%04X)", evt.key, evt.keys);
+        } else {
+            ESP_LOGI(TAG, "Key '%c' release sent to queue (held %lu ms)", evt.key, (unsigned long)evt.hold_ms);
         }
-        vTaskDelay(pdMS_TO_TICKS(20));
     }
-}
\ No newline at end of file
+}
@@ -3,19 +3,21 @@
 
 #include <stdint.h>
 
-/**
- * @brief Initialize the 4x4 keypad matrix with interrupt support
+/*
+ * While no key is down, all rows are driven low and a column interrupt wakes
+ * the scanner. The scanner runs on an esp_timer, one row per tick
+ * (KEYPAD_SCAN_TICK_US), and debounces each key with an integrator over
+ * KEYPAD_DEBOUNCE_MS. After every key is released it returns to waiting for
+ * the interrupt, so an idle keypad costs no CPU.
  */
-void keypad_init(void);
 
 /**
- * @brief Non-blocking check for keypad press
- * @return char The pressed key (0-9, A-D, *, #) or '\0' if none
+ * @brief Initialize the 4x4 keypad matrix, column interrupts and scan timer
  */
-char keypad_get_key(void);
+void keypad_init(void);
 
 /**
- * @brief FreeRTOS task that scans keypad and sends keys to key_queue
+ * @brief FreeRTOS task that forwards key press and release events to key_queue
  * Priority 6 (highest) - user expects immediate response
  */
 void keypad_task(void *pvParameters);
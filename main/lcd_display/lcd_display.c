@@ -1,5 +1,6 @@
 #include "lcd_display.h"
-#include "driver/i2c.h"
+#include "../i2c_bus/i2c_bus.h"
+#include "../input_latency/input_latency.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "esp_task_wdt.h"
@@ -15,21 +16,20 @@ static esp_timer_handle_t message_timer = NULL;
 static safe_state_t restore_state = STATE_LOCKED;
 static volatile bool message_active = false;
 
-// I2C port (shared with MPU6050)
-#define I2C_PORT I2C_NUM_0
-
-// Mutex for I2C bus protection (shared with MPU6050)
-// IMPORTANT: All I2C transactions to LCD and MPU6050 must acquire this mutex
-// to prevent bus contention and transaction interleaving
-static SemaphoreHandle_t i2c_mutex = NULL;
-
 // RGB backlight registers for DFRobot DFR0464 (address 0x60)
 #define RGB_MODE1               0x00
 #define RGB_MODE2               0x01
 #define RGB_PWM_BLUE            0x02  // Note: DFRobot uses 0x02 for BLUE
 #define RGB_PWM_GREEN           0x03
 #define RGB_PWM_RED             0x04  // Note: DFRobot uses 0x04 for RED
+#define RGB_GRPPWM              0x06  // Group blink: lit share of the period
+#define RGB_GRPFREQ             0x07  // Group blink: period (n + 1) / 24 s
 #define RGB_LEDOUT              0x08
+#define RGB_AUTO_INCREMENT      0x80  // Register address flag: step through registers
+
+// LEDOUT: each output on its PWM register, or that and the group blink
+#define RGB_LEDOUT_PWM          0xAA
+#define RGB_LEDOUT_PWM_GROUP    0xFF
 
 // LCD commands
 #define LCD_CMD_CLEAR           0x01
@@ -58,72 +58,150 @@ static SemaphoreHandle_t i2c_mutex = NULL;
 #define LCD_RW                  0x02  // Read/Write bit
 #define LCD_RS                  0x01  // Register select bit
 
+// Control byte preceding each command/data run (Co = more control bytes follow)
+#define LCD_CTRL_CO             0x80
+#define LCD_CTRL_RS             0x40
+
+#define LCD_ROWS                2
+#define LCD_COLS                16
+
+// Unchanged cells between two changed runs are resent rather than starting a
+// new transaction when the gap is at most this long (a transaction costs
+// about 4 bytes of address, control bytes and start/stop)
+#define LCD_RUN_MERGE_GAP       4
+
+// Shadow framebuffer: fb holds what should be shown, glass what the
+// controller is known to show; lcd_render() sends only the difference.
+// Guarded by fb_mutex (lcd_task and the message timer both draw).
+static char fb[LCD_ROWS][LCD_COLS];
+static char glass[LCD_ROWS][LCD_COLS];
+static led_pattern_t fb_backlight;
+static led_pattern_t glass_backlight;
+static bool glass_backlight_valid = false;  // Backlight state unknown until first write
+static SemaphoreHandle_t fb_mutex = NULL;
+
 // Send command to LCD controller (0x3E) using register protocol
 static esp_err_t lcd_send_command(uint8_t cmd)
 {
-    if (i2c_mutex == NULL || xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire I2C mutex for command");
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    i2c_cmd_handle_t i2c_cmd = i2c_cmd_link_create();
-    i2c_master_start(i2c_cmd);
-    i2c_master_write_byte(i2c_cmd, (LCD_CONTROLLER_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(i2c_cmd, 0x00, true);  // Control byte: Co=0, RS=0 (command)
-    i2c_master_write_byte(i2c_cmd, cmd, true);
-    i2c_master_stop(i2c_cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_PORT, i2c_cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(i2c_cmd);
-    
-    xSemaphoreGive(i2c_mutex);
-    return ret;
+    uint8_t buf[2] = { 0x00, cmd };  // Control byte: Co=0, RS=0 (command)
+    return i2c_bus_write(I2C_DEV_LCD, buf, sizeof(buf));
 }
 
-// Send data to LCD controller (0x3E) using register protocol
-static esp_err_t lcd_send_data_byte(uint8_t data)
+// Write a run of cells in a single transaction: set DDRAM address (Co=1 so
+// a second control byte follows), then switch to data (Co=0, RS=1) and
+// stream the characters. The controller needs ~40 us per byte and does not
+// stretch the clock, so i2c_bus keeps it at 200 kHz or less (45 us per byte
+// on the wire) and no delays are needed.
+static esp_err_t lcd_send_cells(uint8_t ddram_addr, const char *cells, size_t len)
 {
-    if (i2c_mutex == NULL || xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire I2C mutex for data");
-        return ESP_ERR_TIMEOUT;
+    uint8_t buf[3 + LCD_COLS];
+    if (len > LCD_COLS) {
+        return ESP_ERR_INVALID_SIZE;
     }
-    
-    i2c_cmd_handle_t i2c_cmd = i2c_cmd_link_create();
-    i2c_master_start(i2c_cmd);
-    i2c_master_write_byte(i2c_cmd, (LCD_CONTROLLER_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(i2c_cmd, 0x40, true);  // Control byte: Co=0, RS=1 (data)
-    i2c_master_write_byte(i2c_cmd, data, true);
-    i2c_master_stop(i2c_cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_PORT, i2c_cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(i2c_cmd);
-    
-    xSemaphoreGive(i2c_mutex);
-    return ret;
+    buf[0] = LCD_CTRL_CO;                         // Command, more control bytes follow
+    buf[1] = LCD_CMD_SET_DDRAM_ADDR | ddram_addr;
+    buf[2] = LCD_CTRL_RS;                         // Data until stop
+    memcpy(&buf[3], cells, len);
+    return i2c_bus_write(I2C_DEV_LCD, buf, 3 + len);
 }
 
 // Write to RGB backlight controller (0x60)
 static esp_err_t rgb_write_register(uint8_t reg, uint8_t value)
 {
-    if (i2c_mutex == NULL || xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire I2C mutex for RGB");
-        return ESP_ERR_TIMEOUT;
+    return i2c_bus_write_reg(I2C_DEV_RGB, reg, value);
+}
+
+// Show a pattern on the backlight: colour, group blink and output mode in
+// one auto-increment transaction (PWM0 at 0x02 through LEDOUT at 0x08). The
+// controller blinks by itself from then on.
+static esp_err_t rgb_write_pattern(const led_pattern_t *p)
+{
+    uint8_t grppwm = 0xFF;
+    uint8_t grpfreq = 0;
+    bool blink = led_pattern_group_blink(p, &grppwm, &grpfreq);
+    uint8_t buf[] = {
+        RGB_AUTO_INCREMENT | RGB_PWM_BLUE,
+        p->b, p->g, p->r,
+        0x00,                                   // PWM3, not connected
+        grppwm, grpfreq,
+        blink ? RGB_LEDOUT_PWM_GROUP : RGB_LEDOUT_PWM,
+    };
+    return i2c_bus_write(I2C_DEV_RGB, buf, sizeof(buf));
+}
+
+// End of the last lcd_render(), when the change reached the glass (fb_mutex)
+static int64_t rendered_us;
+
+// Send the cells and backlight pattern that differ between fb and glass.
+// Caller holds fb_mutex.
+static void lcd_render(void)
+{
+    for (int row = 0; row < LCD_ROWS; row++) {
+        int col = 0;
+        while (col < LCD_COLS) {
+            if (fb[row][col] == glass[row][col]) {
+                col++;
+                continue;
+            }
+            // Extend the run over short unchanged gaps
+            int start = col;
+            int end = col + 1;
+            for (int i = end; i < LCD_COLS && i - end <= LCD_RUN_MERGE_GAP; i++) {
+                if (fb[row][i] != glass[row][i]) {
+                    end = i + 1;
+                }
+            }
+
+            // Row 0 starts at DDRAM 0x00, row 1 at 0x40
+            uint8_t addr = (row == 0 ? 0x00 : 0x40) + start;
+            esp_err_t ret = lcd_send_cells(addr, &fb[row][start], end - start);
+            if (ret == ESP_OK) {
+                memcpy(&glass[row][start], &fb[row][start], end - start);
+            } else {
+                ESP_LOGW(TAG, "Failed to write row %d cols %d-%d: %s", row, start, end - 1, esp_err_to_name(ret));
+            }
+            col = end;
+        }
     }
-    
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (LCD_BACKLIGHT_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg, true);
-    i2c_master_write_byte(cmd, value, true);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_PORT, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-    
-    xSemaphoreGive(i2c_mutex);
-    return ret;
+
+    if (!glass_backlight_valid || !led_pattern_equal(&fb_backlight, &glass_backlight)) {
+        esp_err_t ret = rgb_write_pattern(&fb_backlight);
+        if (ret == ESP_OK) {
+            glass_backlight = fb_backlight;
+            glass_backlight_valid = true;
+        } else {
+            ESP_LOGW(TAG, "Failed to set backlight: %s", esp_err_to_name(ret));
+            glass_backlight_valid = false;
+        }
+    }
+    rendered_us = esp_timer_get_time();
+}
+
+// Framebuffer drawing (caller holds fb_mutex); nothing is sent until lcd_render()
+static void fb_put_row(uint8_t row, const char *text)
+{
+    // Pad so stale characters are overwritten; text beyond 16 chars is cut
+    size_t len = strnlen(text, LCD_COLS);
+    memcpy(fb[row], text, len);
+    memset(&fb[row][len], ' ', LCD_COLS - len);
 }
 
-SemaphoreHandle_t lcd_display_get_i2c_mutex(void)
+static void fb_put_backlight(const led_pattern_t *p)
 {
-    return i2c_mutex;
+    fb_backlight = *p;
+}
+
+// Clock bring-up checks. Both chips are written blind, so an ACK on a
+// harmless write is what can be checked: function set (repeated below) for
+// the controller, normal mode for the backlight.
+static bool lcd_check(i2c_dev_t dev)
+{
+    return lcd_send_command(LCD_CMD_FUNCTION_SET | 0x10 | LCD_FUNCTION_2LINE | LCD_FUNCTION_5x8) == ESP_OK;
+}
+
+static bool rgb_check(i2c_dev_t dev)
+{
+    return rgb_write_register(RGB_MODE1, 0x00) == ESP_OK;
 }
 
 bool lcd_display_init(void)
@@ -131,25 +209,29 @@ bool lcd_display_init(void)
     ESP_LOGI(TAG, "Initializing LCD controller at 0x%02X", LCD_CONTROLLER_ADDR);
     ESP_LOGI(TAG, "Initializing RGB backlight at 0x%02X", LCD_BACKLIGHT_ADDR);
     
-    // Create I2C mutex for bus protection (shared with MPU6050)
-    if (i2c_mutex == NULL) {
-        i2c_mutex = xSemaphoreCreateMutex();
-        if (i2c_mutex == NULL) {
-            ESP_LOGE(TAG, "Failed to create I2C mutex");
+    // Wait for LCD to power up (the clock checks below already talk to it)
+    vTaskDelay(pdMS_TO_TICKS(50));
+
+    if (i2c_bus_add_device(I2C_DEV_LCD, LCD_CONTROLLER_ADDR, lcd_check) != ESP_OK ||
+        i2c_bus_add_device(I2C_DEV_RGB, LCD_BACKLIGHT_ADDR, rgb_check) != ESP_OK) {
+        return false;
+    }
+
+    if (fb_mutex == NULL) {
+        fb_mutex = xSemaphoreCreateMutex();
+        if (fb_mutex == NULL) {
+            ESP_LOGE(TAG, "Failed to create framebuffer mutex");
             return false;
         }
     }
     
-    // Wait for LCD to power up
-    vTaskDelay(pdMS_TO_TICKS(50));
-    
     // Initialize RGB backlight controller (DFRobot DFR0464 at 0x60)
     esp_err_t ret = rgb_write_register(RGB_MODE1, 0x00);    // Normal mode
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure RGB MODE1: %s", esp_err_to_name(ret));
         return false;
     }
-    ret = rgb_write_register(RGB_LEDOUT, 0xFF);   // Enable all LED outputs (full PWM)
+    ret = rgb_write_register(RGB_LEDOUT, RGB_LEDOUT_PWM);   // Enable all LED outputs (PWM)
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to configure RGB LEDOUT: %s", esp_err_to_name(ret));
         return false;
@@ -187,6 +269,8 @@ bool lcd_display_init(void)
         return false;
     }
     vTaskDelay(pdMS_TO_TICKS(2));
+    memset(fb, ' ', sizeof(fb));
+    memset(glass, ' ', sizeof(glass));
     
     // Entry mode: left to right, no shift
     ret = lcd_send_command(LCD_CMD_ENTRY_MODE | LCD_ENTRY_LEFT | LCD_ENTRY_SHIFT_DEC);
@@ -202,12 +286,16 @@ bool lcd_display_init(void)
 
 void lcd_display_clear(void)
 {
+    xSemaphoreTake(fb_mutex, portMAX_DELAY);
     esp_err_t ret = lcd_send_command(LCD_CMD_CLEAR);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to clear display: %s", esp_err_to_name(ret));
-        return;
+    } else {
+        memset(fb, ' ', sizeof(fb));
+        memset(glass, ' ', sizeof(glass));
+        vTaskDelay(pdMS_TO_TICKS(2));
     }
-    vTaskDelay(pdMS_TO_TICKS(2));
+    xSemaphoreGive(fb_mutex);
 }
 
 void lcd_display_write(const char *text, uint8_t row)
@@ -217,54 +305,22 @@ void lcd_display_write(const char *text, uint8_t row)
         return;
     }
     
-    // Set cursor position (row 0 = 0x00, row 1 = 0x40)
-    uint8_t row_addr = (row == 0) ? 0x00 : 0x40;
-    esp_err_t ret = lcd_send_command(LCD_CMD_SET_DDRAM_ADDR | row_addr);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set cursor position for row %d: %s", row, esp_err_to_name(ret));
-        return;
-    }
-    
-    // Longer delay after cursor positioning to ensure it's processed
-    vTaskDelay(pdMS_TO_TICKS(10));
-    
-    // Write up to 16 characters with small delays between each
-    for (int i = 0; i < 16; i++) {
-        if (text[i] == '\0') {
-            // Pad remaining space with spaces
-            for (int j = i; j < 16; j++) {
-                ret = lcd_send_data_byte(' ');
-                if (ret != ESP_OK) {
-                    ESP_LOGW(TAG, "Failed to write padding at position %d: %s", j, esp_err_to_name(ret));
-                }
-                vTaskDelay(pdMS_TO_TICKS(1));  // Small delay between characters
-            }
-            break;
-        }
-        ret = lcd_send_data_byte(text[i]);
-        if (ret != ESP_OK) {
-            ESP_LOGW(TAG, "Failed to write character '%c' at position %d: %s", text[i], i, esp_err_to_name(ret));
-        }
-        vTaskDelay(pdMS_TO_TICKS(1));  // Small delay between characters
-    }
+    xSemaphoreTake(fb_mutex, portMAX_DELAY);
+    fb_put_row(row, text);
+    lcd_render();
+    xSemaphoreGive(fb_mutex);
 }
 
-void lcd_display_set_backlight_rgb(uint8_t r, uint8_t g, uint8_t b)
+void lcd_display_set_backlight(const led_pattern_t *p)
 {
-    ESP_LOGI(TAG, "Setting RGB backlight: R=%d G=%d B=%d", r, g, b);
-    
-    esp_err_t ret = rgb_write_register(RGB_PWM_RED, r);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to set red PWM: %s", esp_err_to_name(ret));
-    }
-    ret = rgb_write_register(RGB_PWM_GREEN, g);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to set green PWM: %s", esp_err_to_name(ret));
-    }
-    ret = rgb_write_register(RGB_PWM_BLUE, b);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to set blue PWM: %s", esp_err_to_name(ret));
+    xSemaphoreTake(fb_mutex, portMAX_DELAY);
+    if (!glass_backlight_valid || !led_pattern_equal(p, &glass_backlight)) {
+        ESP_LOGI(TAG, "Setting backlight: R=%d G=%d B=%d period %u ms duty %d/255",
+                 p->r, p->g, p->b, p->period_ms, p->duty);
     }
+    fb_put_backlight(p);
+    lcd_render();
+    xSemaphoreGive(fb_mutex);
 }
 
 void lcd_display_show_state(safe_state_t state)
@@ -284,36 +340,36 @@ void lcd_display_show_state(safe_state_t state)
         }
     }
 
-    lcd_display_clear();
-
+    // Compose the whole screen, then send only what differs from the glass
+    xSemaphoreTake(fb_mutex, portMAX_DELAY);
+    fb_put_backlight(led_pattern_for_state(state));
     switch (state) {
         case STATE_LOCKED:
-            lcd_display_write("Status: LOCKED", 0);
-            lcd_display_write("Ready", 1);
-            lcd_display_set_backlight_rgb(255, 0, 0);  // Red
+            fb_put_row(0, "Status: LOCKED");
+            fb_put_row(1, "Ready");
             ESP_LOGI(TAG, "Displaying LOCKED state");
             break;
             
         case STATE_UNLOCKED:
-            lcd_display_write("Status: UNLOCKED", 0);
-            lcd_display_write("Access Granted", 1);
-            lcd_display_set_backlight_rgb(0, 255, 0);  // Green
+            fb_put_row(0, "Status: UNLOCKED");
+            fb_put_row(1, "Access Granted");
             ESP_LOGI(TAG, "Displaying UNLOCKED state");
             break;
             
         case STATE_ALARM:
-            lcd_display_write("!! ALARM !!", 0);
-            lcd_display_write("Tamper Detected", 1);
-            lcd_display_set_backlight_rgb(255, 0, 0);  // Red
+            fb_put_row(0, "!! ALARM !!");
+            fb_put_row(1, "Tamper Detected");
             ESP_LOGI(TAG, "Displaying ALARM state");
             break;
             
         default:
-            lcd_display_write("Status: UNKNOWN", 0);
-            lcd_display_set_backlight_rgb(255, 255, 0);  // Yellow
+            fb_put_row(0, "Status: UNKNOWN");
+            fb_put_row(1, "");
             ESP_LOGE(TAG, "Unknown state: %d", state);
             break;
     }
+    lcd_render();
+    xSemaphoreGive(fb_mutex);
 }
 
 void lcd_display_show_pin_entry(int length)
@@ -460,6 +516,7 @@ void lcd_task(void *pvParameters)
 
         lcd_cmd_t cmd;
         if (receive_lcd_cmd(&cmd, 100)) {
+            int64_t received_us = esp_timer_get_time();
             switch (cmd.type) {
                 case LCD_CMD_SHOW_STATE:
                     lcd_display_show_state(cmd.state);
@@ -480,6 +537,13 @@ void lcd_task(void *pvParameters)
                     ESP_LOGW(TAG, "Unknown LCD command type: %d", cmd.type);
                     break;
             }
+            // Feedback to a key press: stamp the end of its render
+            if (cmd.trace.contact_us != 0) {
+                xSemaphoreTake(fb_mutex, portMAX_DELAY);
+                int64_t glass_us = rendered_us >= received_us ? rendered_us : esp_timer_get_time();
+                xSemaphoreGive(fb_mutex);
+                input_latency_record(&cmd.trace, received_us, glass_us);
+            }
         }
     }
 }
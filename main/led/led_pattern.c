@@ -0,0 +1,65 @@
+#include "led_pattern.h"
+#include "../config.h"
+
+#ifndef LED_BREATH_MS
+#define LED_BREATH_MS 1500
+#endif
+
+// The state signalling, in one place
+static const led_pattern_t state_patterns[] = {
+    [STATE_LOCKED]   = { .r = 255, .g = 0,   .b = 0, .period_ms = 0,                 .duty = 255, .ramp_ms = 0 },
+    [STATE_UNLOCKED] = { .r = 0,   .g = 255, .b = 0, .period_ms = 2 * LED_BREATH_MS, .duty = 128, .ramp_ms = LED_BREATH_MS },
+    [STATE_ALARM]    = { .r = 255, .g = 0,   .b = 0, .period_ms = 1000,              .duty = 128, .ramp_ms = 0 },
+};
+
+// Unknown states: steady yellow
+static const led_pattern_t unknown_pattern = { .r = 255, .g = 255, .b = 0, .period_ms = 0, .duty = 255, .ramp_ms = 0 };
+
+const led_pattern_t *led_pattern_for_state(safe_state_t state)
+{
+    if ((unsigned)state >= sizeof(state_patterns) / sizeof(state_patterns[0])) {
+        return &unknown_pattern;
+    }
+    return &state_patterns[state];
+}
+
+int led_pattern_keyframes(const led_pattern_t *p, led_keyframe_t *kf)
+{
+    if (p->period_ms == 0 || p->duty == 255) {
+        return 0;
+    }
+    uint32_t on_ms = (uint32_t)p->period_ms * p->duty / 255;
+    uint32_t off_ms = p->period_ms - on_ms;
+
+    // A ramp cannot outlast the phase it starts
+    uint32_t ramp_ms = p->ramp_ms;
+    if (ramp_ms > on_ms) {
+        ramp_ms = on_ms;
+    }
+    if (ramp_ms > off_ms) {
+        ramp_ms = off_ms;
+    }
+
+    kf[0] = (led_keyframe_t){ .level = 255, .fade_ms = (uint16_t)ramp_ms, .hold_ms = (uint16_t)on_ms };
+    kf[1] = (led_keyframe_t){ .level = 0,   .fade_ms = (uint16_t)ramp_ms, .hold_ms = (uint16_t)off_ms };
+    return LED_PATTERN_KEYFRAMES;
+}
+
+bool led_pattern_group_blink(const led_pattern_t *p, uint8_t *grppwm, uint8_t *grpfreq)
+{
+    if (p->period_ms == 0 || p->duty == 255 || p->ramp_ms != 0) {
+        return false;
+    }
+    // Blink period is (GRPFREQ + 1) / 24 s: 41 ms to 10.7 s
+    uint32_t freq = ((uint32_t)p->period_ms * 24 + 500) / 1000;
+    freq = (freq == 0) ? 0 : freq - 1;
+    *grpfreq = (freq > 255) ? 255 : (uint8_t)freq;
+    *grppwm = p->duty;
+    return true;
+}
+
+bool led_pattern_equal(const led_pattern_t *a, const led_pattern_t *b)
+{
+    return a->r == b->r && a->g == b->g && a->b == b->b &&
+           a->period_ms == b->period_ms && a->duty == b->duty && a->ramp_ms == b->ramp_ms;
+}
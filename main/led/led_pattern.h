@@ -0,0 +1,64 @@
+#ifndef LED_PATTERN_H
+#define LED_PATTERN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../queue_manager/queue_manager.h"
+
+/*
+ * Light patterns shared by the status LEDs and the LCD backlight. A pattern
+ * is a colour switched on for `duty` of every `period_ms`, with edges ramped
+ * over `ramp_ms`; each output plays it in hardware:
+ *
+ *   status LEDs  red shows r, green shows g (LEDC). Hard blinks whose period
+ *                divides a second are a low-frequency PWM output; anything
+ *                else is two keyframes (fade up, fade down) run by the LEDC
+ *                fader, so the CPU only steps in at each keyframe
+ *   backlight    the DFR0464 PWM and group blink registers (GRPPWM duty,
+ *                GRPFREQ period), written in one transaction. It cannot
+ *                fade: ramped patterns show their colour steadily
+ */
+
+typedef struct {
+    uint8_t r, g, b;        // Colour
+    uint16_t period_ms;     // 0 = steady
+    uint8_t duty;           // Share of the period lit, 1-255 (255 = steady)
+    uint16_t ramp_ms;       // Fade time of each edge (0 = hard blink)
+} led_pattern_t;
+
+#define LED_PATTERN_STEADY(r_, g_, b_) \
+    ((led_pattern_t){ .r = (r_), .g = (g_), .b = (b_), .period_ms = 0, .duty = 255, .ramp_ms = 0 })
+
+// One step of a pattern: fade the colour to level (out of 255) over fade_ms,
+// and move on to the next step hold_ms after this one started
+typedef struct {
+    uint8_t level;
+    uint16_t fade_ms;
+    uint16_t hold_ms;
+} led_keyframe_t;
+
+#define LED_PATTERN_KEYFRAMES 2
+
+/**
+ * @brief Pattern shown for a safe state (LEDs and backlight alike)
+ */
+const led_pattern_t *led_pattern_for_state(safe_state_t state);
+
+/**
+ * @brief Split a pattern into keyframes, played in a loop
+ * @param kf Receives up to LED_PATTERN_KEYFRAMES keyframes
+ * @return Number of keyframes; 0 for a steady pattern
+ */
+int led_pattern_keyframes(const led_pattern_t *p, led_keyframe_t *kf);
+
+/**
+ * @brief DFR0464 group blink registers for a pattern
+ * @param grppwm Receives the lit share of the period (n/256)
+ * @param grpfreq Receives the period, (n + 1) / 24 s
+ * @return false if the backlight shows the pattern steadily (no blink)
+ */
+bool led_pattern_group_blink(const led_pattern_t *p, uint8_t *grppwm, uint8_t *grpfreq);
+
+bool led_pattern_equal(const led_pattern_t *a, const led_pattern_t *b);
+
+#endif // LED_PATTERN_H
@@ -1,97 +1,203 @@
 #include <stdint.h>
+#include <stdbool.h>
 #include "esp_timer.h"
-#include "driver/gpio.h"
+#include "driver/ledc.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "leds.h"
+#include "../config.h"
 #include "../queue_manager/queue_manager.h"
 
-// Flash interval for alarm state
-#define ALARM_FLASH_INTERVAL_US (500 * 1000)
+#ifndef LED_BRIGHTNESS
+#define LED_BRIGHTNESS 100
+#endif
+#ifndef LED_ACK_MS
+#define LED_ACK_MS 150
+#endif
 
-static const char *TAG = "LED";
+#define LED_SPEED_MODE  LEDC_LOW_SPEED_MODE
+#define LED_TIMER       LEDC_TIMER_0        // Steady and fading output
+#define BLINK_TIMER     LEDC_TIMER_1        // Hard blinks, retuned per pattern
+#define LED_PWM_HZ      5000
+#define LED_RESOLUTION  LEDC_TIMER_10_BIT
+#define RED_CHANNEL     LEDC_CHANNEL_0
+#define GREEN_CHANNEL   LEDC_CHANNEL_1
+
+#define DUTY_ON         ((((1 << 10) - 1) * LED_BRIGHTNESS) / 100)
 
-static led_mode_t current_mode = LED_MODE_OFF;
-static int alarm_led_on = 0;
-static int64_t last_toggle_time_us = 0;
+static const char *TAG = "LED";
 
-static void set_outputs(int red_on, int green_on)
+static const ledc_channel_t channels[2] = { RED_CHANNEL, GREEN_CHANNEL };
+
+// Pattern being played. Hard blinks run on BLINK_TIMER by themselves; other
+// animated patterns are keyframes, each a hardware fade, and the one-shot
+// keyframe_timer starts the next when one ends. Guarded by led_lock against
+// led_task changing the pattern meanwhile.
+static led_pattern_t pattern;
+static bool pattern_valid = false;
+static bool hw_blink = false;
+static led_keyframe_t keyframes[LED_PATTERN_KEYFRAMES];
+static int keyframe_count;
+static int keyframe_next;
+static esp_timer_handle_t keyframe_timer;
+static SemaphoreHandle_t led_lock;
+
+// Channel duty for a colour component at a keyframe level (both out of 255)
+static uint32_t channel_duty(uint8_t colour, uint8_t level)
 {
-    gpio_set_level(RED_LED_PIN, red_on);
-    gpio_set_level(GREEN_LED_PIN, green_on);
+    return (uint32_t)colour * level * DUTY_ON / (255 * 255);
 }
 
-void leds_init(void)
+static void set_duty(ledc_channel_t channel, uint32_t duty)
 {
-    gpio_config_t red_led_conf = {
-        .pin_bit_mask = (1ULL << RED_LED_PIN),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
-    gpio_config(&red_led_conf);
-    gpio_set_level(RED_LED_PIN, 0);
-
-    gpio_config_t green_led_conf = {
-        .pin_bit_mask = (1ULL << GREEN_LED_PIN),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
-    gpio_config(&green_led_conf);
-    gpio_set_level(GREEN_LED_PIN, 0);
+    ledc_fade_stop(LED_SPEED_MODE, channel);
+    ledc_set_duty_and_update(LED_SPEED_MODE, channel, duty, 0);
+}
 
-    current_mode = LED_MODE_OFF;
-    alarm_led_on = 0;
-    last_toggle_time_us = esp_timer_get_time();
-    ESP_LOGI(TAG, "LEDs initialized: Red=GPIO%d, Green=GPIO%d", RED_LED_PIN, GREEN_LED_PIN);
+static void fade_to(ledc_channel_t channel, uint32_t duty, int ms)
+{
+    if (ms == 0) {
+        set_duty(channel, duty);
+    } else {
+        ledc_set_fade_time_and_start(LED_SPEED_MODE, channel, duty, ms, LEDC_FADE_NO_WAIT);
+    }
 }
 
-led_mode_t leds_get_mode(void)
+static void play_keyframe(int index)
 {
-    return current_mode;
+    const led_keyframe_t *kf = &keyframes[index];
+    const uint8_t colour[2] = { pattern.r, pattern.g };
+    for (int i = 0; i < 2; i++) {
+        if (colour[i] != 0) {
+            fade_to(channels[i], channel_duty(colour[i], kf->level), kf->fade_ms);
+        }
+    }
+    keyframe_next = (index + 1) % keyframe_count;
+    esp_timer_start_once(keyframe_timer, (uint64_t)kf->hold_ms * 1000);
 }
 
-void set_locked_led(void)
+static void keyframe_timer_callback(void *arg)
 {
-    current_mode = LED_MODE_LOCKED;
-    alarm_led_on = 0;
-    set_outputs(1, 0);
-    ESP_LOGI(TAG, "LED State: LOCKED (Red ON)");
+    (void)arg;
+    xSemaphoreTake(led_lock, portMAX_DELAY);
+    // Restarted by leds_play() or an ack while this waited for the lock
+    if (keyframe_count > 0 && !esp_timer_is_active(keyframe_timer)) {
+        play_keyframe(keyframe_next);
+    }
+    xSemaphoreGive(led_lock);
 }
 
-void set_unlocked_led(void)
+// Hard blinks whose period is a whole number of Hz are a PWM output
+static bool use_hw_blink(const led_pattern_t *p)
 {
-    current_mode = LED_MODE_UNLOCKED;
-    alarm_led_on = 0;
-    set_outputs(0, 1);
-    ESP_LOGI(TAG, "LED State: UNLOCKED (Green ON)");
+    return p->ramp_ms == 0 && p->period_ms > 0 && p->duty < 255 && 1000 % p->period_ms == 0;
 }
 
-void set_alarm_led_flashing(void)
+void leds_init(void)
 {
-    current_mode = LED_MODE_ALARM_FLASH;
-    alarm_led_on = 1;
-    last_toggle_time_us = esp_timer_get_time();
-    set_outputs(1, 0);
-    ESP_LOGI(TAG, "LED State: ALARM (Red flashing)");
+    led_lock = xSemaphoreCreateMutex();
+
+    const ledc_timer_config_t timers[] = {
+        { .speed_mode = LED_SPEED_MODE, .timer_num = LED_TIMER, .freq_hz = LED_PWM_HZ,
+          .duty_resolution = LED_RESOLUTION, .clk_cfg = LEDC_AUTO_CLK },
+        { .speed_mode = LED_SPEED_MODE, .timer_num = BLINK_TIMER, .freq_hz = 1,
+          .duty_resolution = LED_RESOLUTION, .clk_cfg = LEDC_AUTO_CLK },
+    };
+    for (int i = 0; i < 2; i++) {
+        esp_err_t ret = ledc_timer_config(&timers[i]);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to configure LEDC timer %d: %s", timers[i].timer_num, esp_err_to_name(ret));
+        }
+    }
+
+    const ledc_channel_config_t channel_conf[] = {
+        { .gpio_num = RED_LED_PIN, .speed_mode = LED_SPEED_MODE, .channel = RED_CHANNEL,
+          .timer_sel = LED_TIMER, .duty = 0, .hpoint = 0 },
+        { .gpio_num = GREEN_LED_PIN, .speed_mode = LED_SPEED_MODE, .channel = GREEN_CHANNEL,
+          .timer_sel = LED_TIMER, .duty = 0, .hpoint = 0 },
+    };
+    for (int i = 0; i < 2; i++) {
+        ledc_channel_config(&channel_conf[i]);
+    }
+    ledc_fade_func_install(0);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = keyframe_timer_callback,
+        .name = "led_keyframe"
+    };
+    if (esp_timer_create(&timer_args, &keyframe_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create keyframe timer");
+    }
+
+    ESP_LOGI(TAG, "LEDs initialized (LEDC): Red=GPIO%d, Green=GPIO%d", RED_LED_PIN, GREEN_LED_PIN);
 }
 
-void leds_update(void)
+void leds_play(const led_pattern_t *p)
 {
-    if (current_mode != LED_MODE_ALARM_FLASH) {
-        return;
+    xSemaphoreTake(led_lock, portMAX_DELAY);
+    if (pattern_valid && led_pattern_equal(p, &pattern)) {
+        xSemaphoreGive(led_lock);
+        return;                 // Already playing; do not restart it
+    }
+
+    esp_timer_stop(keyframe_timer);
+    bool blink = use_hw_blink(p);
+    if (hw_blink != blink) {
+        for (int i = 0; i < 2; i++) {
+            ledc_fade_stop(LED_SPEED_MODE, channels[i]);
+            ledc_bind_channel_timer(LED_SPEED_MODE, channels[i], blink ? BLINK_TIMER : LED_TIMER);
+        }
+        hw_blink = blink;
+    }
+    pattern = *p;
+    pattern_valid = true;
+
+    const uint8_t colour[2] = { p->r, p->g };
+    if (blink) {
+        // The PWM duty is the lit share of the period; brightness is fixed
+        ledc_set_freq(LED_SPEED_MODE, BLINK_TIMER, 1000 / p->period_ms);
+        keyframe_count = 0;
+        for (int i = 0; i < 2; i++) {
+            set_duty(channels[i], colour[i] ? ((uint32_t)p->duty << 2) : 0);
+        }
+    } else {
+        keyframe_count = led_pattern_keyframes(p, keyframes);
+        for (int i = 0; i < 2; i++) {
+            set_duty(channels[i], channel_duty(colour[i], 255));
+        }
+        if (keyframe_count > 0) {
+            // Lit now; the first keyframe's hold runs from here
+            keyframe_next = 1 % keyframe_count;
+            esp_timer_start_once(keyframe_timer, (uint64_t)keyframes[0].hold_ms * 1000);
+        }
     }
+    xSemaphoreGive(led_lock);
 
-    int64_t now = esp_timer_get_time();
-    if ((now - last_toggle_time_us) >= ALARM_FLASH_INTERVAL_US) {
-        alarm_led_on = !alarm_led_on;
-        last_toggle_time_us = now;
-        set_outputs(alarm_led_on, 0);
+    ESP_LOGI(TAG, "Pattern: R=%d G=%d period %u ms duty %d/255 ramp %u ms%s",
+             p->r, p->g, p->period_ms, p->duty, p->ramp_ms, blink ? " (PWM blink)" : "");
+}
+
+void led_ack_blink(void)
+{
+    xSemaphoreTake(led_lock, portMAX_DELAY);
+    if (pattern_valid && !hw_blink) {
+        // Off, then the hardware fades back to full; keyframes carry on from there
+        esp_timer_stop(keyframe_timer);
+        const uint8_t colour[2] = { pattern.r, pattern.g };
+        for (int i = 0; i < 2; i++) {
+            if (colour[i] != 0) {
+                set_duty(channels[i], 0);
+                fade_to(channels[i], channel_duty(colour[i], 255), LED_ACK_MS);
+            }
+        }
+        if (keyframe_count > 0) {
+            keyframe_next = 1 % keyframe_count;
+            esp_timer_start_once(keyframe_timer, LED_ACK_MS * 1000);
+        }
     }
+    xSemaphoreGive(led_lock);
 }
 
 void led_task(void *pvParameters)
@@ -101,28 +207,27 @@ void led_task(void *pvParameters)
 
     // Initialize LEDs
     leds_init();
-    set_locked_led();  // Default to locked state
+    leds_play(led_pattern_for_state(STATE_LOCKED));  // Default to locked state
 
+    // All patterns run in the LEDC peripheral; the task only wakes for commands
     while (1) {
-        // Check for LED commands (non-blocking)
         led_cmd_t cmd;
-        if (receive_led_cmd(&cmd, 0)) {
-            switch (cmd.type) {
-                case LED_CMD_LOCKED:
-                    set_locked_led();
-                    break;
-                case LED_CMD_UNLOCKED:
-                    set_unlocked_led();
-                    break;
-                case LED_CMD_ALARM:
-                    set_alarm_led_flashing();
-                    break;
-            }
+        if (!receive_led_cmd(&cmd, QUEUE_WAIT_FOREVER)) {
+            continue;
+        }
+        switch (cmd.type) {
+            case LED_CMD_LOCKED:
+                leds_play(led_pattern_for_state(STATE_LOCKED));
+                break;
+            case LED_CMD_UNLOCKED:
+                leds_play(led_pattern_for_state(STATE_UNLOCKED));
+                break;
+            case LED_CMD_ALARM:
+                leds_play(led_pattern_for_state(STATE_ALARM));
+                break;
+            case LED_CMD_ACK:
+                led_ack_blink();
+                break;
         }
-
-        // Update alarm flashing animation
-        leds_update();
-
-        vTaskDelay(pdMS_TO_TICKS(20));
     }
 }
@@ -3,13 +3,10 @@
 
 #include <stdint.h>
 #include "driver/gpio.h"
+#include "led_pattern.h"
 
-typedef enum {
-    LED_MODE_OFF = 0,
-    LED_MODE_LOCKED,
-    LED_MODE_UNLOCKED,
-    LED_MODE_ALARM_FLASH,
-} led_mode_t;
+// Driven by the LEDC peripheral: patterns (led_pattern.h) and the keypress
+// ack blink run in hardware without waking any task
 
 // GPIO pin definitions for LEDs
 // IMPORTANT: Use 220-330 ohm series resistors to limit current!
@@ -19,13 +16,16 @@ typedef enum {
 #define GREEN_LED_PIN GPIO_NUM_18
 
 void leds_init(void);
-void set_locked_led(void);
-void set_unlocked_led(void);
-void set_alarm_led_flashing(void);
-void leds_update(void);
 
-// FreeRTOS task that receives LED commands and handles alarm flashing
-// Priority 3 - real-time 500ms flash animation
+// Play a pattern (red LED shows its r, green its g); replaying the current
+// pattern leaves it running undisturbed
+void leds_play(const led_pattern_t *p);
+
+// Short dip of the lit LED to acknowledge a keypress (none during hard blinks)
+void led_ack_blink(void);
+
+// FreeRTOS task that receives LED commands; blocks until one arrives
+// Priority 3
 void led_task(void *pvParameters);
 
 #endif
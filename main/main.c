@@ -4,7 +4,7 @@
 #include "esp_log.h"
 #include "esp_task_wdt.h"
 #include "nvs_flash.h"
-#include "driver/i2c.h"
+#include "i2c_bus/i2c_bus.h"
 #include "queue_manager/queue_manager.h"
 #include "keypad/keypad.h"
 #include "mpu6050/mpu6050.h"
@@ -18,15 +18,14 @@ static const char *TAG = "MAIN";
 // I2C configuration (shared by MPU6050 and LCD)
 #define I2C_MASTER_SCL_IO           22
 #define I2C_MASTER_SDA_IO           21
-#define I2C_MASTER_FREQ_HZ          100000
-#define I2C_MASTER_NUM              I2C_NUM_0
+#define I2C_MASTER_FREQ_HZ          400000  // Fast-mode; i2c_bus falls back per device
 
 // Task priorities (higher number = higher priority)
 // See docs/task-architecture.md for detailed rationale
 #define KEYPAD_TASK_PRIORITY    6   // Highest - user expects instant response
 #define SENSOR_TASK_PRIORITY    5   // Security critical tamper detection
 #define CONTROL_TASK_PRIORITY   4   // Central logic coordinator
-#define LED_TASK_PRIORITY       3   // Real-time 500ms alarm flash
+#define LED_TASK_PRIORITY       3   // LED commands (patterns run in LEDC)
 #define LCD_TASK_PRIORITY       2   // Slow I2C, non-critical timing
 #define COMM_TASK_PRIORITY      1   // Lowest - network can be slow
 
@@ -39,33 +38,6 @@ static const char *TAG = "MAIN";
 #define LCD_TASK_STACK      3072    // I2C operations need extra stack
 #define COMM_TASK_STACK     8192
 
-static esp_err_t i2c_master_init(void)
-{
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_MASTER_SDA_IO,
-        .scl_io_num = I2C_MASTER_SCL_IO,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = I2C_MASTER_FREQ_HZ,
-    };
-
-    esp_err_t err = i2c_param_config(I2C_MASTER_NUM, &conf);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "I2C config failed: %s", esp_err_to_name(err));
-        return err;
-    }
-
-    err = i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "I2C driver install failed: %s", esp_err_to_name(err));
-        return err;
-    }
-
-    ESP_LOGI(TAG, "I2C master initialized (SDA=%d, SCL=%d)", I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO);
-    return ESP_OK;
-}
-
 void app_main(void)
 {
     ESP_LOGI(TAG, "Smart Safe starting...");
@@ -81,7 +53,7 @@ void app_main(void)
 
     // Initialize I2C bus (shared by MPU6050 and LCD)
     ESP_LOGI(TAG, "Initializing I2C bus...");
-    ESP_ERROR_CHECK(i2c_master_init());
+    ESP_ERROR_CHECK(i2c_bus_init(I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO, I2C_MASTER_FREQ_HZ));
 
     // Initialize queues for inter-task communication
     // Creates 6 queues: key_queue, sensor_queue, led_queue, lcd_queue, event_queue, cmd_queue
@@ -122,8 +94,8 @@ void app_main(void)
     }
     ESP_LOGI(TAG, "  lcd_task created (priority %d)", LCD_TASK_PRIORITY);
 
-    // Priority 3: LED task - handles LED state and alarm flashing
-    // Real-time 500ms flash animation for alarm state
+    // Priority 3: LED task - applies LED state commands; the alarm flash,
+    // breathing and ack blink then run in the LEDC peripheral
     if (xTaskCreate(led_task, "led_task", LED_TASK_STACK, NULL, LED_TASK_PRIORITY, NULL) != pdPASS) {
         ESP_LOGE(TAG, "Failed to create led_task");
         return;
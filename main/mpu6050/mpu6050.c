@@ -1,21 +1,23 @@
 #include "mpu6050.h"
 #include <math.h>
-#include "driver/i2c.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "nvs.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
-#include "../lcd_display/lcd_display.h"
+#include "tamper_detector.h"
+#include "../i2c_bus/i2c_bus.h"
 #include "../queue_manager/queue_manager.h"
 #include "../config.h"
 
 static const char *TAG = "MPU6050";
 
-// I2C mutex (shared with LCD)
-static SemaphoreHandle_t i2c_mutex = NULL;
-
 // Semaphore to signal motion interrupt
 static SemaphoreHandle_t motion_semaphore = NULL;
 
@@ -34,15 +36,474 @@ static SemaphoreHandle_t motion_semaphore = NULL;
 #define MPU6050_MOT_DUR      0x20  // Motion detection duration
 #define MPU6050_ACCEL_CONFIG 0x1C
 #define MPU6050_CONFIG       0x1A
-
-// I2C configuration
-#define I2C_PORT            I2C_NUM_0
-#define I2C_FREQ_HZ         100000
+#define MPU6050_SMPLRT_DIV   0x19
+#define MPU6050_FIFO_EN      0x23
+#define MPU6050_USER_CTRL    0x6A
+#define MPU6050_FIFO_COUNTH  0x72  // FIFO_COUNTL follows at 0x73
+#define MPU6050_FIFO_R_W     0x74
+
+// Register bits
+#define FIFO_EN_ACCEL        0x08  // Queue ACCEL_XOUT..ACCEL_ZOUT (6 bytes per sample)
+#define USER_CTRL_FIFO_EN    0x40
+#define USER_CTRL_FIFO_RESET 0x04
+#define INT_FIFO_OFLOW       0x10
+#define INT_DATA_RDY         0x01
+
+#if MPU6050_FIFO_MODE
+#define INT_SAMPLING         INT_FIFO_OFLOW
+#else
+#define INT_SAMPLING         INT_DATA_RDY
+#endif
+
+// Sampling mode (override in config.h):
+//   0 - data ready interrupt per sample, two I2C transactions per sample
+//   1 - samples collect in the sensor's FIFO and are drained in bursts of
+//       MPU6050_FIFO_BLOCK (FIFO count + one block read per wake)
+#ifndef MPU6050_FIFO_MODE
+#define MPU6050_FIFO_MODE 0
+#endif
+#ifndef MPU6050_FIFO_RATE_HZ
+#define MPU6050_FIFO_RATE_HZ 50
+#endif
+#ifndef MPU6050_FIFO_BLOCK
+#define MPU6050_FIFO_BLOCK 10
+#endif
+
+// Wake-on-motion (override in config.h): while quiet the sensor sits in
+// accel-only cycle mode with its motion interrupt armed; full-rate sampling
+// and the software detector run only from a hardware motion hit until
+// MPU6050_WOM_IDLE_MS pass without a candidate sample
+#ifndef MPU6050_WAKE_ON_MOTION
+#define MPU6050_WAKE_ON_MOTION 0
+#endif
+#ifndef MPU6050_WOM_LP_WAKE
+#define MPU6050_WOM_LP_WAKE 2   // Cycle rate: 0=1.25 Hz, 1=5 Hz, 2=20 Hz, 3=40 Hz
+#endif
+#ifndef MPU6050_WOM_IDLE_MS
+#define MPU6050_WOM_IDLE_MS 2000
+#endif
+
+#define PWR1_CYCLE           0x20
+#define PWR1_TEMP_DIS        0x08
+#define PWR2_STBY_GYRO       0x07  // STBY_XG | STBY_YG | STBY_ZG
+#define ACCEL_HPF_5HZ        0x01
+#define INT_MOT              0x40
+#define MOT_DUR_SAMPLES      1
+
+_Static_assert(MPU6050_WOM_LP_WAKE >= 0 && MPU6050_WOM_LP_WAKE <= 3, "MPU6050_WOM_LP_WAKE must be 0..3");
+
+// Trace recorder (override in config.h): the last MPU6050_TRACE_SAMPLES raw
+// samples, frozen when movement is confirmed and published by comm_task on
+// MQTT_TOPIC_TRACE; 0 disables
+#ifndef MPU6050_TRACE_SAMPLES
+#define MPU6050_TRACE_SAMPLES 512
+#endif
+
+// Rate the detector and trace recorder see samples at
+#if MPU6050_FIFO_MODE
+#define SENSOR_RATE_HZ MPU6050_FIFO_RATE_HZ
+#else
+#define SENSOR_RATE_HZ 50
+#endif
+
+#define FIFO_SIZE          1024
+#define FIFO_SAMPLE_BYTES  6
+#define FIFO_BURST_SAMPLES 32   // Largest single read (192 bytes)
+
+_Static_assert(MPU6050_FIFO_RATE_HZ >= 4 && MPU6050_FIFO_RATE_HZ <= 1000,
+               "MPU6050_FIFO_RATE_HZ must be 4..1000 (1 kHz / SMPLRT_DIV)");
+_Static_assert(MPU6050_FIFO_BLOCK >= 1 && MPU6050_FIFO_BLOCK * FIFO_SAMPLE_BYTES <= FIFO_SIZE / 2,
+               "MPU6050_FIFO_BLOCK must leave headroom in the 1 KB FIFO");
 
 static bool initialized = false;
-static int movement_hit_count = 0;
 static int32_t movement_threshold = INITIAL_SENSITIVITY;
 
+// Gravity-compensated detector state, fed every sample by sensor_task
+static tamper_detector_t detector;
+static int32_t last_score_mg = 0;
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// ============================================================================
+// Trace recorder
+// ============================================================================
+
+#if MPU6050_TRACE_SAMPLES > 0
+
+// Wire format (little-endian, read by tools/trace_replay): header, then
+// count samples oldest first; the last sample confirmed the movement
+typedef struct {
+    uint32_t magic;          // MPU6050_TRACE_MAGIC
+    uint16_t sample_rate_hz;
+    uint16_t count;
+    int32_t threshold;       // Sensitivity (legacy LSB) in force at the time
+    uint32_t trigger_ms;     // Time of the confirming sample (ms since boot)
+    uint16_t hit_count;      // MOVEMENT_HIT_COUNT
+    uint16_t reserved;
+} trace_header_t;
+
+typedef struct {
+    int16_t x, y, z;         // Raw accelerometer (±2g, 16384 LSB/g)
+    uint16_t t_ms;           // Low 16 bits of the sample time in ms
+} trace_sample_t;
+
+_Static_assert(sizeof(trace_header_t) == 20 && sizeof(trace_sample_t) == 8, "trace wire format");
+_Static_assert(MPU6050_TRACE_SAMPLES <= UINT16_MAX, "MPU6050_TRACE_SAMPLES too large");
+
+// Header and samples in one buffer so a frozen trace is published as is
+static struct {
+    trace_header_t header;
+    trace_sample_t samples[MPU6050_TRACE_SAMPLES];
+} trace;
+
+static int trace_head = 0;     // Next slot to write
+static int trace_count = 0;
+static atomic_bool trace_frozen = false;  // Owned by comm_task while set
+
+static void trace_reverse(int from, int to)
+{
+    while (from < --to) {
+        trace_sample_t tmp = trace.samples[from];
+        trace.samples[from++] = trace.samples[to];
+        trace.samples[to] = tmp;
+    }
+}
+
+static void trace_record(int16_t x, int16_t y, int16_t z, uint32_t t_ms)
+{
+    if (atomic_load(&trace_frozen)) {
+        return;
+    }
+    trace.samples[trace_head] = (trace_sample_t){ x, y, z, (uint16_t)t_ms };
+    trace_head = (trace_head + 1) % MPU6050_TRACE_SAMPLES;
+    if (trace_count < MPU6050_TRACE_SAMPLES) {
+        trace_count++;
+    }
+}
+
+// Unroll the ring oldest-first (in place) and hand it to comm_task
+static void trace_freeze(uint32_t trigger_ms)
+{
+    if (atomic_load(&trace_frozen) || trace_count == 0) {
+        return;
+    }
+    if (trace_count == MPU6050_TRACE_SAMPLES && trace_head != 0) {
+        trace_reverse(0, trace_head);
+        trace_reverse(trace_head, MPU6050_TRACE_SAMPLES);
+        trace_reverse(0, MPU6050_TRACE_SAMPLES);
+    }
+    trace.header = (trace_header_t){
+        .magic = MPU6050_TRACE_MAGIC,
+        .sample_rate_hz = SENSOR_RATE_HZ,
+        .count = (uint16_t)trace_count,
+        .threshold = movement_threshold,
+        .trigger_ms = trigger_ms,
+        .hit_count = MOVEMENT_HIT_COUNT,
+    };
+    atomic_store(&trace_frozen, true);
+}
+
+size_t mpu6050_trace_get(const uint8_t **data)
+{
+    if (!atomic_load(&trace_frozen)) {
+        return 0;
+    }
+    *data = (const uint8_t *)&trace;
+    return sizeof(trace_header_t) + trace.header.count * sizeof(trace_sample_t);
+}
+
+void mpu6050_trace_release(void)
+{
+    trace_head = 0;
+    trace_count = 0;
+    atomic_store(&trace_frozen, false);
+}
+
+#else
+
+static void trace_record(int16_t x, int16_t y, int16_t z, uint32_t t_ms) { }
+static void trace_freeze(uint32_t trigger_ms) { }
+
+size_t mpu6050_trace_get(const uint8_t **data)
+{
+    return 0;
+}
+
+void mpu6050_trace_release(void)
+{
+}
+
+#endif
+
+// ============================================================================
+// Calibration
+// ============================================================================
+
+// Calibration (override in config.h): MPU6050_CAL_SAMPLES samples of the safe
+// at rest give the resting vector per axis (mounting angle) and the mean and
+// standard deviation of the tamper score; the threshold becomes
+// noise + MPU6050_CAL_K * sigma, never below MPU6050_CAL_MIN_MG. Runs on first
+// boot, on the calibrate command and every MPU6050_RECALIBRATE_MS (0 disables)
+// alongside detection; any sample above MPU6050_CAL_MIN_MG restarts it
+#ifndef MPU6050_CAL_SAMPLES
+#define MPU6050_CAL_SAMPLES 150         // 3 s at 50 Hz
+#endif
+#ifndef MPU6050_CAL_K
+#define MPU6050_CAL_K 8
+#endif
+#ifndef MPU6050_CAL_MIN_MG
+#define MPU6050_CAL_MIN_MG 150
+#endif
+#ifndef MPU6050_RECALIBRATE_MS
+#define MPU6050_RECALIBRATE_MS (6UL * 60 * 60 * 1000)
+#endif
+
+#define CAL_SETTLE_SAMPLES  16          // Skipped while the score window settles
+#define CAL_MAX_SAMPLES     (MPU6050_CAL_SAMPLES * 4)  // Give up if never quiet for long enough
+#define CAL_SAVE_CHANGE_PCT 10          // Periodic results are saved only if the threshold moved this much
+#define CAL_VERSION         2
+
+_Static_assert(MPU6050_CAL_SAMPLES >= 16 && MPU6050_CAL_SAMPLES <= 10000, "MPU6050_CAL_SAMPLES must be 16..10000");
+
+static const char *CAL_NVS_NAMESPACE = "mpu6050";
+static const char *CAL_NVS_KEY = "calib";
+
+// NVS record
+typedef struct {
+    uint8_t version;            // CAL_VERSION
+    uint8_t reserved;
+    int16_t rest_lsb[3];        // Resting acceleration per axis (raw)
+    uint16_t noise_mg;          // Mean tamper score at rest
+    uint16_t sigma_mg;          // Standard deviation of the score at rest
+    int32_t threshold;          // Derived sensitivity (legacy LSB scale)
+    int32_t override;           // set_sensitivity value used instead, 0 if none
+} cal_record_t;
+
+// Running sums, fed by movement_feed() from sensor_task only
+static struct {
+    bool active;
+    bool persist;               // Save the result whatever it is (boot or request)
+    int fed;                    // Samples seen since the start (for CAL_MAX_SAMPLES)
+    int settle;
+    int count;
+    int64_t sum[3];
+    int64_t score_sum;
+    int64_t score_sq_sum;
+} cal;
+
+static atomic_bool cal_requested = false;
+static uint32_t last_calibration_ms = 0;
+
+// Calibration in use (sensor_task), kept to store the override with it
+static cal_record_t cal_current;
+static bool cal_valid = false;
+
+// set_sensitivity override: kept across calibrations and reboots until the
+// calibrate command. Set from the command handler, saved by sensor_task.
+static atomic_int_least32_t sensitivity_override = 0;
+static atomic_bool override_dirty = false;
+
+static bool cal_load(cal_record_t *rec)
+{
+    nvs_handle_t handle;
+    if (nvs_open(CAL_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t size = sizeof(*rec);
+    esp_err_t err = nvs_get_blob(handle, CAL_NVS_KEY, rec, &size);
+    nvs_close(handle);
+    return err == ESP_OK && size == sizeof(*rec) && rec->version == CAL_VERSION;
+}
+
+static void cal_save(const cal_record_t *rec)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CAL_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, CAL_NVS_KEY, rec, sizeof(*rec));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save calibration to NVS: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Calibration saved to NVS");
+    }
+}
+
+// Use a calibration: its threshold (unless overridden), and its resting
+// vector as the detector's gravity estimate so the score starts at the noise
+// floor
+static void cal_apply(const cal_record_t *rec)
+{
+    cal_current = *rec;
+    cal_valid = true;
+    atomic_store(&sensitivity_override, rec->override);
+    if (rec->override != 0) {
+        ESP_LOGI(TAG, "Keeping set_sensitivity %ld over calibrated %ld (calibrate to clear)",
+                 (long)rec->override, (long)rec->threshold);
+        mpu6050_set_threshold(rec->override);
+    } else {
+        mpu6050_set_threshold(rec->threshold);
+    }
+    for (int i = 0; i < 3; i++) {
+        detector.gravity[i] = (int32_t)rec->rest_lsb[i] * (1 << TAMPER_GRAVITY_FRAC);
+    }
+    detector.seeded = 1;
+}
+
+static void cal_report(const cal_record_t *rec)
+{
+    sensor_event_t evt = {
+        .type = SENSOR_EVT_CALIBRATED,
+        .calibration = {
+            .noise_mg = rec->noise_mg,
+            .sigma_mg = rec->sigma_mg,
+            .threshold = rec->threshold,
+        },
+    };
+    for (int i = 0; i < 3; i++) {
+        evt.calibration.rest_mg[i] = (int16_t)(rec->rest_lsb[i] * 1000 / 16384);
+    }
+    send_sensor_event(&evt);
+}
+
+static void cal_start(bool persist)
+{
+    memset(&cal, 0, sizeof(cal));
+    cal.active = true;
+    cal.persist = persist;
+    ESP_LOGI(TAG, "Calibrating over %d samples, keep the safe still", MPU6050_CAL_SAMPLES);
+}
+
+static void cal_finish(void)
+{
+    cal_record_t rec = { .version = CAL_VERSION };
+    for (int i = 0; i < 3; i++) {
+        rec.rest_lsb[i] = (int16_t)(cal.sum[i] / cal.count);
+    }
+
+    int64_t mean = cal.score_sum / cal.count;
+    int64_t variance = cal.score_sq_sum / cal.count - mean * mean;
+    int32_t sigma = (int32_t)sqrtf((float)(variance > 0 ? variance : 0));
+    int32_t threshold_mg = (int32_t)mean + MPU6050_CAL_K * sigma;
+    if (threshold_mg < MPU6050_CAL_MIN_MG) {
+        threshold_mg = MPU6050_CAL_MIN_MG;
+    }
+
+    // Back to the legacy scale (inverse of tamper_threshold_mg)
+    int32_t threshold = 16384 + threshold_mg * 16384 / 1000;
+    if (threshold > MOVEMENT_THRESHOLD_MAX) {
+        threshold = MOVEMENT_THRESHOLD_MAX;
+    } else if (threshold < MOVEMENT_THRESHOLD_MIN) {
+        threshold = MOVEMENT_THRESHOLD_MIN;
+    }
+    rec.noise_mg = (uint16_t)mean;
+    rec.sigma_mg = (uint16_t)sigma;
+    rec.threshold = threshold;
+
+    // A requested calibration (command or first boot) drops the override
+    rec.override = cal.persist ? 0 : atomic_load(&sensitivity_override);
+
+    int32_t old_mg = tamper_threshold_mg(cal_valid ? cal_current.threshold : movement_threshold);
+    int32_t new_mg = tamper_threshold_mg(threshold);
+    bool changed = abs(new_mg - old_mg) * 100 >= old_mg * CAL_SAVE_CHANGE_PCT;
+
+    ESP_LOGI(TAG, "Calibrated: rest %d/%d/%d LSB, noise %u mg, sigma %u mg, threshold %ld (%ld mg)",
+             rec.rest_lsb[0], rec.rest_lsb[1], rec.rest_lsb[2], rec.noise_mg, rec.sigma_mg,
+             (long)threshold, (long)new_mg);
+
+    cal_apply(&rec);
+    if (cal.persist || changed) {
+        cal_save(&rec);
+    }
+    cal_report(&rec);
+    cal.active = false;
+    last_calibration_ms = now_ms();
+}
+
+// Accumulate one sample; disturbed is true when the sample cannot be rest
+static void cal_feed(int16_t x, int16_t y, int16_t z, int32_t score_mg, bool disturbed)
+{
+    if (!cal.active) {
+        return;
+    }
+    if (++cal.fed > CAL_MAX_SAMPLES) {
+        ESP_LOGW(TAG, "Calibration abandoned, the safe was not still for long enough");
+        cal.active = false;
+        last_calibration_ms = now_ms();
+        return;
+    }
+    if (disturbed || score_mg >= MPU6050_CAL_MIN_MG) {
+        cal.settle = 0;
+        cal.count = 0;
+        memset(cal.sum, 0, sizeof(cal.sum));
+        cal.score_sum = 0;
+        cal.score_sq_sum = 0;
+        return;
+    }
+    if (cal.settle < CAL_SETTLE_SAMPLES) {
+        cal.settle++;
+        return;
+    }
+
+    cal.sum[0] += x;
+    cal.sum[1] += y;
+    cal.sum[2] += z;
+    cal.score_sum += score_mg;
+    cal.score_sq_sum += (int64_t)score_mg * score_mg;
+    if (++cal.count >= MPU6050_CAL_SAMPLES) {
+        cal_finish();
+    }
+}
+
+static bool calibration_due(void)
+{
+#if MPU6050_RECALIBRATE_MS > 0
+    return now_ms() - last_calibration_ms >= MPU6050_RECALIBRATE_MS;
+#else
+    return false;
+#endif
+}
+
+static bool calibration_pending(void)
+{
+    return atomic_load(&cal_requested) || calibration_due();
+}
+
+// Start a requested or periodic calibration (sensor_task)
+static void calibration_poll(void)
+{
+    if (cal.active) {
+        return;
+    }
+    bool requested = atomic_exchange(&cal_requested, false);
+    if (requested || calibration_due()) {
+        cal_start(requested);
+    }
+}
+
+void mpu6050_request_calibration(void)
+{
+    atomic_store(&cal_requested, true);
+}
+
+// Save a new override with the stored calibration (sensor_task). Before the
+// first calibration there is nothing to store it with; cal_finish saves it.
+static void override_poll(void)
+{
+    if (!atomic_exchange(&override_dirty, false) || !cal_valid) {
+        return;
+    }
+    cal_current.override = atomic_load(&sensitivity_override);
+    cal_save(&cal_current);
+}
+
 // ISR handler - uses IRAM_ATTR and FromISR functions for interrupt safety
 static void IRAM_ATTR mpu6050_isr_handler(void *arg)
 {
@@ -55,50 +516,23 @@ static void IRAM_ATTR mpu6050_isr_handler(void *arg)
 
 static esp_err_t mpu6050_write_reg(uint8_t reg_addr, uint8_t data)
 {
-    if (i2c_mutex == NULL || xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire I2C mutex for write");
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (MPU6050_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_write_byte(cmd, data, true);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_PORT, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-    
-    xSemaphoreGive(i2c_mutex);
-    return ret;
+    return i2c_bus_write_reg(I2C_DEV_MPU6050, reg_addr, data);
 }
 
 static esp_err_t mpu6050_read_reg(uint8_t reg_addr, uint8_t *data, size_t len)
 {
-    if (len == 0) return ESP_OK;
-    
-    if (i2c_mutex == NULL || xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire I2C mutex for read");
-        return ESP_ERR_TIMEOUT;
-    }
+    return i2c_bus_read_reg(I2C_DEV_MPU6050, reg_addr, data, len);
+}
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (MPU6050_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (MPU6050_ADDR << 1) | I2C_MASTER_READ, true);
-    if (len > 1) {
-        i2c_master_read(cmd, data, len - 1, I2C_MASTER_ACK);
-    }
-    i2c_master_read_byte(cmd, data + len - 1, I2C_MASTER_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_PORT, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-    
-    xSemaphoreGive(i2c_mutex);
-    return ret;
+#if MPU6050_FIFO_MODE
+// Empty the FIFO and restart collection (FIFO_RESET only acts while FIFO_EN is 0)
+static void mpu6050_fifo_reset(void)
+{
+    mpu6050_write_reg(MPU6050_USER_CTRL, 0);
+    mpu6050_write_reg(MPU6050_USER_CTRL, USER_CTRL_FIFO_RESET);
+    mpu6050_write_reg(MPU6050_USER_CTRL, USER_CTRL_FIFO_EN);
 }
+#endif
 
 // Configure MPU6050 data ready interrupt for reliable motion detection
 static bool mpu6050_configure_interrupt(void)
@@ -120,20 +554,37 @@ static bool mpu6050_configure_interrupt(void)
         ESP_LOGW(TAG, "Failed to configure DLPF");
     }
 
+#if MPU6050_FIFO_MODE
+    // Sample rate = 1kHz / (SMPLRT_DIV + 1)
+    if (mpu6050_write_reg(MPU6050_SMPLRT_DIV, 1000 / MPU6050_FIFO_RATE_HZ - 1) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set sample rate");
+    }
+#else
     // Set sample rate divider for ~50Hz (1kHz / (19+1) = 50Hz)
-    if (mpu6050_write_reg(0x19, 19) != ESP_OK) {
+    if (mpu6050_write_reg(MPU6050_SMPLRT_DIV, 19) != ESP_OK) {
         ESP_LOGW(TAG, "Failed to set sample rate");
     }
+#endif
 
     // Configure INT pin: active low, push-pull, latched, clear on any read
     if (mpu6050_write_reg(MPU6050_INT_PIN_CFG, 0xB0) != ESP_OK) {
         ESP_LOGW(TAG, "Failed to configure INT pin");
     }
 
+#if MPU6050_FIFO_MODE
+    // The MPU6050 has no FIFO watermark interrupt: sensor_task drains on a
+    // timer and the overflow interrupt only wakes it if it falls behind
+    if (mpu6050_write_reg(MPU6050_FIFO_EN, FIFO_EN_ACCEL) != ESP_OK ||
+        mpu6050_write_reg(MPU6050_INT_ENABLE, INT_SAMPLING) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to configure FIFO");
+    }
+    mpu6050_fifo_reset();
+#else
     // Enable Data Ready interrupt (bit 0)
-    if (mpu6050_write_reg(MPU6050_INT_ENABLE, 0x01) != ESP_OK) {
+    if (mpu6050_write_reg(MPU6050_INT_ENABLE, INT_SAMPLING) != ESP_OK) {
         ESP_LOGW(TAG, "Failed to enable data ready interrupt");
     }
+#endif
 
     // Configure ESP32 GPIO for interrupt
     gpio_config_t io_conf = {
@@ -156,10 +607,22 @@ static bool mpu6050_configure_interrupt(void)
     gpio_isr_handler_add(MPU6050_INT_PIN, mpu6050_isr_handler, NULL);
     gpio_intr_enable(MPU6050_INT_PIN);
 
+#if MPU6050_FIFO_MODE
+    ESP_LOGI(TAG, "FIFO mode: %d Hz, %d-sample blocks, overflow interrupt on GPIO %d",
+             MPU6050_FIFO_RATE_HZ, MPU6050_FIFO_BLOCK, MPU6050_INT_PIN);
+#else
     ESP_LOGI(TAG, "Data ready interrupt configured on GPIO %d", MPU6050_INT_PIN);
+#endif
     return true;
 }
 
+// Clock bring-up check: WHO_AM_I must read back intact
+static bool mpu6050_check(i2c_dev_t dev)
+{
+    uint8_t who_am_i = 0;
+    return i2c_bus_read_reg(dev, MPU6050_WHO_AM_I, &who_am_i, 1) == ESP_OK && who_am_i == 0x68;
+}
+
 bool mpu6050_init(void)
 {
     if (initialized) {
@@ -168,16 +631,11 @@ bool mpu6050_init(void)
 
     ESP_LOGI(TAG, "Initializing MPU6050 with interrupt-driven motion detection...");
 
-    // Get shared I2C mutex from LCD driver
-    i2c_mutex = lcd_display_get_i2c_mutex();
-    if (i2c_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to get I2C mutex - ensure lcd_display_init() is called first");
+    // I2C bus is already initialized in main.c
+    if (i2c_bus_add_device(I2C_DEV_MPU6050, MPU6050_ADDR, mpu6050_check) != ESP_OK) {
         return false;
     }
 
-    // I2C bus is already initialized in main.c
-    ESP_LOGI(TAG, "I2C initialized (SDA=%d, SCL=%d)", MPU6050_SDA_PIN, MPU6050_SCL_PIN);
-
     // Wake up MPU6050 (clear sleep bit, use internal 8MHz oscillator)
     if (mpu6050_write_reg(MPU6050_PWR_MGMT_1, 0x00) != ESP_OK) {
         ESP_LOGW(TAG, "Failed to wake MPU6050");
@@ -198,7 +656,20 @@ bool mpu6050_init(void)
                 return false;
             }
 
+            tamper_detector_init(&detector, SENSOR_RATE_HZ);
             initialized = true;
+
+            // A stored calibration is reused; only the first boot calibrates
+            cal_record_t rec;
+            if (cal_load(&rec)) {
+                ESP_LOGI(TAG, "Calibration loaded: noise %u mg, sigma %u mg, threshold %ld",
+                         rec.noise_mg, rec.sigma_mg, (long)rec.threshold);
+                cal_apply(&rec);
+            } else {
+                ESP_LOGI(TAG, "No stored calibration");
+                mpu6050_request_calibration();
+            }
+            last_calibration_ms = now_ms();
             return true;
         }
     }
@@ -231,6 +702,33 @@ float mpu6050_read_movement(void)
     return magnitude;
 }
 
+// Record one sample (big-endian X, Y, Z, taken at t_ms) and run the debounced
+// detector on it
+static bool movement_feed(const uint8_t *data, uint32_t t_ms)
+{
+    int16_t accel_x = (int16_t)((data[0] << 8) | data[1]);
+    int16_t accel_y = (int16_t)((data[2] << 8) | data[3]);
+    int16_t accel_z = (int16_t)((data[4] << 8) | data[5]);
+
+    trace_record(accel_x, accel_y, accel_z, t_ms);
+
+    // Tamper score: dynamic acceleration in mg with gravity removed
+    last_score_mg = tamper_detector_update(&detector, accel_x, accel_y, accel_z);
+
+    // Debounce: require consecutive over-threshold readings
+    bool detected = tamper_detector_confirm(&detector, last_score_mg, tamper_threshold_mg(movement_threshold),
+                                            MOVEMENT_HIT_COUNT);
+    cal_feed(accel_x, accel_y, accel_z, last_score_mg, detected);
+
+    if (detected) {
+        ESP_LOGW(TAG, "Movement detected! X:%d Y:%d Z:%d score:%ldmg", accel_x, accel_y, accel_z, (long)last_score_mg);
+        trace_freeze(t_ms);
+        return true;
+    }
+
+    return false;
+}
+
 bool mpu6050_movement_detected(void)
 {
     if (!initialized) {
@@ -242,31 +740,62 @@ bool mpu6050_movement_detected(void)
         return false;
     }
 
-    int16_t accel_x = (int16_t)((data[0] << 8) | data[1]);
-    int16_t accel_y = (int16_t)((data[2] << 8) | data[3]);
-    int16_t accel_z = (int16_t)((data[4] << 8) | data[5]);
+    return movement_feed(data, now_ms());
+}
 
-    // Calculate magnitude squared (use int64_t to avoid overflow)
-    int64_t magnitude_sq = (int64_t)accel_x * accel_x + (int64_t)accel_y * accel_y + (int64_t)accel_z * accel_z;
-    int64_t threshold_sq = (int64_t)movement_threshold * movement_threshold;
+#if MPU6050_FIFO_MODE
+// Drain every whole sample in the FIFO and run the detector over it.
+// Returns true with the magnitude (g) of the confirming sample if movement
+// was detected; the rest of the FIFO is left for the caller to reset.
+static bool mpu6050_fifo_process(float *movement_g)
+{
+    static uint8_t block[FIFO_BURST_SAMPLES * FIFO_SAMPLE_BYTES];
 
-    // Debounce: require consecutive over-threshold readings
-    if (magnitude_sq > threshold_sq) {
-        if (movement_hit_count < MOVEMENT_HIT_COUNT) {
-            movement_hit_count++;
-        }
-    } else if (movement_hit_count > 0) {
-        movement_hit_count--;
+    uint8_t count_buf[2];
+    if (mpu6050_read_reg(MPU6050_FIFO_COUNTH, count_buf, 2) != ESP_OK) {
+        return false;
     }
+    int count = (count_buf[0] << 8) | count_buf[1];
 
-    if (movement_hit_count >= MOVEMENT_HIT_COUNT) {
-        movement_hit_count = 0;  // Reset after confirming movement
-        ESP_LOGW(TAG, "Movement detected! X:%d Y:%d Z:%d", accel_x, accel_y, accel_z);
-        return true;
+    // A full FIFO has overwritten old data and may have lost sample alignment
+    if (count >= FIFO_SIZE) {
+        ESP_LOGW(TAG, "FIFO overflow, resetting");
+        mpu6050_fifo_reset();
+        detector.hits = 0;
+        return false;
     }
 
+    // The newest sample was taken about now; earlier ones one period apart
+    int samples = count / FIFO_SAMPLE_BYTES;
+    uint32_t t_ms = now_ms() - (samples - 1) * (1000 / MPU6050_FIFO_RATE_HZ);
+    while (samples > 0) {
+        int n = (samples < FIFO_BURST_SAMPLES) ? samples : FIFO_BURST_SAMPLES;
+        if (mpu6050_read_reg(MPU6050_FIFO_R_W, block, n * FIFO_SAMPLE_BYTES) != ESP_OK) {
+            return false;
+        }
+        for (int i = 0; i < n; i++) {
+            const uint8_t *sample = &block[i * FIFO_SAMPLE_BYTES];
+            if (movement_feed(sample, t_ms)) {
+                *movement_g = last_score_mg / 1000.0f;
+                return true;
+            }
+            t_ms += 1000 / MPU6050_FIFO_RATE_HZ;
+        }
+        samples -= n;
+    }
     return false;
 }
+#endif
+
+// Convert threshold to MPU6050 MOT_THR format (0-255, 2mg per LSB, compared
+// against the high-pass filtered sample). Map 17000-45000 to approximately
+// 10-80, i.e. a 20-160 mg wake threshold that errs on the sensitive side:
+// the software detector makes the final call.
+static uint8_t threshold_to_mot_thr(int32_t threshold)
+{
+    return (uint8_t)(((threshold - MOVEMENT_THRESHOLD_MIN) * 70) /
+                     (MOVEMENT_THRESHOLD_MAX - MOVEMENT_THRESHOLD_MIN) + 10);
+}
 
 void mpu6050_set_threshold(int32_t threshold)
 {
@@ -277,10 +806,7 @@ void mpu6050_set_threshold(int32_t threshold)
     }
     movement_threshold = threshold;
 
-    // Convert to MPU6050 MOT_THR format (0-255, ~32mg per LSB)
-    // Map 17000-45000 to approximately 10-80 in MOT_THR
-    uint8_t mot_thr = (uint8_t)(((threshold - MOVEMENT_THRESHOLD_MIN) * 70) /
-                                 (MOVEMENT_THRESHOLD_MAX - MOVEMENT_THRESHOLD_MIN) + 10);
+    uint8_t mot_thr = threshold_to_mot_thr(threshold);
     if (initialized) {
         mpu6050_write_reg(MPU6050_MOT_THR, mot_thr);
     }
@@ -288,11 +814,87 @@ void mpu6050_set_threshold(int32_t threshold)
     ESP_LOGI(TAG, "Movement threshold set to %ld (MOT_THR=%d)", (long)movement_threshold, mot_thr);
 }
 
+void mpu6050_override_threshold(int32_t threshold)
+{
+    mpu6050_set_threshold(threshold);
+    atomic_store(&sensitivity_override, movement_threshold);
+    atomic_store(&override_dirty, true);
+}
+
 int32_t mpu6050_get_threshold(void)
 {
     return movement_threshold;
 }
 
+#if MPU6050_WAKE_ON_MOTION
+// Clear the latched interrupt and any wake left over from the previous mode
+static void mpu6050_clear_interrupt(void)
+{
+    uint8_t int_status = 0;
+    mpu6050_read_reg(MPU6050_INT_STATUS, &int_status, 1);
+    xSemaphoreTake(motion_semaphore, 0);
+}
+
+// Accel-only cycle mode: the sensor wakes at the LP_WAKE rate, compares the
+// high-pass filtered sample against MOT_THR and raises INT on a hit
+static void mpu6050_enter_low_power(void)
+{
+#if MPU6050_FIFO_MODE
+    mpu6050_write_reg(MPU6050_USER_CTRL, 0);
+#endif
+    mpu6050_write_reg(MPU6050_INT_ENABLE, INT_MOT);
+    mpu6050_write_reg(MPU6050_ACCEL_CONFIG, ACCEL_HPF_5HZ);   // ±2g, gravity filtered out
+    mpu6050_write_reg(MPU6050_MOT_THR, threshold_to_mot_thr(movement_threshold));
+    mpu6050_write_reg(MPU6050_MOT_DUR, MOT_DUR_SAMPLES);
+    mpu6050_write_reg(MPU6050_PWR_MGMT_2, (MPU6050_WOM_LP_WAKE << 6) | PWR2_STBY_GYRO);
+    mpu6050_write_reg(MPU6050_PWR_MGMT_1, PWR1_CYCLE | PWR1_TEMP_DIS);
+    mpu6050_clear_interrupt();
+    ESP_LOGI(TAG, "Quiet, armed wake-on-motion");
+}
+
+// Back to continuous sampling for the software detector (gyro stays off)
+static void mpu6050_enter_active(void)
+{
+    mpu6050_write_reg(MPU6050_PWR_MGMT_1, 0x00);
+    mpu6050_write_reg(MPU6050_PWR_MGMT_2, PWR2_STBY_GYRO);
+    mpu6050_write_reg(MPU6050_ACCEL_CONFIG, 0x00);            // HPF off: detector expects gravity
+    mpu6050_write_reg(MPU6050_INT_ENABLE, INT_SAMPLING);
+#if MPU6050_FIFO_MODE
+    mpu6050_fifo_reset();
+#endif
+    mpu6050_clear_interrupt();
+    detector.hits = 0;
+}
+#endif
+
+// Take one sample (or FIFO block) and run the detector on it.
+// Returns true with the movement magnitude in g if movement was confirmed.
+static bool sensor_sample(float *movement_g)
+{
+#if MPU6050_FIFO_MODE
+    // Sleep for one block; the overflow interrupt cuts this short if we
+    // fell behind. Reading FIFO_COUNT also clears the latched interrupt.
+    xSemaphoreTake(motion_semaphore, pdMS_TO_TICKS(MPU6050_FIFO_BLOCK * 1000 / MPU6050_FIFO_RATE_HZ));
+    return mpu6050_fifo_process(movement_g);
+#else
+    // Wait for data ready interrupt (50Hz)
+    if (xSemaphoreTake(motion_semaphore, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        return false;
+    }
+
+    // Clear interrupt by reading INT_STATUS
+    uint8_t int_status = 0;
+    mpu6050_read_reg(MPU6050_INT_STATUS, &int_status, 1);
+
+    // Check for movement using software detection
+    if (mpu6050_movement_detected()) {
+        *movement_g = last_score_mg / 1000.0f;
+        return true;
+    }
+    return false;
+#endif
+}
+
 void sensor_task(void *pvParameters)
 {
     (void)pvParameters;
@@ -308,27 +910,65 @@ void sensor_task(void *pvParameters)
     // Register with task watchdog (10 second timeout)
     esp_task_wdt_add(NULL);
 
+#if MPU6050_WAKE_ON_MOTION
+    // A pending first-boot calibration needs full-rate samples
+    bool armed = !calibration_pending();
+    if (armed) {
+        mpu6050_enter_low_power();
+    }
+    TickType_t last_activity = xTaskGetTickCount();
+#endif
+
     while (1) {
-        // Wait for data ready interrupt (50Hz)
-        if (xSemaphoreTake(motion_semaphore, pdMS_TO_TICKS(1000)) == pdTRUE) {
+        override_poll();
+
+#if MPU6050_WAKE_ON_MOTION
+        if (armed) {
+            // Only the hardware motion interrupt (or the watchdog timeout) wakes us
+            if (xSemaphoreTake(motion_semaphore, pdMS_TO_TICKS(1000)) == pdTRUE) {
+                ESP_LOGI(TAG, "Motion wake, sampling at full rate");
+                mpu6050_enter_active();
+                armed = false;
+                last_activity = xTaskGetTickCount();
+            } else if (calibration_pending()) {
+                ESP_LOGI(TAG, "Waking to calibrate");
+                mpu6050_enter_active();
+                armed = false;
+                last_activity = xTaskGetTickCount();
+            }
             esp_task_wdt_reset();
+            continue;
+        }
+#endif
 
-            // Clear interrupt by reading INT_STATUS
-            uint8_t int_status = 0;
-            mpu6050_read_reg(MPU6050_INT_STATUS, &int_status, 1);
+        calibration_poll();
 
-            // Check for movement using software detection
-            if (mpu6050_movement_detected()) {
-                float movement = mpu6050_read_movement();
-                sensor_event_t evt = { .movement_g = movement };
-                send_sensor_event(&evt);
-                ESP_LOGW(TAG, "Movement %.2fg detected", movement);
+        float movement = 0.0f;
+        bool detected = sensor_sample(&movement);
+        esp_task_wdt_reset();
 
-                // Debounce delay
-                vTaskDelay(pdMS_TO_TICKS(500));
-            }
-        } else {
-            esp_task_wdt_reset();
+        if (detected) {
+            sensor_event_t evt = { .type = SENSOR_EVT_MOVEMENT, .movement_g = movement };
+            send_sensor_event(&evt);
+            ESP_LOGW(TAG, "Movement %.2fg detected", movement);
+
+            // Debounce delay
+            vTaskDelay(pdMS_TO_TICKS(500));
+#if MPU6050_FIFO_MODE
+            // Discard what was sampled during the debounce delay
+            mpu6050_fifo_reset();
+#endif
+        }
+
+#if MPU6050_WAKE_ON_MOTION
+        // Stay at full rate while the detector sees candidate samples or a
+        // calibration is running
+        if (detected || detector.hits > 0 || cal.active) {
+            last_activity = xTaskGetTickCount();
+        } else if (xTaskGetTickCount() - last_activity >= pdMS_TO_TICKS(MPU6050_WOM_IDLE_MS)) {
+            mpu6050_enter_low_power();
+            armed = true;
         }
+#endif
     }
 }
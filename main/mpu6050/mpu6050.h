@@ -2,12 +2,15 @@
 #define MPU6050_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-// Movement detection threshold defaults (raw LSB magnitude)
-// Note: At rest, gravity reads ~16384 LSB (1g), so min must be above this
-// Max is 45000 to avoid int32_t overflow when squared (45000^2 < 2^31)
-#define MOVEMENT_THRESHOLD_DEFAULT 20000
+// Movement detection threshold defaults (raw LSB magnitude, kept for
+// compatibility with set_sensitivity). The detector removes gravity and
+// compares its tamper score against threshold - 1g, i.e. (T - 16384) LSB,
+// floored at 150 mg: 17000 = 150 mg, 19000 = 159 mg, 45000 = 1746 mg
+// (see tamper_detector.h)
+#define MOVEMENT_THRESHOLD_DEFAULT 19000
 #define MOVEMENT_THRESHOLD_MIN     17000  // Most sensitive (just above 1g gravity)
 #define MOVEMENT_THRESHOLD_MAX     45000  // Least sensitive
 #define MOVEMENT_HIT_COUNT 3  // Consecutive hits to confirm movement
@@ -22,7 +25,7 @@
 // Initialize MPU6050 accelerometer
 bool mpu6050_init(void);
 
-// Read movement magnitude in g units
+// Read movement magnitude in g units (raw |a|, gravity included)
 float mpu6050_read_movement(void);
 
 // Check if movement exceeds threshold (with debouncing)
@@ -32,6 +35,29 @@ bool mpu6050_movement_detected(void);
 void mpu6050_set_threshold(int32_t threshold);
 int32_t mpu6050_get_threshold(void);
 
+// Set the threshold as an override (set_sensitivity command): saved to NVS
+// and kept over periodic calibrations and reboots until the next requested
+// calibration (mpu6050_request_calibration)
+void mpu6050_override_threshold(int32_t threshold);
+
+// Re-learn the resting vector and noise floor and derive the threshold from
+// them (noise + k * sigma), saved to NVS. Runs in sensor_task over the next
+// few seconds; the result is sent as a SENSOR_EVT_CALIBRATED event. Called
+// automatically on first boot and periodically (MPU6050_RECALIBRATE_MS).
+void mpu6050_request_calibration(void);
+
+// Alarm trace: the raw samples leading up to the last confirmed movement, in
+// the binary format read by tools/trace_replay (little-endian 20-byte header
+// starting with MPU6050_TRACE_MAGIC, then 8 bytes per sample)
+#define MPU6050_TRACE_MAGIC 0x31435254  // "TRC1"
+
+// Frozen trace waiting to be published: sets *data and returns its length,
+// 0 if none (recording is paused until mpu6050_trace_release())
+size_t mpu6050_trace_get(const uint8_t **data);
+
+// Resume recording once the trace has been published
+void mpu6050_trace_release(void);
+
 // FreeRTOS task for motion detection using hardware interrupts
 // Priority 5 - security critical tamper detection
 // Uses MPU6050 INT pin (GPIO 19) for interrupt-driven detection
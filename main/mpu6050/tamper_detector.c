@@ -0,0 +1,103 @@
+#include "tamper_detector.h"
+#include <string.h>
+
+// Gravity estimate time constant: long enough that a knock or handling
+// barely moves it, short enough to follow a slow tilt (~0.5 Hz high-pass)
+#define GRAVITY_TAU_MS 320
+
+// Energy window (~8 samples at 50 Hz)
+#define ENERGY_TAU_MS  160
+
+#define LSB_PER_G 16384
+
+// Smallest shift s (1..12) with 2^s samples >= tau_ms at the given rate
+static uint8_t tau_to_shift(uint32_t tau_ms, uint32_t sample_rate_hz)
+{
+    uint32_t samples = tau_ms * sample_rate_hz / 1000;
+    uint8_t shift = 1;
+    while (shift < 12 && (1u << shift) < samples) {
+        shift++;
+    }
+    return shift;
+}
+
+// Integer square root (floor)
+static uint32_t isqrt32(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+void tamper_detector_init(tamper_detector_t *det, uint32_t sample_rate_hz)
+{
+    memset(det, 0, sizeof(*det));
+    det->gravity_shift = tau_to_shift(GRAVITY_TAU_MS, sample_rate_hz);
+    det->energy_shift = tau_to_shift(ENERGY_TAU_MS, sample_rate_hz);
+}
+
+int32_t tamper_detector_update(tamper_detector_t *det, int16_t x, int16_t y, int16_t z)
+{
+    const int32_t sample[3] = { x, y, z };
+
+    // Seed gravity from the first sample so start-up is not a step
+    if (!det->seeded) {
+        for (int i = 0; i < 3; i++) {
+            det->gravity[i] = sample[i] * (1 << TAMPER_GRAVITY_FRAC);
+        }
+        det->seeded = 1;
+    }
+
+    // Residual and jerk are at most ~4000 and ~8000 mg per axis, so the
+    // feature (< 2^28) and the energy fit in int32
+    int32_t feature = 0;
+    for (int i = 0; i < 3; i++) {
+        int32_t scaled = sample[i] * (1 << TAMPER_GRAVITY_FRAC);
+        det->gravity[i] += (scaled - det->gravity[i]) >> det->gravity_shift;
+
+        int32_t residual_lsb = sample[i] - (det->gravity[i] >> TAMPER_GRAVITY_FRAC);
+        int32_t residual = residual_lsb * 1000 / LSB_PER_G;
+        int32_t jerk = residual - det->prev_residual[i];
+        det->prev_residual[i] = residual;
+
+        feature += residual * residual + (jerk * jerk) / 4;
+    }
+
+    det->energy += (feature - det->energy) >> det->energy_shift;
+    return (int32_t)isqrt32((uint32_t)det->energy);
+}
+
+bool tamper_detector_confirm(tamper_detector_t *det, int32_t score_mg, int32_t threshold_mg, int hit_count)
+{
+    if (score_mg > threshold_mg) {
+        if (det->hits < hit_count) {
+            det->hits++;
+        }
+    } else if (det->hits > 0) {
+        det->hits--;
+    }
+
+    if (det->hits >= hit_count) {
+        det->hits = 0;  // Reset after confirming movement
+        return true;
+    }
+    return false;
+}
+
+int32_t tamper_threshold_mg(int32_t legacy_threshold)
+{
+    int32_t mg = (legacy_threshold - LSB_PER_G) * 1000 / LSB_PER_G;
+    return (mg < TAMPER_THRESHOLD_MIN_MG) ? TAMPER_THRESHOLD_MIN_MG : mg;
+}
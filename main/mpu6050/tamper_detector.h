@@ -0,0 +1,71 @@
+#ifndef TAMPER_DETECTOR_H
+#define TAMPER_DETECTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Tamper detector: turns raw accelerometer samples (±2g, 16384 LSB/g) into a
+ * tamper score in milli-g, using integer arithmetic only.
+ *
+ *   gravity  - running estimate of the gravity vector (first-order IIR
+ *              low-pass, time constant set at init), so slow tilts and
+ *              mounting angle are tracked instead of alarmed on
+ *   residual - sample minus gravity (high-pass), i.e. dynamic acceleration
+ *   jerk     - change in residual between samples (sharp knocks)
+ *   score    - RMS over a short exponential window of |residual|^2 plus a
+ *              quarter of |jerk|^2, in mg
+ *   confirm  - movement when the score stays above threshold for
+ *              consecutive samples (hit counter, decays on quiet samples)
+ *
+ * Host-buildable (no ESP-IDF dependencies) so tools/trace_replay runs the
+ * exact device code on recorded traces.
+ *
+ * At rest the score is the sensor noise floor (a few mg) whatever the
+ * orientation; a gravity-sized threshold is no longer needed.
+ */
+
+// Scale of the running gravity estimate (LSB << TAMPER_GRAVITY_FRAC)
+#define TAMPER_GRAVITY_FRAC 8
+
+typedef struct {
+    int32_t gravity[3];       // Gravity estimate, LSB << TAMPER_GRAVITY_FRAC
+    int32_t prev_residual[3]; // Previous residual in mg (for jerk)
+    int32_t energy;           // Windowed energy in mg^2
+    uint8_t gravity_shift;    // Gravity IIR coefficient 1/2^shift
+    uint8_t energy_shift;     // Energy window coefficient 1/2^shift
+    uint8_t seeded;           // Gravity estimate initialized from a sample
+    uint8_t hits;             // Debounce counter for tamper_detector_confirm()
+} tamper_detector_t;
+
+/**
+ * @brief Reset the detector
+ * @param sample_rate_hz Rate update() will be called at (sets the time constants)
+ */
+void tamper_detector_init(tamper_detector_t *det, uint32_t sample_rate_hz);
+
+/**
+ * @brief Feed one raw sample
+ * @return Tamper score in mg
+ */
+int32_t tamper_detector_update(tamper_detector_t *det, int16_t x, int16_t y, int16_t z);
+
+/**
+ * @brief Debounce scores: each sample above threshold_mg adds a hit, each
+ *        quiet sample takes one back
+ * @return true when hits reach hit_count (the counter then restarts)
+ */
+bool tamper_detector_confirm(tamper_detector_t *det, int32_t score_mg, int32_t threshold_mg, int hit_count);
+
+// Lowest score threshold: below it ordinary building vibration (door slams,
+// trucks, footsteps) starts to alarm. Matches the calibration floor.
+#define TAMPER_THRESHOLD_MIN_MG 150
+
+/**
+ * @brief Convert a legacy |a| threshold (17000-45000 LSB, gravity included)
+ *        to a score threshold in mg: (threshold - 1g) in mg, at least
+ *        TAMPER_THRESHOLD_MIN_MG (so 17000-18841 all give 150 mg)
+ */
+int32_t tamper_threshold_mg(int32_t legacy_threshold);
+
+#endif // TAMPER_DETECTOR_H
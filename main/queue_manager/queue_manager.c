@@ -1,5 +1,12 @@
 #include "queue_manager.h"
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#if __has_include("../config.h")
+#include "../config.h"
+#endif
 
 static const char *TAG = "QUEUE";
 
@@ -11,6 +18,70 @@ static const char *TAG = "QUEUE";
 #define EVENT_QUEUE_SIZE    10
 #define CMD_QUEUE_SIZE      5
 
+// Queue backend (override in config.h):
+//   QUEUE_BACKEND_FREERTOS - xQueue per link (copy in/out under a critical section)
+//   QUEUE_BACKEND_SPSC     - lock-free single-producer/single-consumer rings;
+//                            every link has exactly one sending and one receiving task
+#define QUEUE_BACKEND_FREERTOS 0
+#define QUEUE_BACKEND_SPSC     1
+#ifndef QUEUE_BACKEND
+#define QUEUE_BACKEND QUEUE_BACKEND_FREERTOS
+#endif
+
+typedef enum {
+    QUEUE_KEY,
+    QUEUE_SENSOR,
+    QUEUE_LED,
+    QUEUE_LCD,
+    QUEUE_EVENT,
+    QUEUE_CMD,
+    QUEUE_COUNT
+} queue_id_t;
+
+// Every queued item is followed by its enqueue time (esp_timer, microseconds)
+// so the receiver can measure how long it waited
+#define QUEUE_SLOT_SIZE(type) (sizeof(type) + sizeof(uint32_t))
+
+#if QUEUE_BACKEND == QUEUE_BACKEND_SPSC
+
+// Receivers block on their own notification slot, leaving slot 0 to
+// queue_manager_wait_for_input() and any other user of plain notifications
+#define QUEUE_NOTIFY_INDEX 1
+#if configTASK_NOTIFICATION_ARRAY_ENTRIES <= QUEUE_NOTIFY_INDEX
+#error "SPSC queues need CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES >= 2"
+#endif
+
+// Producer and consumer indices live on separate cache lines so the two
+// tasks (possibly on different cores) never write the same line
+#define QUEUE_CACHE_LINE 32
+
+typedef struct {
+    _Alignas(QUEUE_CACHE_LINE) atomic_uint head;        // Next write index (producer only)
+    _Alignas(QUEUE_CACHE_LINE) atomic_uint tail;        // Next read index (consumer only)
+    _Alignas(QUEUE_CACHE_LINE) _Atomic(TaskHandle_t) waiter; // Consumer blocked in receive, or NULL
+    uint8_t *storage;
+    uint32_t mask;     // Storage slots - 1 (slots is a power of two)
+} spsc_ring_t;
+
+// Storage slots: queue size rounded up to a power of two (indices are masked,
+// the configured size still limits how many items are queued)
+#define SPSC_SLOTS(n) ((n) <= 2 ? 2 : (n) <= 4 ? 4 : (n) <= 8 ? 8 : (n) <= 16 ? 16 : (n) <= 32 ? 32 : 64)
+
+#define SPSC_RING(name, type, size) \
+    static uint8_t name##_storage[SPSC_SLOTS(size) * QUEUE_SLOT_SIZE(type)] __attribute__((aligned(4))); \
+    static spsc_ring_t name##_ring = { .storage = name##_storage, .mask = SPSC_SLOTS(size) - 1 }
+
+SPSC_RING(key, key_event_t, KEY_QUEUE_SIZE);
+SPSC_RING(sensor, sensor_event_t, SENSOR_QUEUE_SIZE);
+SPSC_RING(led, led_cmd_t, LED_QUEUE_SIZE);
+SPSC_RING(lcd, lcd_cmd_t, LCD_QUEUE_SIZE);
+SPSC_RING(event, event_t, EVENT_QUEUE_SIZE);
+SPSC_RING(cmd, command_t, CMD_QUEUE_SIZE);
+
+#define QUEUE_STORAGE(name) .ring = &name##_ring
+
+#else
+
 // Queue handles
 QueueHandle_t key_queue = NULL;
 QueueHandle_t sensor_queue = NULL;
@@ -19,95 +90,348 @@ QueueHandle_t lcd_queue = NULL;
 QueueHandle_t event_queue = NULL;
 QueueHandle_t cmd_queue = NULL;
 
-// Helper to clean up queues on initialization failure
-static void cleanup_queues(void)
+#define QUEUE_STORAGE(name) .handle = &name##_queue
+
+// Largest slot, for staging an item and its timestamp on the stack
+typedef union {
+    key_event_t key;
+    sensor_event_t sensor;
+    led_cmd_t led;
+    lcd_cmd_t lcd;
+    event_t event;
+    command_t cmd;
+} queue_item_t;
+#define QUEUE_SLOT_MAX QUEUE_SLOT_SIZE(queue_item_t)
+
+#endif
+
+typedef struct {
+    const char *name;
+    size_t item_size;
+    uint32_t length;
+    bool wakes_input_listener;   // Input for control_task (see queue_manager_set_input_listener)
+#if QUEUE_BACKEND == QUEUE_BACKEND_SPSC
+    spsc_ring_t *ring;
+#else
+    QueueHandle_t *handle;
+#endif
+} queue_desc_t;
+
+static const queue_desc_t queues[QUEUE_COUNT] = {
+    [QUEUE_KEY]    = { "Key",     sizeof(key_event_t),    KEY_QUEUE_SIZE,    true,  QUEUE_STORAGE(key) },    // keypad_task -> control_task
+    [QUEUE_SENSOR] = { "Sensor",  sizeof(sensor_event_t), SENSOR_QUEUE_SIZE, true,  QUEUE_STORAGE(sensor) }, // sensor_task -> control_task
+    [QUEUE_LED]    = { "LED",     sizeof(led_cmd_t),      LED_QUEUE_SIZE,    false, QUEUE_STORAGE(led) },    // control_task -> led_task
+    [QUEUE_LCD]    = { "LCD",     sizeof(lcd_cmd_t),      LCD_QUEUE_SIZE,    false, QUEUE_STORAGE(lcd) },    // control_task -> lcd_task
+    [QUEUE_EVENT]  = { "Event",   sizeof(event_t),        EVENT_QUEUE_SIZE,  false, QUEUE_STORAGE(event) },  // control_task -> comm_task
+    [QUEUE_CMD]    = { "Command", sizeof(command_t),      CMD_QUEUE_SIZE,    true,  QUEUE_STORAGE(cmd) },    // comm_task -> control_task
+};
+
+_Static_assert(QUEUE_COUNT == QUEUE_STATS_COUNT, "QUEUE_STATS_COUNT out of date");
+
+// Per-queue counters, updated lock-free by the producer and consumer
+typedef struct {
+    atomic_uint sent;
+    atomic_uint received;
+    atomic_uint dropped;
+    atomic_uint high_water;
+    atomic_uint max_residence_us;
+    atomic_uint residence_hist[QUEUE_STATS_BUCKETS];
+} queue_counters_t;
+
+static queue_counters_t counters[QUEUE_COUNT];
+
+// Task woken whenever key, sensor or command input arrives (control_task)
+static TaskHandle_t input_listener = NULL;
+
+// Wake the input listener after a successful send to one of its queues
+static void notify_input_listener(void)
 {
-    if (key_queue != NULL) { vQueueDelete(key_queue); key_queue = NULL; }
-    if (sensor_queue != NULL) { vQueueDelete(sensor_queue); sensor_queue = NULL; }
-    if (led_queue != NULL) { vQueueDelete(led_queue); led_queue = NULL; }
-    if (lcd_queue != NULL) { vQueueDelete(lcd_queue); lcd_queue = NULL; }
-    if (event_queue != NULL) { vQueueDelete(event_queue); event_queue = NULL; }
-    if (cmd_queue != NULL) { vQueueDelete(cmd_queue); cmd_queue = NULL; }
+    TaskHandle_t listener = input_listener;
+    if (listener != NULL) {
+        xTaskNotifyGive(listener);
+    }
 }
 
-bool queue_manager_init(void)
+static uint32_t now_us(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static void atomic_max(atomic_uint *target, unsigned value)
+{
+    unsigned current = atomic_load_explicit(target, memory_order_relaxed);
+    while (value > current &&
+           !atomic_compare_exchange_weak_explicit(target, &current, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Bucket 0 counts residence times under 1 us, bucket i (i >= 1) times in
+// [2^(i-1), 2^i) us; the last bucket collects everything longer
+static int residence_bucket(uint32_t us)
+{
+    int bucket = (us == 0) ? 0 : 32 - __builtin_clz(us);
+    return (bucket < QUEUE_STATS_BUCKETS) ? bucket : QUEUE_STATS_BUCKETS - 1;
+}
+
+static TickType_t timeout_to_ticks(uint32_t timeout_ms)
 {
-    // Key queue (keypad_task -> control_task)
-    key_queue = xQueueCreate(KEY_QUEUE_SIZE, sizeof(key_event_t));
-    if (key_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create key queue");
-        cleanup_queues();
+    if (timeout_ms == QUEUE_WAIT_FOREVER) {
+        return portMAX_DELAY;
+    }
+    return (timeout_ms == 0) ? 0 : pdMS_TO_TICKS(timeout_ms);
+}
+
+// ============================================================================
+// Backend: SPSC rings
+// ============================================================================
+
+#if QUEUE_BACKEND == QUEUE_BACKEND_SPSC
+
+static bool spsc_push(spsc_ring_t *ring, const void *item, size_t size, uint32_t length, uint32_t stamp)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= length) {
         return false;
     }
-    ESP_LOGI(TAG, "Key queue created (size: %d)", KEY_QUEUE_SIZE);
 
-    // Sensor queue (sensor_task -> control_task)
-    sensor_queue = xQueueCreate(SENSOR_QUEUE_SIZE, sizeof(sensor_event_t));
-    if (sensor_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create sensor queue");
-        cleanup_queues();
+    uint8_t *slot = ring->storage + (head & ring->mask) * (size + sizeof(stamp));
+    memcpy(slot, item, size);
+    memcpy(slot + size, &stamp, sizeof(stamp));
+
+    // Publish the item, then look for a sleeping consumer. Both are
+    // sequentially consistent, pairing with spsc_receive(): either the
+    // consumer sees the item on its re-check or we see it waiting.
+    atomic_store(&ring->head, head + 1);
+    TaskHandle_t waiter = atomic_load(&ring->waiter);
+    if (waiter != NULL) {
+        xTaskNotifyGiveIndexed(waiter, QUEUE_NOTIFY_INDEX);
+    }
+    return true;
+}
+
+static bool spsc_pop(spsc_ring_t *ring, void *item, size_t size, uint32_t *stamp)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load(&ring->head);
+    if (head == tail) {
         return false;
     }
-    ESP_LOGI(TAG, "Sensor queue created (size: %d)", SENSOR_QUEUE_SIZE);
 
-    // LED queue (control_task -> led_task)
-    led_queue = xQueueCreate(LED_QUEUE_SIZE, sizeof(led_cmd_t));
-    if (led_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create LED queue");
-        cleanup_queues();
+    const uint8_t *slot = ring->storage + (tail & ring->mask) * (size + sizeof(*stamp));
+    memcpy(item, slot, size);
+    memcpy(stamp, slot + size, sizeof(*stamp));
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static bool spsc_receive(spsc_ring_t *ring, void *item, size_t size, uint32_t *stamp, TickType_t ticks)
+{
+    if (spsc_pop(ring, item, size, stamp)) {
+        return true;
+    }
+    if (ticks == 0) {
         return false;
     }
-    ESP_LOGI(TAG, "LED queue created (size: %d)", LED_QUEUE_SIZE);
 
-    // LCD queue (control_task -> lcd_task)
-    lcd_queue = xQueueCreate(LCD_QUEUE_SIZE, sizeof(lcd_cmd_t));
-    if (lcd_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create LCD queue");
-        cleanup_queues();
+    TickType_t start = xTaskGetTickCount();
+    while (1) {
+        atomic_store(&ring->waiter, xTaskGetCurrentTaskHandle());
+
+        // Re-check after advertising the waiter so a concurrent push is not missed
+        if (spsc_pop(ring, item, size, stamp)) {
+            atomic_store(&ring->waiter, NULL);
+            return true;
+        }
+
+        TickType_t remaining = portMAX_DELAY;
+        if (ticks != portMAX_DELAY) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= ticks) {
+                atomic_store(&ring->waiter, NULL);
+                return false;
+            }
+            remaining = ticks - elapsed;
+        }
+
+        // A stale notification from an earlier push only causes one extra pass
+        ulTaskNotifyTakeIndexed(QUEUE_NOTIFY_INDEX, pdTRUE, remaining);
+    }
+}
+
+static bool backend_init(void)
+{
+    for (int i = 0; i < QUEUE_COUNT; i++) {
+        ESP_LOGI(TAG, "%s queue created (size: %lu, SPSC ring)", queues[i].name, (unsigned long)queues[i].length);
+    }
+    return true;
+}
+
+static bool backend_send(const queue_desc_t *q, const void *item, uint32_t stamp)
+{
+    return spsc_push(q->ring, item, q->item_size, q->length, stamp);
+}
+
+static bool backend_receive(const queue_desc_t *q, void *item, uint32_t *stamp, TickType_t ticks)
+{
+    return spsc_receive(q->ring, item, q->item_size, stamp, ticks);
+}
+
+// ============================================================================
+// Backend: FreeRTOS queues
+// ============================================================================
+
+#else
+
+// Helper to clean up queues on initialization failure
+static void cleanup_queues(void)
+{
+    for (int i = 0; i < QUEUE_COUNT; i++) {
+        if (*queues[i].handle != NULL) {
+            vQueueDelete(*queues[i].handle);
+            *queues[i].handle = NULL;
+        }
+    }
+}
+
+static bool backend_init(void)
+{
+    for (int i = 0; i < QUEUE_COUNT; i++) {
+        *queues[i].handle = xQueueCreate(queues[i].length, queues[i].item_size + sizeof(uint32_t));
+        if (*queues[i].handle == NULL) {
+            ESP_LOGE(TAG, "Failed to create %s queue", queues[i].name);
+            cleanup_queues();
+            return false;
+        }
+        ESP_LOGI(TAG, "%s queue created (size: %lu)", queues[i].name, (unsigned long)queues[i].length);
+    }
+    return true;
+}
+
+static bool backend_send(const queue_desc_t *q, const void *item, uint32_t stamp)
+{
+    if (*q->handle == NULL) return false;
+    uint8_t slot[QUEUE_SLOT_MAX];
+    memcpy(slot, item, q->item_size);
+    memcpy(slot + q->item_size, &stamp, sizeof(stamp));
+    return xQueueSend(*q->handle, slot, 0) == pdTRUE;
+}
+
+static bool backend_receive(const queue_desc_t *q, void *item, uint32_t *stamp, TickType_t ticks)
+{
+    if (*q->handle == NULL) return false;
+    uint8_t slot[QUEUE_SLOT_MAX];
+    if (xQueueReceive(*q->handle, slot, ticks) != pdTRUE) {
         return false;
     }
-    ESP_LOGI(TAG, "LCD queue created (size: %d)", LCD_QUEUE_SIZE);
+    memcpy(item, slot, q->item_size);
+    memcpy(stamp, slot + q->item_size, sizeof(*stamp));
+    return true;
+}
+
+#endif
 
-    // Event queue (control_task -> comm_task)
-    event_queue = xQueueCreate(EVENT_QUEUE_SIZE, sizeof(event_t));
-    if (event_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create event queue");
-        cleanup_queues();
+// ============================================================================
+// Common send/receive path
+// ============================================================================
+
+static bool queue_send(queue_id_t id, const void *item)
+{
+    const queue_desc_t *q = &queues[id];
+    queue_counters_t *c = &counters[id];
+    if (item == NULL) return false;
+    if (!backend_send(q, item, now_us())) {
+        atomic_fetch_add_explicit(&c->dropped, 1, memory_order_relaxed);
+        ESP_LOGW(TAG, "%s queue full", q->name);
         return false;
     }
-    ESP_LOGI(TAG, "Event queue created (size: %d)", EVENT_QUEUE_SIZE);
 
-    // Command queue (comm_task -> control_task)
-    cmd_queue = xQueueCreate(CMD_QUEUE_SIZE, sizeof(command_t));
-    if (cmd_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create command queue");
-        cleanup_queues();
+    // Depth right after this send (the consumer may already be draining)
+    unsigned sent = atomic_fetch_add_explicit(&c->sent, 1, memory_order_relaxed) + 1;
+    atomic_max(&c->high_water, sent - atomic_load_explicit(&c->received, memory_order_relaxed));
+
+    if (q->wakes_input_listener) {
+        notify_input_listener();
+    }
+    return true;
+}
+
+static bool queue_receive(queue_id_t id, void *item, uint32_t timeout_ms)
+{
+    queue_counters_t *c = &counters[id];
+    uint32_t stamp;
+    if (item == NULL) return false;
+    if (!backend_receive(&queues[id], item, &stamp, timeout_to_ticks(timeout_ms))) {
         return false;
     }
-    ESP_LOGI(TAG, "Command queue created (size: %d)", CMD_QUEUE_SIZE);
 
+    uint32_t residence = now_us() - stamp;
+    atomic_fetch_add_explicit(&c->received, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->residence_hist[residence_bucket(residence)], 1, memory_order_relaxed);
+    atomic_max(&c->max_residence_us, residence);
     return true;
 }
 
+bool queue_manager_init(void)
+{
+    return backend_init();
+}
+
+int queue_manager_get_stats(queue_stats_t *stats, int max_count)
+{
+    if (stats == NULL) return 0;
+    int count = (max_count < QUEUE_COUNT) ? max_count : QUEUE_COUNT;
+
+    // Relaxed snapshot: counters of one queue may be a few operations apart
+    for (int i = 0; i < count; i++) {
+        queue_counters_t *c = &counters[i];
+        queue_stats_t *out = &stats[i];
+        unsigned sent = atomic_load_explicit(&c->sent, memory_order_relaxed);
+        unsigned received = atomic_load_explicit(&c->received, memory_order_relaxed);
+
+        out->name = queues[i].name;
+        out->length = queues[i].length;
+        out->depth = (sent > received) ? sent - received : 0;
+        out->high_water = atomic_load_explicit(&c->high_water, memory_order_relaxed);
+        out->sent = sent;
+        out->dropped = atomic_load_explicit(&c->dropped, memory_order_relaxed);
+        out->max_residence_us = atomic_load_explicit(&c->max_residence_us, memory_order_relaxed);
+        for (int b = 0; b < QUEUE_STATS_BUCKETS; b++) {
+            out->residence_hist[b] = atomic_load_explicit(&c->residence_hist[b], memory_order_relaxed);
+        }
+    }
+    return count;
+}
+
+// ============================================================================
+// Input Dispatch (key, sensor and command queues -> control_task)
+// ============================================================================
+
+void queue_manager_set_input_listener(TaskHandle_t task)
+{
+    input_listener = task;
+}
+
+bool queue_manager_wait_for_input(uint32_t timeout_ms)
+{
+    // Notification count is cleared on wake; the caller drains every input
+    // queue afterwards, so coalesced notifications lose nothing
+    return ulTaskNotifyTake(pdTRUE, timeout_to_ticks(timeout_ms)) > 0;
+}
+
 // ============================================================================
 // Keypad Queue
 // ============================================================================
 
 bool send_key_event(key_event_t *event)
 {
-    if (event == NULL || key_queue == NULL) return false;
-    if (xQueueSend(key_queue, event, 0) != pdTRUE) {
-        ESP_LOGW(TAG, "Key queue full");
-        return false;
-    }
-    return true;
+    return queue_send(QUEUE_KEY, event);
 }
 
 bool receive_key_event(key_event_t *event, uint32_t timeout_ms)
 {
-    if (event == NULL || key_queue == NULL) return false;
-    TickType_t ticks = (timeout_ms == 0) ? 0 : pdMS_TO_TICKS(timeout_ms);
-    return xQueueReceive(key_queue, event, ticks) == pdTRUE;
+    return queue_receive(QUEUE_KEY, event, timeout_ms);
 }
 
 // ============================================================================
@@ -116,19 +440,12 @@ bool receive_key_event(key_event_t *event, uint32_t timeout_ms)
 
 bool send_sensor_event(sensor_event_t *event)
 {
-    if (event == NULL || sensor_queue == NULL) return false;
-    if (xQueueSend(sensor_queue, event, 0) != pdTRUE) {
-        ESP_LOGW(TAG, "Sensor queue full");
-        return false;
-    }
-    return true;
+    return queue_send(QUEUE_SENSOR, event);
 }
 
 bool receive_sensor_event(sensor_event_t *event, uint32_t timeout_ms)
 {
-    if (event == NULL || sensor_queue == NULL) return false;
-    TickType_t ticks = (timeout_ms == 0) ? 0 : pdMS_TO_TICKS(timeout_ms);
-    return xQueueReceive(sensor_queue, event, ticks) == pdTRUE;
+    return queue_receive(QUEUE_SENSOR, event, timeout_ms);
 }
 
 // ============================================================================
@@ -137,19 +454,12 @@ bool receive_sensor_event(sensor_event_t *event, uint32_t timeout_ms)
 
 bool send_led_cmd(led_cmd_t *cmd)
 {
-    if (cmd == NULL || led_queue == NULL) return false;
-    if (xQueueSend(led_queue, cmd, 0) != pdTRUE) {
-        ESP_LOGW(TAG, "LED queue full");
-        return false;
-    }
-    return true;
+    return queue_send(QUEUE_LED, cmd);
 }
 
 bool receive_led_cmd(led_cmd_t *cmd, uint32_t timeout_ms)
 {
-    if (cmd == NULL || led_queue == NULL) return false;
-    TickType_t ticks = (timeout_ms == 0) ? 0 : pdMS_TO_TICKS(timeout_ms);
-    return xQueueReceive(led_queue, cmd, ticks) == pdTRUE;
+    return queue_receive(QUEUE_LED, cmd, timeout_ms);
 }
 
 // ============================================================================
@@ -158,19 +468,12 @@ bool receive_led_cmd(led_cmd_t *cmd, uint32_t timeout_ms)
 
 bool send_lcd_cmd(lcd_cmd_t *cmd)
 {
-    if (cmd == NULL || lcd_queue == NULL) return false;
-    if (xQueueSend(lcd_queue, cmd, 0) != pdTRUE) {
-        ESP_LOGW(TAG, "LCD queue full");
-        return false;
-    }
-    return true;
+    return queue_send(QUEUE_LCD, cmd);
 }
 
 bool receive_lcd_cmd(lcd_cmd_t *cmd, uint32_t timeout_ms)
 {
-    if (cmd == NULL || lcd_queue == NULL) return false;
-    TickType_t ticks = (timeout_ms == 0) ? 0 : pdMS_TO_TICKS(timeout_ms);
-    return xQueueReceive(lcd_queue, cmd, ticks) == pdTRUE;
+    return queue_receive(QUEUE_LCD, cmd, timeout_ms);
 }
 
 // ============================================================================
@@ -179,19 +482,12 @@ bool receive_lcd_cmd(lcd_cmd_t *cmd, uint32_t timeout_ms)
 
 bool send_event(event_t *event)
 {
-    if (event == NULL || event_queue == NULL) return false;
-    if (xQueueSend(event_queue, event, 0) != pdTRUE) {
-        ESP_LOGW(TAG, "Event queue full");
-        return false;
-    }
-    return true;
+    return queue_send(QUEUE_EVENT, event);
 }
 
 bool receive_event(event_t *event, uint32_t timeout_ms)
 {
-    if (event == NULL || event_queue == NULL) return false;
-    TickType_t ticks = (timeout_ms == 0) ? 0 : pdMS_TO_TICKS(timeout_ms);
-    return xQueueReceive(event_queue, event, ticks) == pdTRUE;
+    return queue_receive(QUEUE_EVENT, event, timeout_ms);
 }
 
 // ============================================================================
@@ -200,17 +496,10 @@ bool receive_event(event_t *event, uint32_t timeout_ms)
 
 bool send_command(command_t *cmd)
 {
-    if (cmd == NULL || cmd_queue == NULL) return false;
-    if (xQueueSend(cmd_queue, cmd, 0) != pdTRUE) {
-        ESP_LOGW(TAG, "Command queue full");
-        return false;
-    }
-    return true;
+    return queue_send(QUEUE_CMD, cmd);
 }
 
 bool receive_command(command_t *cmd, uint32_t timeout_ms)
 {
-    if (cmd == NULL || cmd_queue == NULL) return false;
-    TickType_t ticks = (timeout_ms == 0) ? 0 : pdMS_TO_TICKS(timeout_ms);
-    return xQueueReceive(cmd_queue, cmd, ticks) == pdTRUE;
+    return queue_receive(QUEUE_CMD, cmd, timeout_ms);
 }
@@ -3,6 +3,7 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/task.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -23,16 +24,56 @@ typedef enum {
 // Keypad Queue (keypad_task -> control_task)
 // ============================================================================
 
+typedef enum {
+    KEY_EVT_PRESS,
+    KEY_EVT_RELEASE
+} key_event_type_t;
+
+// Key bitmaps: bit row * 4 + col of the layout
+//   '1' '2' '3' 'A'   bits  0- 3
+//   '4' '5' '6' 'B'   bits  4- 7
+//   '7' '8' '9' 'C'   bits  8-11
+//   '*' '0' '#' 'D'   bits 12-15
 typedef struct {
-    char key;  // '0'-'9', '*', '#', 'A'-'D'
+    key_event_type_t type;
+    char key;           // '0'-'9', '*', '#', 'A'-'D'
+    uint16_t keys;      // All keys held after this event
+    uint32_t hold_ms;   // KEY_EVT_RELEASE: time since the press event
+    int64_t time_us;    // esp_timer time the change was debounced
+    int64_t contact_us; // KEY_EVT_PRESS: column interrupt, or the scan before
+                        // the contact was first seen (at most one scan early)
 } key_event_t;
 
+// Timestamps (esp_timer, us) of a key press on its way to the LCD, carried
+// in lcd_cmd_t for keypress-to-glass latency (see input_latency.h)
+typedef struct {
+    int64_t contact_us;     // Key contact (0: command not caused by a key)
+    int64_t debounced_us;   // Press event from the scanner
+    int64_t received_us;    // control_task took it from key_queue
+    int64_t sent_us;        // control_task queued the LCD command
+} input_trace_t;
+
 // ============================================================================
 // Sensor Queue (sensor_task -> control_task)
 // ============================================================================
 
+typedef enum {
+    SENSOR_EVT_MOVEMENT,
+    SENSOR_EVT_CALIBRATED
+} sensor_event_type_t;
+
+// Accelerometer calibration learned at rest (see mpu6050_request_calibration)
+typedef struct {
+    int16_t rest_mg[3];   // Resting acceleration per axis (gravity and mounting offsets)
+    uint16_t noise_mg;    // Mean tamper score at rest
+    uint16_t sigma_mg;    // Standard deviation of the score at rest
+    int32_t threshold;    // Resulting sensitivity (17000-45000)
+} sensor_calibration_t;
+
 typedef struct {
-    float movement_g;  // Movement magnitude in g
+    sensor_event_type_t type;
+    float movement_g;                  // SENSOR_EVT_MOVEMENT: movement magnitude in g
+    sensor_calibration_t calibration;  // SENSOR_EVT_CALIBRATED
 } sensor_event_t;
 
 // ============================================================================
@@ -42,7 +83,8 @@ typedef struct {
 typedef enum {
     LED_CMD_LOCKED,
     LED_CMD_UNLOCKED,
-    LED_CMD_ALARM
+    LED_CMD_ALARM,
+    LED_CMD_ACK         // Keypress acknowledged
 } led_cmd_type_t;
 
 typedef struct {
@@ -67,6 +109,7 @@ typedef struct {
     int pin_length;           // For LCD_CMD_SHOW_PIN_ENTRY
     char message[17];         // For LCD_CMD_SHOW_MESSAGE (max 16 chars + null)
     uint32_t duration_ms;     // For LCD_CMD_SHOW_MESSAGE
+    input_trace_t trace;      // Key press that caused the command, if any
 } lcd_cmd_t;
 
 // ============================================================================
@@ -77,15 +120,24 @@ typedef enum {
     EVT_STATE_CHANGE,
     EVT_MOVEMENT,
     EVT_CODE_RESULT,
-    EVT_CODE_CHANGED
+    EVT_CODE_CHANGED,
+    EVT_CALIBRATION
 } event_type_t;
 
+// Telemetry wire format (selected per device, see json_protocol.h)
+typedef enum {
+    TELEMETRY_FORMAT_JSON,
+    TELEMETRY_FORMAT_CBOR
+} telemetry_format_t;
+
 typedef struct {
     event_type_t type;
     uint32_t timestamp;
     safe_state_t state;
     float movement_amount;
     bool code_ok;
+    sensor_calibration_t calibration;  // EVT_CALIBRATION only
+    uint32_t dropped;      // Telemetry events lost so far (filled in by comm_task)
 } event_t;
 
 // ============================================================================
@@ -97,17 +149,20 @@ typedef enum {
     CMD_UNLOCK,
     CMD_SET_CODE,
     CMD_RESET_ALARM,
-    CMD_SET_SENSITIVITY
+    CMD_SET_SENSITIVITY,
+    CMD_SET_FORMAT,
+    CMD_CALIBRATE
 } command_type_t;
 
 typedef struct {
     command_type_t type;
     char code[MAX_PIN_LENGTH];
-    int32_t sensitivity;  // For CMD_SET_SENSITIVITY (5000-50000)
+    int32_t sensitivity;         // For CMD_SET_SENSITIVITY (5000-50000)
+    telemetry_format_t format;   // For CMD_SET_FORMAT
 } command_t;
 
 // ============================================================================
-// Queue Handles
+// Queue Handles (QUEUE_BACKEND_FREERTOS only)
 // ============================================================================
 
 extern QueueHandle_t key_queue;           // keypad_task -> control_task
@@ -123,6 +178,35 @@ extern QueueHandle_t cmd_queue;           // comm_task -> control_task
 
 bool queue_manager_init(void);
 
+// Timeout for receive_* and queue_manager_wait_for_input: block until input arrives
+#define QUEUE_WAIT_FOREVER UINT32_MAX
+
+// Queue statistics (key, sensor, LED, LCD, event and command queues)
+#define QUEUE_STATS_COUNT   6
+#define QUEUE_STATS_BUCKETS 20
+
+typedef struct {
+    const char *name;
+    uint32_t length;             // Configured capacity
+    uint32_t depth;              // Items queued now
+    uint32_t high_water;         // Most items ever queued at once
+    uint32_t sent;               // Successful sends
+    uint32_t dropped;            // Sends rejected because the queue was full
+    uint32_t max_residence_us;   // Longest time an item waited before receive
+    // Residence time histogram: bucket 0 < 1 us, bucket i in [2^(i-1), 2^i) us,
+    // last bucket everything longer
+    uint32_t residence_hist[QUEUE_STATS_BUCKETS];
+} queue_stats_t;
+
+// Snapshot counters of up to max_count queues; returns the number filled in
+int queue_manager_get_stats(queue_stats_t *stats, int max_count);
+
+// Input dispatch: the listener task is notified on every successful
+// send_key_event/send_sensor_event/send_command, so it can block until
+// input arrives instead of polling the three queues
+void queue_manager_set_input_listener(TaskHandle_t task);
+bool queue_manager_wait_for_input(uint32_t timeout_ms);
+
 // Keypad queue
 bool send_key_event(key_event_t *event);
 bool receive_key_event(key_event_t *event, uint32_t timeout_ms);
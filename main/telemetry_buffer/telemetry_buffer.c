@@ -0,0 +1,415 @@
+#include "telemetry_buffer.h"
+#include <string.h>
+#if __has_include("../config.h")
+#include "../config.h"
+#endif
+
+// Number of buffered events (override in config.h)
+#ifndef TELEMETRY_BUFFER_SIZE
+#define TELEMETRY_BUFFER_SIZE 32
+#endif
+
+_Static_assert(TELEMETRY_BUFFER_SIZE > 0 && TELEMETRY_BUFFER_SIZE <= 4096,
+               "TELEMETRY_BUFFER_SIZE must be 1..4096");
+
+// msg_id index capacity: power of two, at least twice the buffer size so
+// probe sequences stay short (load factor <= 0.5)
+#define INDEX_BITS \
+    (TELEMETRY_BUFFER_SIZE <= 8    ? 4  : \
+     TELEMETRY_BUFFER_SIZE <= 32   ? 6  : \
+     TELEMETRY_BUFFER_SIZE <= 128  ? 8  : \
+     TELEMETRY_BUFFER_SIZE <= 512  ? 10 : \
+     TELEMETRY_BUFFER_SIZE <= 2048 ? 12 : 13)
+#define INDEX_CAPACITY (1 << INDEX_BITS)
+#define INDEX_MASK (INDEX_CAPACITY - 1)
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_READY,
+    SLOT_PENDING
+} slot_state_t;
+
+typedef struct {
+    telemetry_entry_t entry;
+    uint8_t state;       // slot_state_t
+    int msg_id;          // MQTT message ID (shared by a batch), TELEMETRY_MSG_ID_NONE if unassigned
+    uint32_t timestamp;  // Tick count when published (for timeout detection, wrap-safe)
+    int16_t prev;        // Links within the slot's list
+    int16_t next;
+} slot_t;
+
+typedef struct {
+    int16_t head;
+    int16_t tail;
+} list_t;
+
+typedef struct {
+    int msg_id;   // TELEMETRY_MSG_ID_NONE marks an empty bucket
+    int16_t slot; // First pending slot of the message
+} index_entry_t;
+
+static slot_t slots[TELEMETRY_BUFFER_SIZE];
+static list_t ready_list;
+static list_t pending_list;
+static int16_t free_head;
+static int count;
+
+static index_entry_t msg_index[INDEX_CAPACITY];
+
+// Outstanding claim (set by telemetry_buffer_claim)
+static int16_t claim_first = TELEMETRY_SLOT_NONE;
+static int claim_count = 0;
+
+// ============================================================================
+// Intrusive lists
+// ============================================================================
+
+static void list_unlink(list_t *list, int16_t i)
+{
+    slot_t *s = &slots[i];
+    if (s->prev != TELEMETRY_SLOT_NONE) {
+        slots[s->prev].next = s->next;
+    } else {
+        list->head = s->next;
+    }
+    if (s->next != TELEMETRY_SLOT_NONE) {
+        slots[s->next].prev = s->prev;
+    } else {
+        list->tail = s->prev;
+    }
+    s->prev = TELEMETRY_SLOT_NONE;
+    s->next = TELEMETRY_SLOT_NONE;
+}
+
+// Insert i after pos (pos == TELEMETRY_SLOT_NONE inserts at the head)
+static void list_insert_after(list_t *list, int16_t pos, int16_t i)
+{
+    slot_t *s = &slots[i];
+    s->prev = pos;
+    s->next = (pos == TELEMETRY_SLOT_NONE) ? list->head : slots[pos].next;
+    if (s->next != TELEMETRY_SLOT_NONE) {
+        slots[s->next].prev = i;
+    } else {
+        list->tail = i;
+    }
+    if (pos != TELEMETRY_SLOT_NONE) {
+        slots[pos].next = i;
+    } else {
+        list->head = i;
+    }
+}
+
+static void list_append(list_t *list, int16_t i)
+{
+    list_insert_after(list, list->tail, i);
+}
+
+// ============================================================================
+// msg_id index (linear probing, backward-shift deletion)
+// ============================================================================
+
+// Fibonacci hashing: esp-mqtt hands out sequential message IDs, which would
+// otherwise form one long probe cluster and make deletion scan all of it
+static uint32_t index_bucket(int msg_id)
+{
+    return ((uint32_t)msg_id * 2654435769u) >> (32 - INDEX_BITS);
+}
+
+static int index_find(int msg_id)
+{
+    uint32_t i = index_bucket(msg_id);
+    while (msg_index[i].msg_id != TELEMETRY_MSG_ID_NONE) {
+        if (msg_index[i].msg_id == msg_id) {
+            return (int)i;
+        }
+        i = (i + 1) & INDEX_MASK;
+    }
+    return -1;
+}
+
+static void index_put(int msg_id, int16_t slot)
+{
+    uint32_t i = index_bucket(msg_id);
+    // Overwrite a stale entry if the ID was reused (only after 65535 publishes)
+    while (msg_index[i].msg_id != TELEMETRY_MSG_ID_NONE && msg_index[i].msg_id != msg_id) {
+        i = (i + 1) & INDEX_MASK;
+    }
+    msg_index[i].msg_id = msg_id;
+    msg_index[i].slot = slot;
+}
+
+static void index_remove(int msg_id)
+{
+    int found = index_find(msg_id);
+    if (found < 0) {
+        return;
+    }
+
+    // Shift later entries of the probe run back so lookups never hit a hole
+    uint32_t hole = (uint32_t)found;
+    uint32_t j = hole;
+    while (1) {
+        j = (j + 1) & INDEX_MASK;
+        if (msg_index[j].msg_id == TELEMETRY_MSG_ID_NONE) {
+            break;
+        }
+        uint32_t home = index_bucket(msg_index[j].msg_id);
+        // Entry may move if the hole lies between its home bucket and j
+        if (((j - home) & INDEX_MASK) >= ((j - hole) & INDEX_MASK)) {
+            msg_index[hole] = msg_index[j];
+            hole = j;
+        }
+    }
+    msg_index[hole].msg_id = TELEMETRY_MSG_ID_NONE;
+}
+
+// ============================================================================
+// Slot helpers
+// ============================================================================
+
+static void free_slot(int16_t i)
+{
+    slots[i].state = SLOT_FREE;
+    slots[i].msg_id = TELEMETRY_MSG_ID_NONE;
+    slots[i].prev = TELEMETRY_SLOT_NONE;
+    slots[i].next = free_head;
+    free_head = i;
+    count--;
+}
+
+// Remove a pending slot, keeping the index pointing at the rest of its message
+static void unlink_pending(int16_t i)
+{
+    int msg_id = slots[i].msg_id;
+    if (msg_id != TELEMETRY_MSG_ID_NONE) {
+        int found = index_find(msg_id);
+        if (found >= 0 && msg_index[found].slot == i) {
+            int16_t next = slots[i].next;
+            if (next != TELEMETRY_SLOT_NONE && slots[next].msg_id == msg_id) {
+                msg_index[found].slot = next;
+            } else {
+                index_remove(msg_id);
+            }
+        }
+    }
+    list_unlink(&pending_list, i);
+}
+
+// Wrap-safe "a is older than b" for sequence numbers
+static bool seq_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+// Drop the oldest event: the front of whichever list holds the lower seq
+static void evict_oldest(telemetry_entry_t *evicted)
+{
+    int16_t ready = ready_list.head;
+    int16_t pending = pending_list.head;
+    int16_t victim;
+
+    if (ready == TELEMETRY_SLOT_NONE) {
+        victim = pending;
+    } else if (pending == TELEMETRY_SLOT_NONE) {
+        victim = ready;
+    } else {
+        victim = seq_before(slots[pending].entry.seq, slots[ready].entry.seq) ? pending : ready;
+    }
+
+    if (evicted) {
+        *evicted = slots[victim].entry;
+    }
+    if (slots[victim].state == SLOT_PENDING) {
+        unlink_pending(victim);
+    } else {
+        list_unlink(&ready_list, victim);
+    }
+    free_slot(victim);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void telemetry_buffer_init(void)
+{
+    ready_list.head = ready_list.tail = TELEMETRY_SLOT_NONE;
+    pending_list.head = pending_list.tail = TELEMETRY_SLOT_NONE;
+    free_head = TELEMETRY_SLOT_NONE;
+    for (int i = TELEMETRY_BUFFER_SIZE - 1; i >= 0; i--) {
+        slots[i].state = SLOT_FREE;
+        slots[i].msg_id = TELEMETRY_MSG_ID_NONE;
+        slots[i].prev = TELEMETRY_SLOT_NONE;
+        slots[i].next = free_head;
+        free_head = (int16_t)i;
+    }
+    for (int i = 0; i < INDEX_CAPACITY; i++) {
+        msg_index[i].msg_id = TELEMETRY_MSG_ID_NONE;
+    }
+    count = 0;
+    claim_first = TELEMETRY_SLOT_NONE;
+    claim_count = 0;
+}
+
+bool telemetry_buffer_add(const telemetry_entry_t *entry, telemetry_entry_t *evicted)
+{
+    bool was_full = (free_head == TELEMETRY_SLOT_NONE);
+    if (was_full) {
+        evict_oldest(evicted);
+    }
+
+    int16_t i = free_head;
+    free_head = slots[i].next;
+
+    slot_t *s = &slots[i];
+    memcpy(s->entry.payload, entry->payload, entry->payload_len);
+    s->entry.payload_len = entry->payload_len;
+    s->entry.format = entry->format;
+    s->entry.seq = entry->seq;
+    s->entry.spool_ref = entry->spool_ref;
+    s->state = SLOT_READY;
+    s->msg_id = TELEMETRY_MSG_ID_NONE;
+    list_append(&ready_list, i);
+    count++;
+
+    return was_full;
+}
+
+int telemetry_buffer_ready_first(void)
+{
+    return ready_list.head;
+}
+
+int telemetry_buffer_ready_next(int slot)
+{
+    return slots[slot].next;
+}
+
+const telemetry_entry_t* telemetry_buffer_entry(int slot)
+{
+    return &slots[slot].entry;
+}
+
+void telemetry_buffer_for_each(void (*fn)(telemetry_entry_t *entry))
+{
+    // Each list is in seq order; merge the two
+    int16_t ready = ready_list.head;
+    int16_t pending = pending_list.head;
+    while (ready != TELEMETRY_SLOT_NONE || pending != TELEMETRY_SLOT_NONE) {
+        int16_t i;
+        if (pending == TELEMETRY_SLOT_NONE ||
+            (ready != TELEMETRY_SLOT_NONE && seq_before(slots[ready].entry.seq, slots[pending].entry.seq))) {
+            i = ready;
+            ready = slots[i].next;
+        } else {
+            i = pending;
+            pending = slots[i].next;
+        }
+        fn(&slots[i].entry);
+    }
+}
+
+void telemetry_buffer_claim(int n, uint32_t now)
+{
+    claim_first = ready_list.head;
+    claim_count = 0;
+
+    while (claim_count < n && ready_list.head != TELEMETRY_SLOT_NONE) {
+        int16_t i = ready_list.head;
+        list_unlink(&ready_list, i);
+        slots[i].state = SLOT_PENDING;
+        slots[i].msg_id = TELEMETRY_MSG_ID_NONE;
+        slots[i].timestamp = now;
+        list_append(&pending_list, i);
+        claim_count++;
+    }
+}
+
+void telemetry_buffer_publish_done(int msg_id)
+{
+    // Claimed slots are still contiguous: PUBACKs only free slots that have
+    // a msg_id, and eviction/expiry run in the claiming task
+    int16_t i = claim_first;
+    int16_t insert_after = TELEMETRY_SLOT_NONE;
+
+    for (int n = 0; n < claim_count && i != TELEMETRY_SLOT_NONE; n++) {
+        int16_t next = slots[i].next;
+        if (msg_id >= 0) {
+            slots[i].msg_id = msg_id;
+        } else {
+            // Back to the front of the ready list, in original order
+            list_unlink(&pending_list, i);
+            slots[i].state = SLOT_READY;
+            list_insert_after(&ready_list, insert_after, i);
+            insert_after = i;
+        }
+        i = next;
+    }
+
+    if (msg_id >= 0 && claim_count > 0) {
+        index_put(msg_id, claim_first);
+    }
+
+    claim_first = TELEMETRY_SLOT_NONE;
+    claim_count = 0;
+}
+
+int telemetry_buffer_ack(int msg_id, void (*on_delivered)(const telemetry_entry_t *entry))
+{
+    int found = index_find(msg_id);
+    if (found < 0) {
+        return 0;  // Unknown, already expired or evicted
+    }
+
+    int16_t i = msg_index[found].slot;
+    index_remove(msg_id);
+
+    int delivered = 0;
+    while (i != TELEMETRY_SLOT_NONE && slots[i].msg_id == msg_id) {
+        int16_t next = slots[i].next;
+        list_unlink(&pending_list, i);
+        if (on_delivered) {
+            on_delivered(&slots[i].entry);
+        }
+        free_slot(i);
+        delivered++;
+        i = next;
+    }
+    return delivered;
+}
+
+int telemetry_buffer_expire(uint32_t now, uint32_t timeout)
+{
+    // Pending list is in publish order, so only the expired prefix is visited
+    int16_t insert_after = TELEMETRY_SLOT_NONE;
+    int requeued = 0;
+
+    while (pending_list.head != TELEMETRY_SLOT_NONE) {
+        int16_t i = pending_list.head;
+        if ((uint32_t)(now - slots[i].timestamp) < timeout) {
+            break;
+        }
+        unlink_pending(i);
+        slots[i].state = SLOT_READY;
+        slots[i].msg_id = TELEMETRY_MSG_ID_NONE;
+        list_insert_after(&ready_list, insert_after, i);
+        insert_after = i;
+        requeued++;
+    }
+    return requeued;
+}
+
+int telemetry_buffer_count(void)
+{
+    return count;
+}
+
+bool telemetry_buffer_full(void)
+{
+    return free_head == TELEMETRY_SLOT_NONE;
+}
+
+int telemetry_buffer_capacity(void)
+{
+    return TELEMETRY_BUFFER_SIZE;
+}
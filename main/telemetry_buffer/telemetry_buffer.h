@@ -0,0 +1,126 @@
+#ifndef TELEMETRY_BUFFER_H
+#define TELEMETRY_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../queue_manager/queue_manager.h"
+
+/*
+ * Telemetry buffer: serialized events waiting for MQTT delivery.
+ *
+ * Every event is in exactly one list:
+ *   ready   - waiting to be published (oldest first)
+ *   pending - published, waiting for PUBACK (in publish order)
+ *   free    - unused slot
+ *
+ * A small open-addressed index maps msg_id to the first pending slot of the
+ * message, and the events of one message are contiguous in the pending list.
+ * Add, next-to-send, PUBACK and the timeout sweep are O(1) per event.
+ *
+ * Not thread-safe: the caller serializes access (comm_task holds its
+ * event buffer mutex around every call).
+ */
+
+// Serialized telemetry payload: at least EVENT_JSON_MAX_SIZE (168, checked in
+// comm_task.c), and with the spool's record header within a 256-byte page
+#define TELEMETRY_PAYLOAD_SIZE 192
+
+// No slot / no message ID / not in the flash spool
+#define TELEMETRY_SLOT_NONE -1
+#define TELEMETRY_MSG_ID_NONE -1
+#define TELEMETRY_SPOOL_REF_NONE 0xFFFFFFFFu
+
+typedef struct {
+    char payload[TELEMETRY_PAYLOAD_SIZE]; // Serialized once when buffered, reused for every retry
+    uint16_t payload_len;
+    telemetry_format_t format;  // Wire format of payload (selects topic)
+    uint32_t seq;               // Sequence number (tags events inside batches)
+    uint32_t spool_ref;         // Flash spool record, TELEMETRY_SPOOL_REF_NONE if RAM only
+} telemetry_entry_t;
+
+/**
+ * @brief Reset the buffer (all slots free, index empty)
+ */
+void telemetry_buffer_init(void);
+
+/**
+ * @brief Append an event to the ready list, evicting the oldest event if full
+ * @param entry Event to copy (payload_len must be 1..TELEMETRY_PAYLOAD_SIZE)
+ * @param evicted Receives the dropped event, if any (may be NULL)
+ * @return true if the oldest event was evicted to make room
+ */
+bool telemetry_buffer_add(const telemetry_entry_t *entry, telemetry_entry_t *evicted);
+
+/**
+ * @brief First slot of the ready list (next event to send)
+ * @return Slot handle, TELEMETRY_SLOT_NONE if nothing is ready
+ */
+int telemetry_buffer_ready_first(void);
+
+/**
+ * @brief Slot after the given one in the ready list
+ * @return Slot handle, TELEMETRY_SLOT_NONE at the end
+ */
+int telemetry_buffer_ready_next(int slot);
+
+/**
+ * @brief Entry stored in a slot
+ */
+const telemetry_entry_t* telemetry_buffer_entry(int slot);
+
+/**
+ * @brief Visit every buffered event, merging the ready and pending lists by seq
+ * @param fn Called with each entry; may change its spool_ref, nothing else
+ */
+void telemetry_buffer_for_each(void (*fn)(telemetry_entry_t *entry));
+
+/**
+ * @brief Move the first count ready events to the pending list
+ *
+ * Claimed events have no msg_id until telemetry_buffer_publish_done().
+ * Only one claim may be outstanding at a time.
+ *
+ * @param count Number of events (taken from the front of the ready list)
+ * @param now Tick count used for timeout detection
+ */
+void telemetry_buffer_claim(int count, uint32_t now);
+
+/**
+ * @brief Complete the outstanding claim
+ * @param msg_id MQTT message ID on success, negative if the publish failed
+ *               (events return to the front of the ready list)
+ */
+void telemetry_buffer_publish_done(int msg_id);
+
+/**
+ * @brief Free every pending event published under msg_id (PUBACK)
+ * @param on_delivered Called for each delivered event before it is freed (may be NULL)
+ * @return Number of events delivered
+ */
+int telemetry_buffer_ack(int msg_id, void (*on_delivered)(const telemetry_entry_t *entry));
+
+/**
+ * @brief Return pending events older than timeout to the front of the ready list
+ * @param now Current tick count (wrap-safe)
+ * @param timeout Timeout in ticks
+ * @return Number of events requeued
+ */
+int telemetry_buffer_expire(uint32_t now, uint32_t timeout);
+
+/**
+ * @brief Number of buffered (ready + pending) events
+ */
+int telemetry_buffer_count(void);
+
+/**
+ * @brief Whether the next add would evict an event
+ */
+bool telemetry_buffer_full(void);
+
+/**
+ * @brief Buffer capacity (TELEMETRY_BUFFER_SIZE)
+ */
+int telemetry_buffer_capacity(void);
+
+#endif // TELEMETRY_BUFFER_H
@@ -0,0 +1,618 @@
+#include "telemetry_spool.h"
+#include <stddef.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#if __has_include("../config.h")
+#include "../config.h"
+#endif
+
+static const char *TAG = "SPOOL";
+
+// Retention cap: oldest records beyond this are dropped (override in config.h)
+#ifndef TELEMETRY_SPOOL_MAX_EVENTS
+#define TELEMETRY_SPOOL_MAX_EVENTS 500
+#endif
+
+// Staged records are written at the latest after this long
+#ifndef TELEMETRY_SPOOL_FLUSH_MS
+#define TELEMETRY_SPOOL_FLUSH_MS 1000
+#endif
+
+#define SPOOL_PARTITION_LABEL "spool"
+#define SPOOL_SECTOR_SIZE     4096   // Flash erase unit
+#define SPOOL_PAGE_SIZE       256    // Flash program unit
+
+#define SPOOL_SECTOR_MAGIC    0x4C505354u  // "TSPL"
+#define SPOOL_RECORD_MAGIC    0x5E1Du
+#define RECORD_STATE_LIVE     0xFF  // Erased flash value
+#define RECORD_STATE_CONSUMED 0x00  // Cleared in place once delivered
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;          // Increments per sector opened; highest is the write sector
+    uint32_t reserved[2];
+} sector_header_t;
+
+typedef struct {
+    uint16_t magic;        // 0xFFFF if nothing was written here
+    uint16_t len;          // Payload length
+    uint32_t seq;          // Telemetry sequence number
+    uint32_t crc;          // CRC32 over len, seq, format and payload
+    uint8_t format;        // telemetry_format_t
+    uint8_t state;         // RECORD_STATE_LIVE / RECORD_STATE_CONSUMED (not covered by crc)
+    uint16_t reserved;
+} record_header_t;
+
+_Static_assert(sizeof(sector_header_t) == 16, "sector header layout");
+_Static_assert(sizeof(record_header_t) == 16, "record header layout");
+_Static_assert(sizeof(record_header_t) + TELEMETRY_PAYLOAD_SIZE <= SPOOL_PAGE_SIZE, "record must fit a page");
+
+static const esp_partition_t *partition = NULL;
+static uint32_t sector_count = 0;
+
+// Positions are byte offsets into the partition
+static uint32_t write_sector = 0;
+static uint32_t write_sector_seq = 0;
+static uint32_t write_pos = 0;    // Next record goes here (staged or not)
+static uint32_t read_pos = 0;     // Oldest live record, or write_pos if none
+static uint32_t import_pos = 0;   // Next record for read_next (between read_pos and write_pos)
+
+// Page buffer: records staged for one flash write, covering [page_off, page_off + page_len)
+static uint8_t page[SPOOL_PAGE_SIZE];
+static uint32_t page_off = 0;
+static uint32_t page_len = 0;
+static TickType_t page_since = 0;
+
+// The sector after the write sector is reclaimed and erased ahead of time,
+// so opening it takes one header write. Records in a reclaimed sector are
+// no longer part of the log.
+typedef enum {
+    SPARE_NONE,            // Not reclaimed yet
+    SPARE_RECLAIMED,       // Live records dropped, erase pending
+    SPARE_ERASED,          // Ready to open
+} spare_state_t;
+
+static volatile spare_state_t spare_state = SPARE_NONE;
+
+static int live_count = 0;
+static uint32_t dropped = 0;
+static uint32_t next_seq = 0;
+
+// ============================================================================
+// Flash helpers
+// ============================================================================
+
+static uint32_t record_size(uint16_t len)
+{
+    return (sizeof(record_header_t) + len + 3) & ~3u;
+}
+
+static uint32_t sector_start(uint32_t sector)
+{
+    return sector * SPOOL_SECTOR_SIZE + sizeof(sector_header_t);
+}
+
+static uint32_t record_crc(uint16_t len, uint32_t seq, uint8_t format, const void *payload)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&len, sizeof(len));
+    crc = esp_rom_crc32_le(crc, (const uint8_t *)&seq, sizeof(seq));
+    crc = esp_rom_crc32_le(crc, &format, sizeof(format));
+    return esp_rom_crc32_le(crc, payload, len);
+}
+
+// Read from flash, or from the page buffer for records not written yet
+static bool spool_read(uint32_t off, void *dst, size_t len)
+{
+    if (page_len > 0 && off >= page_off && off < page_off + page_len) {
+        memcpy(dst, page + (off - page_off), len);
+        return true;
+    }
+    return esp_partition_read(partition, off, dst, len) == ESP_OK;
+}
+
+static void flush_page(void)
+{
+    if (page_len == 0) {
+        return;
+    }
+    esp_err_t err = esp_partition_write(partition, page_off, page, page_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Flash write failed at 0x%lx: %s", (unsigned long)page_off, esp_err_to_name(err));
+    }
+    page_len = 0;
+}
+
+// True if a plausible record header is at pos
+static bool read_header(uint32_t pos, record_header_t *hdr)
+{
+    uint32_t offset = pos % SPOOL_SECTOR_SIZE;
+    if (offset < sizeof(sector_header_t) || offset + sizeof(record_header_t) > SPOOL_SECTOR_SIZE) {
+        return false;
+    }
+    if (!spool_read(pos, hdr, sizeof(*hdr))) {
+        return false;
+    }
+    return hdr->magic == SPOOL_RECORD_MAGIC &&
+           hdr->len > 0 && hdr->len <= TELEMETRY_PAYLOAD_SIZE &&
+           offset + record_size(hdr->len) <= SPOOL_SECTOR_SIZE;
+}
+
+static void mark_consumed(uint32_t pos)
+{
+    uint32_t state_pos = pos + offsetof(record_header_t, state);
+    if (page_len > 0 && pos >= page_off && pos < page_off + page_len) {
+        page[state_pos - page_off] = RECORD_STATE_CONSUMED;
+        return;
+    }
+    uint8_t consumed = RECORD_STATE_CONSUMED;
+    esp_partition_write(partition, state_pos, &consumed, sizeof(consumed));
+}
+
+// ============================================================================
+// Log traversal
+// ============================================================================
+
+// Move pos to the next record header, hopping over the unused end of a sector
+static uint32_t normalize(uint32_t pos)
+{
+    record_header_t hdr;
+    for (uint32_t hops = 0; hops <= sector_count; hops++) {
+        if (pos == write_pos || read_header(pos, &hdr)) {
+            return pos;
+        }
+        pos = sector_start((pos / SPOOL_SECTOR_SIZE + 1) % sector_count);
+    }
+    return write_pos;
+}
+
+static uint32_t next_record(uint32_t pos, const record_header_t *hdr)
+{
+    return normalize(pos + record_size(hdr->len));
+}
+
+// First live record at or after pos
+static uint32_t skip_consumed(uint32_t pos)
+{
+    record_header_t hdr;
+    pos = normalize(pos);
+    while (pos != write_pos && read_header(pos, &hdr) && hdr.state != RECORD_STATE_LIVE) {
+        pos = next_record(pos, &hdr);
+    }
+    return pos;
+}
+
+// Mark a live record consumed and keep read_pos on the oldest live record
+static void consume_at(uint32_t pos, const record_header_t *hdr)
+{
+    mark_consumed(pos);
+    live_count--;
+    if (pos == read_pos) {
+        read_pos = skip_consumed(next_record(pos, hdr));
+    }
+    if (pos == import_pos) {
+        import_pos = read_pos;
+    }
+}
+
+// True if read_next already returned the record at pos: it lies between
+// read_pos and import_pos and is in RAM, so losing it here loses nothing
+static bool imported(uint32_t pos)
+{
+    uint32_t size = sector_count * SPOOL_SECTOR_SIZE;
+    return (pos + size - read_pos) % size < (import_pos + size - read_pos) % size;
+}
+
+static void drop_oldest(void)
+{
+    record_header_t hdr;
+    if (read_pos == write_pos || !read_header(read_pos, &hdr)) {
+        return;
+    }
+    if (!imported(read_pos)) {
+        dropped++;
+    }
+    consume_at(read_pos, &hdr);
+}
+
+static uint32_t spare_sector(void)
+{
+    return (write_sector + 1) % sector_count;
+}
+
+// Drop the live records in the sector after the write sector (ring full) and
+// move the cursors off it; those not yet imported are lost
+static void reclaim_spare(void)
+{
+    uint32_t next = spare_sector();
+    bool read_in_next = (read_pos != write_pos && read_pos / SPOOL_SECTOR_SIZE == next);
+    bool import_in_next = (import_pos != write_pos && import_pos / SPOOL_SECTOR_SIZE == next);
+
+    int live = 0;
+    int lost = 0;
+    sector_header_t sh;
+    record_header_t hdr;
+    if (esp_partition_read(partition, next * SPOOL_SECTOR_SIZE, &sh, sizeof(sh)) == ESP_OK &&
+        sh.magic == SPOOL_SECTOR_MAGIC) {
+        for (uint32_t pos = sector_start(next); read_header(pos, &hdr); pos += record_size(hdr.len)) {
+            if (hdr.state == RECORD_STATE_LIVE) {
+                live++;
+                lost += !imported(pos);
+            }
+        }
+    }
+    if (live > live_count) {
+        live = live_count;
+    }
+    if (lost > live) {
+        lost = live;
+    }
+    if (live > 0) {
+        ESP_LOGW(TAG, "Spool full, dropping %d oldest event(s), %d not yet in RAM", live, lost);
+        live_count -= live;
+        dropped += lost;
+    }
+
+    // Cursors that pointed into the reclaimed sector move to the next oldest one
+    if (read_in_next) {
+        read_pos = skip_consumed(sector_start((next + 1) % sector_count));
+    }
+    if (import_in_next) {
+        import_pos = read_pos;
+    }
+    spare_state = SPARE_RECLAIMED;
+}
+
+static bool erase_spare(void)
+{
+    uint32_t start = spare_sector() * SPOOL_SECTOR_SIZE;
+    esp_err_t err = esp_partition_erase_range(partition, start, SPOOL_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Sector erase failed at 0x%lx: %s", (unsigned long)start, esp_err_to_name(err));
+        return false;
+    }
+    spare_state = SPARE_ERASED;
+    return true;
+}
+
+// Continue in the sector after the write sector, reclaiming and erasing it
+// here if telemetry_spool_erase_ahead() has not
+static bool open_next_sector(void)
+{
+    flush_page();
+
+    if (spare_state == SPARE_NONE) {
+        reclaim_spare();
+    }
+    if (spare_state != SPARE_ERASED && !erase_spare()) {
+        return false;
+    }
+
+    uint32_t next = spare_sector();
+    uint32_t start = next * SPOOL_SECTOR_SIZE;
+    sector_header_t sh = {
+        .magic = SPOOL_SECTOR_MAGIC,
+        .seq = write_sector_seq + 1,
+        .reserved = { 0xFFFFFFFFu, 0xFFFFFFFFu }
+    };
+    esp_err_t err = esp_partition_write(partition, start, &sh, sizeof(sh));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Sector header write failed at 0x%lx: %s", (unsigned long)start, esp_err_to_name(err));
+        spare_state = SPARE_RECLAIMED;
+        return false;
+    }
+
+    // Cursors sitting at the end of the log follow it into the new sector
+    bool read_at_end = (read_pos == write_pos);
+    bool import_at_end = (import_pos == write_pos);
+    write_sector = next;
+    write_sector_seq = sh.seq;
+    write_pos = sector_start(next);
+    spare_state = SPARE_NONE;
+    if (read_at_end) {
+        read_pos = write_pos;
+    }
+    if (import_at_end) {
+        import_pos = write_pos;
+    }
+    return true;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+bool telemetry_spool_init(void)
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                         SPOOL_PARTITION_LABEL);
+    if (partition == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, offline telemetry kept in RAM only", SPOOL_PARTITION_LABEL);
+        return false;
+    }
+
+    sector_count = partition->size / SPOOL_SECTOR_SIZE;
+    if (sector_count < 2) {
+        ESP_LOGW(TAG, "Spool partition too small (%lu bytes)", (unsigned long)partition->size);
+        partition = NULL;
+        return false;
+    }
+
+    // Find the oldest and newest sectors by their header sequence
+    bool found = false;
+    uint32_t oldest = 0, oldest_seq = 0;
+    for (uint32_t s = 0; s < sector_count; s++) {
+        sector_header_t sh;
+        if (esp_partition_read(partition, s * SPOOL_SECTOR_SIZE, &sh, sizeof(sh)) != ESP_OK ||
+            sh.magic != SPOOL_SECTOR_MAGIC) {
+            continue;
+        }
+        if (!found || sh.seq > write_sector_seq) {
+            write_sector = s;
+            write_sector_seq = sh.seq;
+        }
+        if (!found || sh.seq < oldest_seq) {
+            oldest = s;
+            oldest_seq = sh.seq;
+        }
+        found = true;
+    }
+
+    if (!found) {
+        // Fresh partition: start at sector 0
+        write_sector = sector_count - 1;
+        write_sector_seq = 0;
+        write_pos = read_pos = import_pos = sector_start(write_sector);
+        if (!open_next_sector()) {
+            partition = NULL;
+            return false;
+        }
+        ESP_LOGI(TAG, "Spool formatted (%lu sectors)", (unsigned long)sector_count);
+        return true;
+    }
+
+    // Find the end of the write sector; a torn record (power loss) ends it early
+    uint8_t payload[TELEMETRY_PAYLOAD_SIZE];
+    record_header_t hdr;
+    bool torn = false;
+    uint32_t pos = sector_start(write_sector);
+    while (read_header(pos, &hdr)) {
+        esp_partition_read(partition, pos + sizeof(hdr), payload, hdr.len);
+        if (record_crc(hdr.len, hdr.seq, hdr.format, payload) != hdr.crc) {
+            torn = true;
+            break;
+        }
+        pos += record_size(hdr.len);
+    }
+    if (!torn && pos % SPOOL_SECTOR_SIZE + sizeof(hdr) <= SPOOL_SECTOR_SIZE) {
+        // Anything but erased flash after the last record is a torn header
+        esp_partition_read(partition, pos, &hdr, sizeof(hdr));
+        const uint8_t *raw = (const uint8_t *)&hdr;
+        for (size_t i = 0; i < sizeof(hdr); i++) {
+            if (raw[i] != 0xFF) {
+                torn = true;
+                break;
+            }
+        }
+    }
+    write_pos = pos;
+
+    // Walk from the oldest sector: count live records and find the first one
+    bool have_seq = false;
+    read_pos = write_pos;
+    for (pos = normalize(sector_start(oldest)); pos != write_pos; pos = next_record(pos, &hdr)) {
+        read_header(pos, &hdr);
+        esp_partition_read(partition, pos + sizeof(hdr), payload, hdr.len);
+        if (record_crc(hdr.len, hdr.seq, hdr.format, payload) != hdr.crc) {
+            // Torn by an earlier power loss: never delivered, never counted
+            if (hdr.state == RECORD_STATE_LIVE) {
+                mark_consumed(pos);
+            }
+            continue;
+        }
+        if (!have_seq || (int32_t)(hdr.seq - next_seq) >= 0) {
+            next_seq = hdr.seq + 1;
+            have_seq = true;
+        }
+        if (hdr.state == RECORD_STATE_LIVE) {
+            if (live_count == 0) {
+                read_pos = pos;
+            }
+            live_count++;
+        }
+    }
+    import_pos = read_pos;
+
+    // Never append after a torn record: continue in a fresh sector. A torn
+    // record with a readable header is marked consumed, like any other
+    // record cut by power loss, so it is not read and counted as corrupt.
+    if (torn) {
+        ESP_LOGW(TAG, "Torn record at 0x%lx, skipping to next sector", (unsigned long)write_pos);
+        if (read_header(write_pos, &hdr) && hdr.state == RECORD_STATE_LIVE) {
+            mark_consumed(write_pos);
+        }
+        if (!open_next_sector()) {
+            partition = NULL;
+            return false;
+        }
+    }
+
+    ESP_LOGI(TAG, "Spool mounted: %d undelivered event(s), next seq %lu",
+             live_count, (unsigned long)next_seq);
+    return true;
+}
+
+bool telemetry_spool_available(void)
+{
+    return partition != NULL;
+}
+
+// Stage a record at the end of the log; returns its position, or
+// TELEMETRY_SPOOL_REF_NONE if it could not be stored
+static uint32_t append_record(const telemetry_entry_t *entry)
+{
+    if (partition == NULL || entry->payload_len == 0 || entry->payload_len > TELEMETRY_PAYLOAD_SIZE) {
+        return TELEMETRY_SPOOL_REF_NONE;
+    }
+
+    uint32_t size = record_size(entry->payload_len);
+
+    // Records never straddle sectors; the last bytes of a sector stay unused
+    if (write_pos % SPOOL_SECTOR_SIZE + size >= SPOOL_SECTOR_SIZE) {
+        if (!open_next_sector()) {
+            return TELEMETRY_SPOOL_REF_NONE;
+        }
+    }
+
+    // One flash write per program page: flush when the record would cross it
+    if (page_len > 0 &&
+        (page_len + size > SPOOL_PAGE_SIZE || page_off % SPOOL_PAGE_SIZE + page_len + size > SPOOL_PAGE_SIZE)) {
+        flush_page();
+    }
+    if (page_len == 0) {
+        page_off = write_pos;
+        page_since = xTaskGetTickCount();
+    }
+
+    record_header_t hdr = {
+        .magic = SPOOL_RECORD_MAGIC,
+        .len = entry->payload_len,
+        .seq = entry->seq,
+        .crc = record_crc(entry->payload_len, entry->seq, (uint8_t)entry->format, entry->payload),
+        .format = (uint8_t)entry->format,
+        .state = RECORD_STATE_LIVE,
+        .reserved = 0xFFFF
+    };
+    uint8_t *out = page + page_len;
+    memcpy(out, &hdr, sizeof(hdr));
+    memcpy(out + sizeof(hdr), entry->payload, entry->payload_len);
+    memset(out + sizeof(hdr) + entry->payload_len, 0xFF, size - sizeof(hdr) - entry->payload_len);
+    page_len += size;
+
+    // Cursors sitting at the end of the log now point at this record
+    uint32_t pos = write_pos;
+    write_pos += size;
+    live_count++;
+    if ((int32_t)(entry->seq - next_seq) >= 0) {
+        next_seq = entry->seq + 1;
+    }
+
+    while (live_count > TELEMETRY_SPOOL_MAX_EVENTS) {
+        drop_oldest();
+    }
+    return pos;
+}
+
+bool telemetry_spool_append(const telemetry_entry_t *entry)
+{
+    return append_record(entry) != TELEMETRY_SPOOL_REF_NONE;
+}
+
+bool telemetry_spool_append_imported(const telemetry_entry_t *entry, uint32_t *spool_ref)
+{
+    // Behind unread records the copy would be imported a second time
+    if (telemetry_spool_has_unread()) {
+        return false;
+    }
+    uint32_t pos = append_record(entry);
+    if (pos == TELEMETRY_SPOOL_REF_NONE) {
+        return false;
+    }
+    import_pos = write_pos;
+    *spool_ref = pos;
+    return true;
+}
+
+bool telemetry_spool_has_unread(void)
+{
+    return partition != NULL && skip_consumed(import_pos) != write_pos;
+}
+
+bool telemetry_spool_read_next(telemetry_entry_t *entry)
+{
+    if (partition == NULL) {
+        return false;
+    }
+
+    record_header_t hdr;
+    while (1) {
+        uint32_t pos = skip_consumed(import_pos);
+        import_pos = pos;
+        if (pos == write_pos || !read_header(pos, &hdr)) {
+            return false;
+        }
+
+        spool_read(pos + sizeof(hdr), entry->payload, hdr.len);
+        import_pos = next_record(pos, &hdr);
+
+        if (record_crc(hdr.len, hdr.seq, hdr.format, entry->payload) != hdr.crc) {
+            ESP_LOGW(TAG, "Dropping corrupt record (seq=%lu)", (unsigned long)hdr.seq);
+            consume_at(pos, &hdr);
+            dropped++;
+            continue;
+        }
+
+        entry->payload_len = hdr.len;
+        entry->format = (telemetry_format_t)hdr.format;
+        entry->seq = hdr.seq;
+        entry->spool_ref = pos;
+        return true;
+    }
+}
+
+void telemetry_spool_consume(uint32_t spool_ref, uint32_t seq)
+{
+    record_header_t hdr;
+    // The sector may have been reclaimed since the record was read, and may
+    // be being erased by telemetry_spool_erase_ahead() right now
+    if (partition == NULL ||
+        (spare_state != SPARE_NONE && spool_ref / SPOOL_SECTOR_SIZE == spare_sector()) ||
+        !read_header(spool_ref, &hdr) ||
+        hdr.seq != seq || hdr.state != RECORD_STATE_LIVE) {
+        return;
+    }
+    consume_at(spool_ref, &hdr);
+}
+
+bool telemetry_spool_reclaim(void)
+{
+    if (partition == NULL) {
+        return false;
+    }
+    if (spare_state == SPARE_NONE) {
+        reclaim_spare();
+    }
+    return spare_state == SPARE_RECLAIMED;
+}
+
+void telemetry_spool_erase_ahead(void)
+{
+    if (partition != NULL && spare_state == SPARE_RECLAIMED) {
+        erase_spare();
+    }
+}
+
+void telemetry_spool_sync(void)
+{
+    if (page_len > 0 && (xTaskGetTickCount() - page_since) >= pdMS_TO_TICKS(TELEMETRY_SPOOL_FLUSH_MS)) {
+        flush_page();
+    }
+}
+
+uint32_t telemetry_spool_next_seq(void)
+{
+    return next_seq;
+}
+
+int telemetry_spool_count(void)
+{
+    return live_count;
+}
+
+uint32_t telemetry_spool_dropped(void)
+{
+    return dropped;
+}
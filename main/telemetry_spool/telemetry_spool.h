@@ -0,0 +1,112 @@
+#ifndef TELEMETRY_SPOOL_H
+#define TELEMETRY_SPOOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../telemetry_buffer/telemetry_buffer.h"
+
+/*
+ * Telemetry spool: persistent log of undelivered events in the "spool"
+ * flash partition (see partitions.csv).
+ *
+ * The partition is a ring of 4 KB sectors written append-only, so erases
+ * rotate over the whole partition (wear levelling). Each record carries a
+ * CRC32; a record torn by power loss is ignored on the next boot. Records
+ * are staged in a 256-byte page buffer and written with one flash write per
+ * page (or after TELEMETRY_SPOOL_FLUSH_MS). Delivered records are marked
+ * consumed in place by clearing their state byte.
+ *
+ * The sector after the write sector is erased ahead of time
+ * (telemetry_spool_reclaim, then telemetry_spool_erase_ahead), so appends
+ * do not wait for a 4 KB erase.
+ *
+ * When the ring or the retention cap (TELEMETRY_SPOOL_MAX_EVENTS) is full
+ * the oldest records are dropped and counted.
+ *
+ * Not thread-safe: the caller serializes access (comm_task holds its
+ * event buffer mutex around every call but telemetry_spool_erase_ahead).
+ */
+
+/**
+ * @brief Mount the spool partition (scans for the oldest live record)
+ * @return true if the spool is usable, false if the partition is missing
+ */
+bool telemetry_spool_init(void);
+
+/**
+ * @brief Whether telemetry_spool_init() found a usable partition
+ */
+bool telemetry_spool_available(void);
+
+/**
+ * @brief Append an event (staged in the page buffer)
+ * @param entry Event to store (payload, format, seq)
+ * @return true on success
+ */
+bool telemetry_spool_append(const telemetry_entry_t *entry);
+
+/**
+ * @brief Append an event that is already in RAM, so it survives a reboot.
+ *        The record counts as imported: read_next never returns it.
+ * @param entry Event to store (payload, format, seq)
+ * @param spool_ref Receives the record's reference for consume
+ * @return true on success; false if the spool is unavailable or full, or if
+ *         unread records are waiting (the copy would be imported again)
+ */
+bool telemetry_spool_append_imported(const telemetry_entry_t *entry, uint32_t *spool_ref);
+
+/**
+ * @brief Whether records remain that have not been handed out by read_next
+ */
+bool telemetry_spool_has_unread(void);
+
+/**
+ * @brief Read the next unread live record, oldest first
+ * @param entry Filled with the record; spool_ref identifies it for consume
+ * @return true if a record was read
+ */
+bool telemetry_spool_read_next(telemetry_entry_t *entry);
+
+/**
+ * @brief Mark a record delivered
+ * @param spool_ref Reference from telemetry_spool_read_next()
+ * @param seq Sequence number of the record (guards against reused space)
+ */
+void telemetry_spool_consume(uint32_t spool_ref, uint32_t seq);
+
+/**
+ * @brief Drop what is left in the sector after the write sector (ring full)
+ *        so telemetry_spool_erase_ahead() can erase it
+ * @return true if an erase is pending
+ */
+bool telemetry_spool_reclaim(void);
+
+/**
+ * @brief Erase the sector freed by telemetry_spool_reclaim(). May run without
+ *        the caller's lock: telemetry_spool_consume() ignores that sector. Must
+ *        not run alongside the other calls that write (append, read_next, sync).
+ */
+void telemetry_spool_erase_ahead(void);
+
+/**
+ * @brief Write the page buffer if it has been staged for TELEMETRY_SPOOL_FLUSH_MS
+ */
+void telemetry_spool_sync(void);
+
+/**
+ * @brief Sequence number to continue from (one past the newest record ever spooled)
+ */
+uint32_t telemetry_spool_next_seq(void);
+
+/**
+ * @brief Number of live (undelivered) records
+ */
+int telemetry_spool_count(void);
+
+/**
+ * @brief Number of records lost since boot before reaching RAM (ring full,
+ *        retention cap, bad CRC)
+ */
+uint32_t telemetry_spool_dropped(void);
+
+#endif // TELEMETRY_SPOOL_H
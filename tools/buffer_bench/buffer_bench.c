@@ -0,0 +1,400 @@
+// Check the device's telemetry_buffer against a linear reference model and
+// time both, on a PC.
+//
+// The reference keeps the ready and pending lists as plain arrays and does
+// every operation by scanning and shifting them: obviously right, and
+// O(buffer size) per event. The same seeded stream of adds (evicting when
+// full), claims, successful and failed publishes, out-of-order and stale
+// PUBACKs and timeout sweeps, in phases with the broker up and down, is
+// applied to both; every return value, evicted and delivered event, and the
+// whole ready list must agree after each operation.
+//
+// The buffer size is fixed at compile time (TELEMETRY_BUFFER_SIZE), so each
+// size is its own binary. -DCONFIG_H skips the contents of config.h, if
+// there is one, so the size given here applies.
+//
+// Build (from this directory):
+//
+//   for n in 10 100 1000; do gcc -O2 -Wall -DCONFIG_H -DTELEMETRY_BUFFER_SIZE=$n -I../common -I../host_include -I../../main/telemetry_buffer -o buffer_bench_$n buffer_bench.c ../../main/telemetry_buffer/telemetry_buffer.c; done
+//
+// Usage:
+//
+//   ./buffer_bench_<n> [-s seed] [-n ops]
+//
+//   -s  Random seed (default 1; same seed, same operations)
+//   -n  Random operations to compare (default 200000)
+//
+// Prints the operation mix and the first disagreement, if any (exit status
+// 1), then the cost per event of add + claim + publish + PUBACK with the
+// buffer kept one short of full, for the module and the reference.
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "telemetry_buffer.h"
+
+#ifndef TELEMETRY_BUFFER_SIZE
+#define TELEMETRY_BUFFER_SIZE 32
+#endif
+
+#define CAPACITY TELEMETRY_BUFFER_SIZE
+#define TIMEOUT_TICKS 64
+#define OFFLINE_PHASE_OPS (4 * CAPACITY + 100)   // Long enough to fill the buffer
+#define BENCH_EVENTS 2000000
+#define BENCH_PAYLOAD 60        // About a movement event in JSON
+
+// ============================================================================
+// Reference model
+// ============================================================================
+
+typedef struct {
+    telemetry_entry_t entry;
+    int msg_id;
+    uint32_t timestamp;
+} ref_event_t;
+
+static ref_event_t ref_ready[CAPACITY];
+static ref_event_t ref_pending[CAPACITY];
+static int ref_ready_n;
+static int ref_pending_n;
+static int ref_claim_n;
+
+static void ref_remove(ref_event_t *list, int *n, int i)
+{
+    memmove(&list[i], &list[i + 1], (*n - i - 1) * sizeof(list[0]));
+    (*n)--;
+}
+
+static void ref_insert(ref_event_t *list, int *n, int i, const ref_event_t *e)
+{
+    memmove(&list[i + 1], &list[i], (*n - i) * sizeof(list[0]));
+    list[i] = *e;
+    (*n)++;
+}
+
+static void ref_init(void)
+{
+    ref_ready_n = ref_pending_n = ref_claim_n = 0;
+}
+
+static bool ref_add(const telemetry_entry_t *entry, telemetry_entry_t *evicted)
+{
+    bool was_full = (ref_ready_n + ref_pending_n == CAPACITY);
+    if (was_full) {
+        // Oldest by seq of the two list fronts
+        bool pending = ref_pending_n > 0 &&
+            (ref_ready_n == 0 || (int32_t)(ref_pending[0].entry.seq - ref_ready[0].entry.seq) < 0);
+        if (evicted) {
+            *evicted = pending ? ref_pending[0].entry : ref_ready[0].entry;
+        }
+        if (pending) {
+            ref_remove(ref_pending, &ref_pending_n, 0);
+        } else {
+            ref_remove(ref_ready, &ref_ready_n, 0);
+        }
+    }
+    ref_event_t e = { .entry = *entry, .msg_id = TELEMETRY_MSG_ID_NONE };
+    ref_insert(ref_ready, &ref_ready_n, ref_ready_n, &e);
+    return was_full;
+}
+
+static void ref_claim(int n, uint32_t now)
+{
+    ref_claim_n = 0;
+    while (ref_claim_n < n && ref_ready_n > 0) {
+        ref_event_t e = ref_ready[0];
+        ref_remove(ref_ready, &ref_ready_n, 0);
+        e.msg_id = TELEMETRY_MSG_ID_NONE;
+        e.timestamp = now;
+        ref_insert(ref_pending, &ref_pending_n, ref_pending_n, &e);
+        ref_claim_n++;
+    }
+}
+
+static void ref_publish_done(int msg_id)
+{
+    // The claim is the tail of the pending list
+    int first = ref_pending_n - ref_claim_n;
+    for (int i = 0; i < ref_claim_n; i++) {
+        if (msg_id >= 0) {
+            ref_pending[first + i].msg_id = msg_id;
+        } else {
+            ref_event_t e = ref_pending[first];
+            ref_remove(ref_pending, &ref_pending_n, first);
+            ref_insert(ref_ready, &ref_ready_n, i, &e);
+        }
+    }
+    ref_claim_n = 0;
+}
+
+static int ref_ack(int msg_id, void (*on_delivered)(const telemetry_entry_t *entry))
+{
+    int delivered = 0;
+    for (int i = 0; i < ref_pending_n; ) {
+        if (ref_pending[i].msg_id == msg_id) {
+            if (on_delivered) {
+                on_delivered(&ref_pending[i].entry);
+            }
+            ref_remove(ref_pending, &ref_pending_n, i);
+            delivered++;
+        } else {
+            i++;
+        }
+    }
+    return delivered;
+}
+
+static int ref_expire(uint32_t now, uint32_t timeout)
+{
+    int requeued = 0;
+    for (int i = 0; i < ref_pending_n; ) {
+        if ((uint32_t)(now - ref_pending[i].timestamp) >= timeout) {
+            ref_event_t e = ref_pending[i];
+            e.msg_id = TELEMETRY_MSG_ID_NONE;
+            ref_remove(ref_pending, &ref_pending_n, i);
+            ref_insert(ref_ready, &ref_ready_n, requeued++, &e);
+        } else {
+            i++;
+        }
+    }
+    return requeued;
+}
+
+// ============================================================================
+// Comparison
+// ============================================================================
+
+static void make_entry(telemetry_entry_t *entry, uint32_t seq, uint16_t len)
+{
+    entry->payload_len = len;
+    entry->format = (seq % 3 == 0) ? TELEMETRY_FORMAT_CBOR : TELEMETRY_FORMAT_JSON;
+    entry->seq = seq;
+    entry->spool_ref = (seq % 5 == 0) ? seq * 7 : TELEMETRY_SPOOL_REF_NONE;
+    for (int i = 0; i < len; i++) {
+        entry->payload[i] = (char)(seq * 31 + i);
+    }
+}
+
+static bool same_entry(const telemetry_entry_t *a, const telemetry_entry_t *b)
+{
+    return a->payload_len == b->payload_len && a->format == b->format && a->seq == b->seq &&
+           a->spool_ref == b->spool_ref && memcmp(a->payload, b->payload, a->payload_len) == 0;
+}
+
+// Events handed to on_delivered, in order
+static uint32_t delivered_seq[2][CAPACITY];
+static int delivered_n[2];
+
+static void on_delivered_module(const telemetry_entry_t *entry)
+{
+    delivered_seq[0][delivered_n[0]++] = entry->seq;
+}
+
+static void on_delivered_ref(const telemetry_entry_t *entry)
+{
+    delivered_seq[1][delivered_n[1]++] = entry->seq;
+}
+
+static bool same_ready_list(void)
+{
+    int slot = telemetry_buffer_ready_first();
+    for (int i = 0; i < ref_ready_n; i++) {
+        if (slot == TELEMETRY_SLOT_NONE || !same_entry(telemetry_buffer_entry(slot), &ref_ready[i].entry)) {
+            return false;
+        }
+        slot = telemetry_buffer_ready_next(slot);
+    }
+    return slot == TELEMETRY_SLOT_NONE;
+}
+
+enum { OP_ADD, OP_PUBLISH, OP_PUBLISH_FAIL, OP_ACK, OP_EXPIRE, OP_COUNT };
+
+static const char *const op_names[OP_COUNT] = { "add", "publish", "failed publish", "ack", "expire" };
+
+static int compare(int ops)
+{
+    int op_count[OP_COUNT] = { 0 };
+    long evictions = 0;
+    long acked = 0;
+    long requeued = 0;
+    uint32_t seq = 0;
+    uint32_t now = 0;
+    int next_msg_id = 1;
+
+    telemetry_buffer_init();
+    ref_init();
+
+    for (int n = 0; n < ops; n++) {
+        int op;
+        uint32_t r = rng() % 100;
+        // Mostly adds and publishes, so the buffer fills and empties in turn
+        if (r < 35) {
+            op = OP_ADD;
+        } else if (r < 60) {
+            op = OP_PUBLISH;
+        } else if (r < 65) {
+            op = OP_PUBLISH_FAIL;
+        } else if (r < 90) {
+            op = OP_ACK;
+        } else {
+            op = OP_EXPIRE;
+        }
+        // Every other phase the broker is unreachable, so the buffer fills
+        if (op == OP_PUBLISH && (n / OFFLINE_PHASE_OPS) % 2 == 1) {
+            op = OP_PUBLISH_FAIL;
+        }
+        op_count[op]++;
+        now += rng() % 3;
+
+        bool agree = true;
+        switch (op) {
+            case OP_ADD: {
+                telemetry_entry_t entry;
+                telemetry_entry_t evicted[2];
+                make_entry(&entry, seq++, (uint16_t)(1 + rng() % TELEMETRY_PAYLOAD_SIZE));
+                bool a = telemetry_buffer_add(&entry, &evicted[0]);
+                bool b = ref_add(&entry, &evicted[1]);
+                agree = (a == b) && (!a || same_entry(&evicted[0], &evicted[1]));
+                evictions += a;
+                break;
+            }
+            case OP_PUBLISH:
+            case OP_PUBLISH_FAIL: {
+                int count = 1 + rng() % 8;
+                int msg_id = (op == OP_PUBLISH) ? next_msg_id : -1;
+                telemetry_buffer_claim(count, now);
+                ref_claim(count, now);
+                telemetry_buffer_publish_done(msg_id);
+                ref_publish_done(msg_id);
+                if (op == OP_PUBLISH) {
+                    // esp-mqtt message IDs: 1..65535, then around again
+                    next_msg_id = next_msg_id % 65535 + 1;
+                }
+                break;
+            }
+            case OP_ACK: {
+                // Recent IDs, out of order; some already acked, expired or evicted
+                int back = 1 + rng() % 12;
+                int msg_id = ((next_msg_id - 1 - back) % 65535 + 65535) % 65535 + 1;
+                delivered_n[0] = delivered_n[1] = 0;
+                int a = telemetry_buffer_ack(msg_id, on_delivered_module);
+                int b = ref_ack(msg_id, on_delivered_ref);
+                agree = (a == b) && delivered_n[0] == delivered_n[1] &&
+                        memcmp(delivered_seq[0], delivered_seq[1], delivered_n[0] * sizeof(uint32_t)) == 0;
+                acked += a;
+                break;
+            }
+            default: {
+                int a = telemetry_buffer_expire(now, TIMEOUT_TICKS);
+                int b = ref_expire(now, TIMEOUT_TICKS);
+                agree = (a == b);
+                requeued += a;
+                break;
+            }
+        }
+
+        agree = agree && telemetry_buffer_count() == ref_ready_n + ref_pending_n &&
+                telemetry_buffer_full() == (ref_ready_n + ref_pending_n == CAPACITY) &&
+                same_ready_list();
+        if (!agree) {
+            printf("DISAGREE at operation %d (%s): count %d, reference %d ready + %d pending\n",
+                   n, op_names[op], telemetry_buffer_count(), ref_ready_n, ref_pending_n);
+            return 1;
+        }
+    }
+
+    printf("%d operations agree:", ops);
+    for (int op = 0; op < OP_COUNT; op++) {
+        printf(" %d %s%s", op_count[op], op_names[op], op + 1 < OP_COUNT ? "," : "\n");
+    }
+    printf("  %ld evictions, %ld events acked, %ld requeued by timeout\n", evictions, acked, requeued);
+    return 0;
+}
+
+// ============================================================================
+// Cost per event
+// ============================================================================
+
+typedef struct {
+    const char *name;
+    void (*init)(void);
+    bool (*add)(const telemetry_entry_t *entry, telemetry_entry_t *evicted);
+    void (*claim)(int count, uint32_t now);
+    void (*publish_done)(int msg_id);
+    int (*ack)(int msg_id, void (*on_delivered)(const telemetry_entry_t *entry));
+} buffer_ops_t;
+
+static const buffer_ops_t module_ops = {
+    "telemetry_buffer", telemetry_buffer_init, telemetry_buffer_add, telemetry_buffer_claim,
+    telemetry_buffer_publish_done, telemetry_buffer_ack,
+};
+
+static const buffer_ops_t ref_ops = {
+    "reference", ref_init, ref_add, ref_claim, ref_publish_done, ref_ack,
+};
+
+// CAPACITY - 1 events stay pending, one message each; every event is added,
+// published and acked in turn, the oldest PUBACK arriving each time
+static void bench(const buffer_ops_t *ops)
+{
+    telemetry_entry_t entry;
+    make_entry(&entry, 0, BENCH_PAYLOAD);
+    int backlog = CAPACITY - 1;
+    long delivered = 0;
+
+    ops->init();
+    for (int i = 0; i < backlog; i++) {
+        entry.seq = (uint32_t)i;
+        ops->add(&entry, NULL);
+        ops->claim(1, 0);
+        ops->publish_done(1 + i % 65535);
+    }
+
+    double t0 = now_ns();
+    uint64_t c0 = cycles();
+    for (long i = backlog; i < backlog + BENCH_EVENTS; i++) {
+        entry.seq = (uint32_t)i;
+        ops->add(&entry, NULL);
+        ops->claim(1, 0);
+        ops->publish_done(1 + i % 65535);
+        delivered += ops->ack(1 + (i - backlog) % 65535, NULL);
+    }
+    uint64_t c1 = cycles();
+    double t1 = now_ns();
+
+    printf("  %-16s %7.1f ns/event", ops->name, (t1 - t0) / BENCH_EVENTS);
+    if (c1 != c0) {
+        printf(", %6.0f host cycles/event", (double)(c1 - c0) / BENCH_EVENTS);
+    }
+    printf(" (%ld delivered while timing)\n", delivered);
+}
+
+int main(int argc, char **argv)
+{
+    bench_args_t args = { .seed = 1, .count = 200000 };
+
+    for (int i = 1; i < argc; i++) {
+        if (!bench_arg(argc, argv, &i, "sn", &args)) {
+            return bench_usage(argv[0], "[-s seed] [-n ops]");
+        }
+    }
+    if (telemetry_buffer_capacity() != CAPACITY) {
+        fprintf(stderr, "buffer built with %d entries, this tool with %d: build both with the same -DTELEMETRY_BUFFER_SIZE\n",
+                telemetry_buffer_capacity(), CAPACITY);
+        return 2;
+    }
+
+    printf("TELEMETRY_BUFFER_SIZE %d\n", CAPACITY);
+    rng_seed(args.seed);
+    int failed = compare(args.count);
+
+    printf("cost (add + claim + publish + PUBACK, %d events pending):\n", CAPACITY - 1);
+    bench(&module_ops);
+    bench(&ref_ops);
+
+    return failed;
+}
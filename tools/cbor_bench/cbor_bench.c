@@ -0,0 +1,480 @@
+// Round-trip the device's CBOR telemetry on a PC and compare it with JSON.
+//
+// Encodes a seeded set of events of every event type with event_to_cbor(),
+// decodes each one back to an event_t with the minimal decoder below (what a
+// dashboard has to do) and requires the original back: every field the event
+// type carries, with movement_amount bit for bit, and exactly the keys of
+// json_protocol.h - dropped (6) only when non-zero, rest/noise_mg/sigma_mg/
+// threshold (7-10) only on calibration events. The same events then go
+// through telemetry_batch_add() in batches of TELEMETRY_BATCH_MAX_BYTES and
+// come back with their seq (5).
+//
+// Build (from this directory):
+//
+//   gcc -O2 -Wall -I../common -I../host_include -I../../main/json_protocol -o cbor_bench cbor_bench.c ../../main/json_protocol/json_protocol.c -lm
+//
+// Usage:
+//
+//   ./cbor_bench [-s seed] [-n events] [-v]
+//
+//   -s  Random seed (default 1; same seed, same events)
+//   -n  Events to round-trip (default 10000)
+//   -v  Print every event in both encodings
+//
+// Prints the round-trip result and the average CBOR and JSON size per event
+// type (exit status 1 on any failure), then the encoding cost per event of
+// each format.
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "json_protocol.h"
+
+#define EVENT_TYPES 5
+#define PAYLOAD_BUF_SIZE 256
+#define BATCH_MAX_BYTES 1024   // TELEMETRY_BATCH_MAX_BYTES default
+#define BENCH_EVENTS 2000000
+
+#define KEY_BIT(key) (1u << (key))
+
+static const char *const type_names[EVENT_TYPES] = {
+    "state_change", "movement", "code_entry", "code_changed", "calibration",
+};
+
+// ============================================================================
+// Decoder (only what the device sends: definite maps of small integer keys)
+// ============================================================================
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} cbor_reader_t;
+
+// Initial byte and argument of the next item; false on truncated input or
+// 64-bit / indefinite-length arguments
+static bool cbor_get_head(cbor_reader_t *r, uint8_t *major, uint32_t *value)
+{
+    if (r->p >= r->end) {
+        return false;
+    }
+    uint8_t ib = *r->p++;
+    uint8_t info = ib & 0x1F;
+    *major = ib & 0xE0;
+
+    int extra = (info < 24) ? 0 : (info == 24) ? 1 : (info == 25) ? 2 : (info == 26) ? 4 : -1;
+    if (extra < 0 || r->end - r->p < extra) {
+        return false;
+    }
+    uint32_t v = (extra == 0) ? info : 0;
+    for (int i = 0; i < extra; i++) {
+        v = (v << 8) | *r->p++;
+    }
+    *value = v;
+    return true;
+}
+
+static bool cbor_get_uint(cbor_reader_t *r, uint32_t *value)
+{
+    uint8_t major;
+    return cbor_get_head(r, &major, value) && major == 0x00;
+}
+
+static bool cbor_get_int(cbor_reader_t *r, int32_t *value)
+{
+    uint8_t major;
+    uint32_t v;
+    if (!cbor_get_head(r, &major, &v) || v > INT32_MAX) {
+        return false;
+    }
+    if (major == 0x00) {
+        *value = (int32_t)v;
+    } else if (major == 0x20) {
+        *value = -1 - (int32_t)v;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool cbor_get_float32(cbor_reader_t *r, float *value)
+{
+    if (r->end - r->p < 5 || r->p[0] != 0xFA) {
+        return false;
+    }
+    uint32_t bits = ((uint32_t)r->p[1] << 24) | ((uint32_t)r->p[2] << 16) |
+                    ((uint32_t)r->p[3] << 8) | r->p[4];
+    memcpy(value, &bits, sizeof(*value));
+    r->p += 5;
+    return true;
+}
+
+static bool cbor_get_bool(cbor_reader_t *r, bool *value)
+{
+    if (r->p >= r->end || (r->p[0] != 0xF4 && r->p[0] != 0xF5)) {
+        return false;
+    }
+    *value = (*r->p++ == 0xF5);
+    return true;
+}
+
+static bool get_int16(cbor_reader_t *r, int16_t *value)
+{
+    int32_t v;
+    if (!cbor_get_int(r, &v) || v < INT16_MIN || v > INT16_MAX) {
+        return false;
+    }
+    *value = (int16_t)v;
+    return true;
+}
+
+static bool get_uint16(cbor_reader_t *r, uint16_t *value)
+{
+    uint32_t v;
+    if (!cbor_get_uint(r, &v) || v > UINT16_MAX) {
+        return false;
+    }
+    *value = (uint16_t)v;
+    return true;
+}
+
+// One event map. Fills event (fields absent from the map left zero), seq if
+// key 5 is present, and keys with a bit per key seen; false on anything the
+// device would not send (unknown or repeated keys, wrong value types)
+static bool decode_event(cbor_reader_t *r, event_t *event, uint32_t *seq, uint32_t *keys)
+{
+    uint8_t major;
+    uint32_t pairs;
+    if (!cbor_get_head(r, &major, &pairs) || major != 0xA0) {
+        return false;
+    }
+
+    memset(event, 0, sizeof(*event));
+    *keys = 0;
+    for (uint32_t i = 0; i < pairs; i++) {
+        uint32_t key;
+        uint32_t v;
+        bool ok;
+        if (!cbor_get_uint(r, &key) || key > CBOR_KEY_THRESHOLD || (*keys & KEY_BIT(key))) {
+            return false;
+        }
+        *keys |= KEY_BIT(key);
+
+        switch (key) {
+            case CBOR_KEY_TS:
+                ok = cbor_get_uint(r, &event->timestamp);
+                break;
+            case CBOR_KEY_STATE:
+                ok = cbor_get_uint(r, &v) && v <= STATE_ALARM;
+                event->state = (safe_state_t)v;
+                break;
+            case CBOR_KEY_EVENT:
+                ok = cbor_get_uint(r, &v) && v < EVENT_TYPES;
+                event->type = (event_type_t)v;
+                break;
+            case CBOR_KEY_MOVEMENT_AMOUNT:
+                ok = cbor_get_float32(r, &event->movement_amount);
+                break;
+            case CBOR_KEY_CODE_OK:
+                ok = cbor_get_bool(r, &event->code_ok);
+                break;
+            case CBOR_KEY_SEQ:
+                ok = cbor_get_uint(r, seq);
+                break;
+            case CBOR_KEY_DROPPED:
+                ok = cbor_get_uint(r, &event->dropped);
+                break;
+            case CBOR_KEY_REST:
+                ok = cbor_get_head(r, &major, &v) && major == 0x80 && v == 3;
+                for (int axis = 0; ok && axis < 3; axis++) {
+                    ok = get_int16(r, &event->calibration.rest_mg[axis]);
+                }
+                break;
+            case CBOR_KEY_NOISE_MG:
+                ok = get_uint16(r, &event->calibration.noise_mg);
+                break;
+            case CBOR_KEY_SIGMA_MG:
+                ok = get_uint16(r, &event->calibration.sigma_mg);
+                break;
+            default:  // CBOR_KEY_THRESHOLD
+                ok = cbor_get_int(r, &event->calibration.threshold);
+                break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Keys the device sends for an event (json_protocol.h)
+static uint32_t expected_keys(const event_t *event)
+{
+    uint32_t keys = KEY_BIT(CBOR_KEY_TS) | KEY_BIT(CBOR_KEY_STATE) | KEY_BIT(CBOR_KEY_EVENT);
+    switch (event->type) {
+        case EVT_MOVEMENT:
+            keys |= KEY_BIT(CBOR_KEY_MOVEMENT_AMOUNT);
+            break;
+        case EVT_CODE_RESULT:
+            keys |= KEY_BIT(CBOR_KEY_CODE_OK);
+            break;
+        case EVT_CALIBRATION:
+            keys |= KEY_BIT(CBOR_KEY_REST) | KEY_BIT(CBOR_KEY_NOISE_MG) |
+                    KEY_BIT(CBOR_KEY_SIGMA_MG) | KEY_BIT(CBOR_KEY_THRESHOLD);
+            break;
+        default:
+            break;
+    }
+    if (event->dropped > 0) {
+        keys |= KEY_BIT(CBOR_KEY_DROPPED);
+    }
+    return keys;
+}
+
+// Same event, as far as its type carries fields
+static bool same_event(const event_t *a, const event_t *b)
+{
+    if (a->type != b->type || a->timestamp != b->timestamp || a->state != b->state ||
+        a->dropped != b->dropped) {
+        return false;
+    }
+    switch (a->type) {
+        case EVT_MOVEMENT:
+            return memcmp(&a->movement_amount, &b->movement_amount, sizeof(float)) == 0;
+        case EVT_CODE_RESULT:
+            return a->code_ok == b->code_ok;
+        case EVT_CALIBRATION:
+            return memcmp(a->calibration.rest_mg, b->calibration.rest_mg, sizeof(a->calibration.rest_mg)) == 0 &&
+                   a->calibration.noise_mg == b->calibration.noise_mg &&
+                   a->calibration.sigma_mg == b->calibration.sigma_mg &&
+                   a->calibration.threshold == b->calibration.threshold;
+        default:
+            return true;
+    }
+}
+
+// ============================================================================
+// Events
+// ============================================================================
+
+static uint32_t pick_timestamp(void)
+{
+    // Edges of each CBOR argument width first
+    static const uint32_t edges[] = { 0, 23, 24, 255, 256, 65535, 65536, 4294967295u };
+    uint32_t r = rng();
+    return (r % 8 == 0) ? edges[(r >> 3) % 8] : rng();
+}
+
+static float pick_movement(void)
+{
+    static const float edges[] = { 0.0f, -0.0f, 0.005f, 1.5f, 2.675f, 15.999f, 1e-30f, 3.4e38f };
+    uint32_t r = rng();
+    if (r % 8 == 0) {
+        return edges[(r >> 3) % 8];
+    }
+    return (float)(rng() % 1600000) / 100000.0f;
+}
+
+static void make_event(event_t *event, int type)
+{
+    memset(event, 0, sizeof(*event));
+    event->type = (event_type_t)type;
+    event->timestamp = pick_timestamp();
+    event->state = (safe_state_t)(rng() % 3);
+    event->movement_amount = pick_movement();
+    event->code_ok = rng() & 1;
+    for (int i = 0; i < 3; i++) {
+        // Full int16 range now and then (negative arguments of every width)
+        event->calibration.rest_mg[i] = (rng() % 8 == 0) ? (int16_t)rng() : (int16_t)((int32_t)(rng() % 4001) - 2000);
+    }
+    event->calibration.noise_mg = (uint16_t)(rng() % 400);
+    event->calibration.sigma_mg = (uint16_t)(rng() % 100);
+    event->calibration.threshold = 17000 + (int32_t)(rng() % 28001);
+    event->dropped = (rng() % 4 == 0) ? rng() >> (rng() % 32) : 0;
+}
+
+// ============================================================================
+// Round trip
+// ============================================================================
+
+static void print_hex(const char *label, const uint8_t *buf, int len)
+{
+    printf("%s", label);
+    for (int i = 0; i < len; i++) {
+        printf(" %02X", buf[i]);
+    }
+    printf("\n");
+}
+
+// Single events: decode each encoding back and compare
+static int round_trip(const event_t *events, int count, bool verbose)
+{
+    int ok[EVENT_TYPES] = { 0 };
+    int failed[EVENT_TYPES] = { 0 };
+    long cbor_bytes[EVENT_TYPES] = { 0 };
+    long json_bytes[EVENT_TYPES] = { 0 };
+
+    for (int i = 0; i < count; i++) {
+        const event_t *event = &events[i];
+        int type = event->type;
+        uint8_t cbor[PAYLOAD_BUF_SIZE];
+        char json[PAYLOAD_BUF_SIZE];
+        int cbor_len = event_to_cbor(event, cbor, sizeof(cbor));
+        int json_len = event_to_json(event, json, sizeof(json));
+        if (verbose) {
+            printf("%s\n", json);
+            print_hex("   ", cbor, cbor_len);
+        }
+        cbor_bytes[type] += cbor_len;
+        json_bytes[type] += json_len;
+
+        event_t decoded;
+        uint32_t seq = 0;
+        uint32_t keys = 0;
+        cbor_reader_t r = { .p = cbor, .end = cbor + (cbor_len > 0 ? cbor_len : 0) };
+        if (cbor_len > 0 && decode_event(&r, &decoded, &seq, &keys) && r.p == r.end &&
+            keys == expected_keys(event) && same_event(event, &decoded)) {
+            ok[type]++;
+        } else if (failed[type]++ < 3) {
+            printf("ROUND TRIP FAILED: %s\n", json);
+            print_hex("  cbor:", cbor, cbor_len);
+        }
+    }
+
+    int failures = 0;
+    printf("%-13s %8s %8s %11s %11s\n", "event", "ok", "failed", "cbor bytes", "json bytes");
+    for (int t = 0; t < EVENT_TYPES; t++) {
+        int n = ok[t] + failed[t];
+        printf("%-13s %8d %8d %11.1f %11.1f\n", type_names[t], ok[t], failed[t],
+               n ? (double)cbor_bytes[t] / n : 0.0, n ? (double)json_bytes[t] / n : 0.0);
+        failures += failed[t];
+    }
+    return failures;
+}
+
+// Decode one finished batch; events[0..count) are what went in, from first_seq
+static bool check_batch(const telemetry_batch_t *batch, const event_t *events, int count, uint32_t first_seq)
+{
+    const uint8_t *buf = (const uint8_t *)batch->buf;
+    if (batch->len < 2 || buf[0] != 0x9F || buf[batch->len - 1] != 0xFF) {
+        return false;
+    }
+    cbor_reader_t r = { .p = buf + 1, .end = buf + batch->len - 1 };
+    for (int i = 0; i < count; i++) {
+        event_t decoded;
+        uint32_t seq = 0;
+        uint32_t keys = 0;
+        if (!decode_event(&r, &decoded, &seq, &keys) || seq != first_seq + (uint32_t)i ||
+            keys != (expected_keys(&events[i]) | KEY_BIT(CBOR_KEY_SEQ)) ||
+            !same_event(&events[i], &decoded)) {
+            return false;
+        }
+    }
+    return r.p == r.end;
+}
+
+// Batches: as comm_task builds them, then decode every event with its seq
+static int round_trip_batches(const event_t *events, int count)
+{
+    char buf[BATCH_MAX_BYTES];
+    telemetry_batch_t batch;
+    int batches = 0;
+    int failed = 0;
+    int first = 0;
+    // Start high so seq crosses every CBOR argument width
+    uint32_t first_seq = 65500;
+
+    while (first < count) {
+        telemetry_batch_init(&batch, TELEMETRY_FORMAT_CBOR, buf, sizeof(buf));
+        int n = 0;
+        while (first + n < count) {
+            uint8_t cbor[PAYLOAD_BUF_SIZE];
+            int len = event_to_cbor(&events[first + n], cbor, sizeof(cbor));
+            if (len < 0 || !telemetry_batch_add(&batch, first_seq + (uint32_t)n, (const char *)cbor, len)) {
+                break;
+            }
+            n++;
+        }
+        if (n == 0 || telemetry_batch_finish(&batch) < 0 ||
+            !check_batch(&batch, &events[first], n, first_seq)) {
+            if (failed++ < 3) {
+                printf("BATCH FAILED: events %d..%d\n", first, first + n - 1);
+            }
+            if (n == 0) {
+                break;
+            }
+        }
+        batches++;
+        first += n;
+        first_seq += (uint32_t)n;
+    }
+
+    printf("batches: %d of up to %d bytes, %d events, %d failed\n", batches, BATCH_MAX_BYTES, first, failed);
+    return failed + (first < count);
+}
+
+// ============================================================================
+// Cost per event
+// ============================================================================
+
+static void bench(telemetry_format_t format, const event_t *events, int count)
+{
+    char buf[PAYLOAD_BUF_SIZE];
+    long bytes = 0;
+    long done = 0;
+
+    double t0 = now_ns();
+    uint64_t c0 = cycles();
+    while (done < BENCH_EVENTS) {
+        for (int i = 0; i < count; i++) {
+            bytes += event_encode(&events[i], format, buf, sizeof(buf));
+        }
+        done += count;
+    }
+    uint64_t c1 = cycles();
+    double t1 = now_ns();
+
+    printf("  %-4s %6.1f bytes/event %7.1f ns/event", telemetry_format_to_string(format),
+           (double)bytes / done, (t1 - t0) / done);
+    if (c1 != c0) {
+        printf(", %5.0f host cycles/event", (double)(c1 - c0) / done);
+    }
+    printf(" (%ld bytes while timing)\n", bytes);
+}
+
+int main(int argc, char **argv)
+{
+    bench_args_t args = { .seed = 1, .count = 10000 };
+
+    for (int i = 1; i < argc; i++) {
+        if (!bench_arg(argc, argv, &i, "snv", &args)) {
+            return bench_usage(argv[0], "[-s seed] [-n events] [-v]");
+        }
+    }
+    if (args.count < EVENT_TYPES) {
+        args.count = EVENT_TYPES;
+    }
+
+    event_t *events = malloc(sizeof(event_t) * args.count);
+    if (events == NULL) {
+        return 2;
+    }
+    rng_seed(args.seed);
+    for (int i = 0; i < args.count; i++) {
+        make_event(&events[i], i % EVENT_TYPES);
+    }
+
+    int failed = round_trip(events, args.count, args.verbose);
+    failed += round_trip_batches(events, args.count);
+
+    // One event of each type, the mix the bench cycles through
+    printf("cost (one event of each type, cycled):\n");
+    bench(TELEMETRY_FORMAT_CBOR, events, EVENT_TYPES);
+    bench(TELEMETRY_FORMAT_JSON, events, EVENT_TYPES);
+
+    free(events);
+    return failed ? 1 : 0;
+}
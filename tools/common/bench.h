@@ -0,0 +1,85 @@
+// Scaffolding shared by the host tools: seeded random numbers, host timing
+// and the common -s/-n/-v options. Header only; tools build with -I../common.
+#ifndef TOOLS_BENCH_H
+#define TOOLS_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static uint32_t rng_state;
+
+// xorshift32 never leaves 0, so seed 0 counts as 1
+static inline void rng_seed(uint32_t seed)
+{
+    rng_state = seed ? seed : 1;
+}
+
+static inline uint32_t rng(void)
+{
+    // xorshift32: same seed, same sequence on every host
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static inline double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Time stamp counter on x86, 0 elsewhere (print cycles only if it moved)
+static inline uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+typedef struct {
+    uint32_t seed;      // -s  Random seed
+    int count;          // -n  Events, operations or runs
+    bool verbose;       // -v  Print every item
+} bench_args_t;
+
+// Take argv[*i] if it is one of the common options listed in accepted
+// (e.g. "snv"), moving *i past its value. False for anything else, which the
+// tool parses itself or answers with bench_usage().
+static inline bool bench_arg(int argc, char **argv, int *i, const char *accepted, bench_args_t *args)
+{
+    const char *arg = argv[*i];
+    if (arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0' || strchr(accepted, arg[1]) == NULL) {
+        return false;
+    }
+    char opt = arg[1];
+    if (opt == 'v') {
+        args->verbose = true;
+    } else if (opt == 's' && *i + 1 < argc) {
+        args->seed = (uint32_t)strtoul(argv[++*i], NULL, 0);
+    } else if (opt == 'n' && *i + 1 < argc) {
+        args->count = atoi(argv[++*i]);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Usage line on stderr; returns the exit status for it
+static inline int bench_usage(const char *argv0, const char *options)
+{
+    fprintf(stderr, "usage: %s %s\n", argv0, options);
+    return 2;
+}
+
+#endif
@@ -0,0 +1,20 @@
+// Minimal ESP-IDF stand-ins for host tools (see esp_log.h)
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// CRC-32 (IEEE, reflected) as in ROM: esp_rom_crc32_le(0, buf, len) is zlib's crc32
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+#endif
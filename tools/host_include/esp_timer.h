@@ -0,0 +1,9 @@
+// Minimal ESP-IDF stand-ins for host tools (see esp_log.h)
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+#endif
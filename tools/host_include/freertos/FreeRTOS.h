@@ -0,0 +1,22 @@
+// Minimal ESP-IDF stand-ins for host tools (see esp_log.h): the types and
+// calls device code mentions. Nothing here runs; a tool that calls into
+// FreeRTOS defines the calls it needs (queue_bench runs them on pthreads).
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define portMAX_DELAY 0xFFFFFFFFu
+
+// 1 kHz tick, as in sdkconfig
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 2
+
+#endif
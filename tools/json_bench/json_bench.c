@@ -0,0 +1,242 @@
+// Compare the device's streaming event_to_json() with the cJSON encoder it
+// replaced, on a PC.
+//
+// The reference below is the old cJSON-based event_to_json(), with the
+// fields added since (calibration, dropped) built the same way. Both encode
+// the same seeded set of events of every event type; the output must be
+// byte-identical, movement_amount included (1.5, 0.10000000149011612, null).
+//
+// Build (from this directory; cJSON from the ESP-IDF checkout):
+//
+//   CJSON=$IDF_PATH/components/json/cJSON
+//   gcc -O2 -Wall -I../common -I../host_include -I../../main/json_protocol -I$CJSON -o json_bench json_bench.c ../../main/json_protocol/json_protocol.c $CJSON/cJSON.c -lm
+//
+// Usage:
+//
+//   ./json_bench [-s seed] [-n events] [-v]
+//
+//   -s  Random seed (default 1; same seed, same events)
+//   -n  Events to compare (default 10000)
+//   -v  Print every event in both encodings
+//
+// Prints the identical and mismatching counts per event
+// type (exit status 1 on any mismatch), then the cost per event of each
+// encoder, including cJSON's allocations.
+
+#define _POSIX_C_SOURCE 199309L
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "cJSON.h"
+#include "json_protocol.h"
+
+#define EVENT_TYPES 5
+#define JSON_BUF_SIZE 256
+#define BENCH_EVENTS 2000000
+
+static const char *const type_names[EVENT_TYPES] = {
+    "state_change", "movement", "code_entry", "code_changed", "calibration",
+};
+
+// ============================================================================
+// Reference: event_to_json() as it was with cJSON
+// ============================================================================
+
+static int cjson_event_to_json(const event_t *event, char *buffer, size_t buffer_size)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (root == NULL) {
+        return -1;
+    }
+
+    cJSON_AddNumberToObject(root, "ts", event->timestamp);
+    cJSON_AddStringToObject(root, "state", state_to_string(event->state));
+
+    switch (event->type) {
+        case EVT_STATE_CHANGE:
+            cJSON_AddStringToObject(root, "event", "state_change");
+            break;
+
+        case EVT_MOVEMENT:
+            cJSON_AddStringToObject(root, "event", "movement");
+            cJSON_AddNumberToObject(root, "movement_amount", event->movement_amount);
+            break;
+
+        case EVT_CODE_RESULT:
+            cJSON_AddStringToObject(root, "event", "code_entry");
+            cJSON_AddBoolToObject(root, "code_ok", event->code_ok);
+            break;
+
+        case EVT_CODE_CHANGED:
+            cJSON_AddStringToObject(root, "event", "code_changed");
+            break;
+
+        case EVT_CALIBRATION: {
+            const sensor_calibration_t *cal = &event->calibration;
+            int rest[3] = { cal->rest_mg[0], cal->rest_mg[1], cal->rest_mg[2] };
+            cJSON_AddStringToObject(root, "event", "calibration");
+            cJSON_AddItemToObject(root, "rest", cJSON_CreateIntArray(rest, 3));
+            cJSON_AddNumberToObject(root, "noise_mg", cal->noise_mg);
+            cJSON_AddNumberToObject(root, "sigma_mg", cal->sigma_mg);
+            cJSON_AddNumberToObject(root, "threshold", cal->threshold);
+            break;
+        }
+    }
+
+    if (event->dropped > 0) {
+        cJSON_AddNumberToObject(root, "dropped", event->dropped);
+    }
+
+    char *json_str = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (json_str == NULL) {
+        return -1;
+    }
+    int len = snprintf(buffer, buffer_size, "%s", json_str);
+    cJSON_free(json_str);
+    return (len < (int)buffer_size) ? len : -1;
+}
+
+// ============================================================================
+// Events
+// ============================================================================
+
+static uint32_t pick_timestamp(void)
+{
+    // Edges first (cJSON prints values above INT_MAX through "%1.15g")
+    static const uint32_t edges[] = { 0, 1, 999, 2147483647u, 2147483648u, 4294967295u };
+    uint32_t r = rng();
+    return (r % 8 == 0) ? edges[(r >> 3) % 6] : rng();
+}
+
+static float pick_movement(void)
+{
+    // Mostly realistic readings in g, plus whole values, values with no short
+    // float representation and ones cJSON prints as null or saturates
+    static const float edges[] = { 0.0f, 0.005f, 0.1f, 0.125f, 1.0f, 1.5f, 2.675f, 15.999f,
+                                   -1.5f, 3e9f, -3e9f, 1e-7f, NAN, INFINITY, -INFINITY, 16.0f };
+    uint32_t r = rng();
+    if (r % 8 == 0) {
+        return edges[(r >> 3) % 16];
+    }
+    return (float)(rng() % 1600000) / 100000.0f;
+}
+
+static void make_event(event_t *event, int type)
+{
+    memset(event, 0, sizeof(*event));
+    event->type = (event_type_t)type;
+    event->timestamp = pick_timestamp();
+    event->state = (safe_state_t)(rng() % 3);
+    event->movement_amount = pick_movement();
+    event->code_ok = rng() & 1;
+    for (int i = 0; i < 3; i++) {
+        event->calibration.rest_mg[i] = (int16_t)((int32_t)(rng() % 4001) - 2000);
+    }
+    event->calibration.noise_mg = (uint16_t)(rng() % 400);
+    event->calibration.sigma_mg = (uint16_t)(rng() % 100);
+    event->calibration.threshold = 17000 + (int32_t)(rng() % 28001);
+    event->dropped = (rng() % 4 == 0) ? rng() % 100000 : 0;
+}
+
+// ============================================================================
+// Comparison
+// ============================================================================
+
+static int compare(int count, bool verbose)
+{
+    int identical[EVENT_TYPES] = { 0 };
+    int mismatch[EVENT_TYPES] = { 0 };
+
+    for (int i = 0; i < count; i++) {
+        event_t event;
+        int type = i % EVENT_TYPES;
+        make_event(&event, type);
+
+        char ours[JSON_BUF_SIZE];
+        char ref[JSON_BUF_SIZE];
+        int ours_len = event_to_json(&event, ours, sizeof(ours));
+        int ref_len = cjson_event_to_json(&event, ref, sizeof(ref));
+        if (verbose) {
+            printf("%s\n%s\n\n", ours, ref);
+        }
+
+        if (ours_len >= 0 && ours_len == ref_len && memcmp(ours, ref, ours_len) == 0) {
+            identical[type]++;
+        } else {
+            if (mismatch[type]++ < 3) {
+                printf("MISMATCH\n  streaming: %s\n  cJSON:     %s\n", ours, ref);
+            }
+        }
+    }
+
+    int failed = 0;
+    printf("%-13s %10s %10s\n", "event", "identical", "mismatch");
+    for (int t = 0; t < EVENT_TYPES; t++) {
+        printf("%-13s %10d %10d\n", type_names[t], identical[t], mismatch[t]);
+        failed += mismatch[t];
+    }
+    return failed;
+}
+
+// ============================================================================
+// Cost per event
+// ============================================================================
+
+typedef int (*encoder_t)(const event_t *event, char *buffer, size_t buffer_size);
+
+static void bench(const char *name, encoder_t encode, const event_t *events, int count)
+{
+    char buf[JSON_BUF_SIZE];
+    long bytes = 0;
+    long done = 0;
+
+    double t0 = now_ns();
+    uint64_t c0 = cycles();
+    while (done < BENCH_EVENTS) {
+        for (int i = 0; i < count; i++) {
+            bytes += encode(&events[i], buf, sizeof(buf));
+        }
+        done += count;
+    }
+    uint64_t c1 = cycles();
+    double t1 = now_ns();
+
+    printf("  %-9s %7.1f ns/event", name, (t1 - t0) / done);
+    if (c1 != c0) {
+        printf(", %5.0f host cycles/event", (double)(c1 - c0) / done);
+    }
+    printf(" (%ld bytes while timing)\n", bytes);
+}
+
+int main(int argc, char **argv)
+{
+    bench_args_t args = { .seed = 1, .count = 10000 };
+
+    for (int i = 1; i < argc; i++) {
+        if (!bench_arg(argc, argv, &i, "snv", &args)) {
+            return bench_usage(argv[0], "[-s seed] [-n events] [-v]");
+        }
+    }
+    if (args.count < EVENT_TYPES) {
+        args.count = EVENT_TYPES;
+    }
+
+    rng_seed(args.seed);
+    int failed = compare(args.count, args.verbose);
+
+    // One event of each type, the mix the bench cycles through
+    event_t events[EVENT_TYPES];
+    for (int t = 0; t < EVENT_TYPES; t++) {
+        make_event(&events[t], t);
+    }
+    printf("cost (one event of each type, cycled):\n");
+    bench("streaming", event_to_json, events, EVENT_TYPES);
+    bench("cJSON", cjson_event_to_json, events, EVENT_TYPES);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,323 @@
+// Inject synthetic key bursts into the keypad debouncer on a PC.
+//
+// Models the device scanner around the device's own key_matrix.c: a 4x4
+// matrix without diodes (undriven rows float, so held keys can ghost), one
+// row read per KEYPAD_SCAN_TICK_US tick, a column interrupt that wakes the
+// scanner from idle, and contact bounce on every press and release.
+//
+// Build (from this directory):
+//
+//   gcc -O2 -Wall -I../common -I../../main/keypad -o key_bench key_bench.c ../../main/keypad/key_matrix.c
+//
+// Usage:
+//
+//   ./key_bench [-s seed] [-n keys] [-r keys_per_s] [-b bounce_ms] [-h hold_ms]
+//               [-t tick_us] [-d debounce_ms] [-w wake_us] [-v]
+//
+//   -s  Random seed (default 1; same seed, same bursts)
+//   -n  Keys to inject (default 2000), in bursts of 5 (a PIN and '#')
+//       separated by 400 ms of idle
+//   -r  Typing rate within a burst (default 8 keys/s)
+//   -b  Longest contact bounce after each edge (default 3 ms)
+//   -h  Mean hold time (default 90 ms, +-50%)
+//   -t  Scan tick per row (default 1000 us)
+//   -d  Debounce time (default 20 ms)
+//   -w  Interrupt to first scan tick (default 50 us, the keypad_task hop)
+//   -v  Print every injected key and event
+//
+// Prints detected, missed and spurious presses, the contact-to-press-event
+// latency (the "debounce" stage of the device's "latency" telemetry) and
+// the error of the contact timestamp the device would report. The later
+// stages (queues, control_task, LCD) are only measured on the device.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "key_matrix.h"
+
+#define BURST_KEYS 5
+#define BURST_GAP_US 400000
+#define BUCKETS 20
+#define REPRESS_US 60000    // Quickest release and re-press of one key
+
+static const char key_chars[16] = {
+    '1', '2', '3', 'A', '4', '5', '6', 'B', '7', '8', '9', 'C', '*', '0', '#', 'D'
+};
+
+typedef struct {
+    int index;
+    int64_t down_us, up_us;     // First and last contact edge
+    int64_t settle_down_us;     // Bounce ends after the press
+    int64_t settle_up_us;       // Bounce ends after the release
+    uint32_t seed;              // Bounce pattern
+    int64_t pressed_us;         // Press event (0: not seen)
+    int64_t reported_contact_us;
+    int presses;
+} injected_t;
+
+// Contact state of a key at time t, with chatter during the bounce windows
+static bool contact(const injected_t *k, int64_t t)
+{
+    if (t < k->down_us || t >= k->settle_up_us) {
+        return false;
+    }
+    bool after_release = t >= k->up_us;
+    int64_t edge = after_release ? k->up_us : k->down_us;
+    int64_t settle = after_release ? k->settle_up_us : k->settle_down_us;
+    if (t >= settle) {
+        return !after_release;
+    }
+    // Chatter: flip every 100-400 us, pseudo-randomly per key
+    uint32_t slot = (uint32_t)((t - edge) / 100);
+    uint32_t h = (slot * 2654435761u) ^ k->seed;
+    return ((h >> 7) % 3 != 0) != after_release;
+}
+
+// Columns pulled low with `row` driven (row < 0: all rows), through closed
+// keys and floating rows
+static uint8_t columns_low(const bool closed[16], int row)
+{
+    bool row_low[4], col_low[4] = { false };
+    for (int r = 0; r < 4; r++) {
+        row_low[r] = (row < 0 || r == row);
+    }
+    for (int pass = 0; pass < 4; pass++) {
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                if (closed[r * 4 + c]) {
+                    if (row_low[r]) col_low[c] = true;
+                    if (col_low[c]) row_low[r] = true;
+                }
+            }
+        }
+    }
+    return (uint8_t)(col_low[0] | (col_low[1] << 1) | (col_low[2] << 2) | (col_low[3] << 3));
+}
+
+static int bucket(uint32_t us)
+{
+    int b = (us == 0) ? 0 : 32 - __builtin_clz(us);
+    return b < BUCKETS ? b : BUCKETS - 1;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    bench_args_t args = { .seed = 1, .count = 2000 };
+    int rate = 8, bounce_ms = 3, hold_ms = 90, tick_us = 1000, debounce_ms = 20, wake_us = 50;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && argv[i][0] == '-' && strlen(argv[i]) == 2 && strchr("rbhtdw", argv[i][1])) {
+            int v = atoi(argv[++i]);
+            switch (argv[i - 1][1]) {
+                case 'r': rate = v; break;
+                case 'b': bounce_ms = v; break;
+                case 'h': hold_ms = v; break;
+                case 't': tick_us = v; break;
+                case 'd': debounce_ms = v; break;
+                case 'w': wake_us = v; break;
+            }
+        } else if (!bench_arg(argc, argv, &i, "snv", &args)) {
+            return bench_usage(argv[0], "[-s seed] [-n keys] [-r keys_per_s] [-b bounce_ms] [-h hold_ms]\n"
+                                        "       [-t tick_us] [-d debounce_ms] [-w wake_us] [-v]");
+        }
+    }
+    int n = args.count;
+    bool verbose = args.verbose;
+    if (n <= 0 || rate <= 0 || tick_us <= 0 || debounce_ms <= 0) {
+        fprintf(stderr, "invalid parameters\n");
+        return 2;
+    }
+
+    // Synthesize the bursts
+    rng_seed(args.seed);
+    injected_t *keys = calloc(n, sizeof(injected_t));
+    int64_t t = 100000;
+    for (int i = 0; i < n; i++) {
+        injected_t *k = &keys[i];
+        if (i > 0 && i % BURST_KEYS == 0) {
+            t += BURST_GAP_US;
+        }
+        int64_t gap = 1000000 / rate;
+        t += gap / 2 + rng() % gap;                       // 0.5x-1.5x the mean interval
+        k->index = (i % BURST_KEYS == BURST_KEYS - 1) ? 14 : (int)(rng() % 16);    // '#' ends a burst
+        for (int j = i - 1; j >= 0 && j >= i - 4; j--) {
+            if (keys[j].index == k->index && t < keys[j].up_us + REPRESS_US) {
+                t = keys[j].up_us + REPRESS_US;
+            }
+        }
+        int64_t hold = hold_ms * 1000 / 2 + rng() % (hold_ms * 1000 + 1);
+        k->down_us = t;
+        k->settle_down_us = t + (bounce_ms ? rng() % (bounce_ms * 1000 + 1) : 0);
+        k->up_us = t + hold;
+        k->settle_up_us = k->up_us + (bounce_ms ? rng() % (bounce_ms * 1000 + 1) : 0);
+        k->seed = rng();
+    }
+    int64_t end_us = keys[n - 1].settle_up_us + 500000;
+
+    // Scanner, as in keypad.c
+    int frame_us = 4 * tick_us;
+    int debounce_scans = (debounce_ms * 1000 + frame_us - 1) / frame_us;
+    key_matrix_t matrix;
+    key_matrix_init(&matrix, (uint8_t)(debounce_scans > 255 ? 255 : debounce_scans));
+
+    bool scanning = false;
+    int64_t next_tick = 0, last_scan = 0;
+    int row = 0, first = 0, spurious = 0;
+    long scans = 0, wakes = 0;
+    uint16_t raw = 0;
+    size_t raw_cap = 4096;
+    uint16_t *raws = malloc(raw_cap * sizeof(uint16_t));    // Kept for the cost measurement
+
+    for (int64_t now = 0; now < end_us; ) {
+        // Keys that can be closed now
+        while (first < n && keys[first].settle_up_us <= now) {
+            first++;
+        }
+        bool closed[16] = { false };
+        for (int i = first; i < n && keys[i].down_us <= now; i++) {
+            if (contact(&keys[i], now)) {
+                closed[keys[i].index] = true;
+            }
+        }
+
+        if (!scanning) {
+            if (columns_low(closed, -1)) {
+                // Column interrupt; the first tick follows the task hop
+                scanning = true;
+                wakes++;
+                last_scan = now;
+                row = 0;
+                raw = 0;
+                next_tick = now + wake_us + tick_us;
+            }
+            now += 10;
+            continue;
+        }
+        if (now < next_tick) {
+            now = next_tick;
+            continue;
+        }
+
+        raw |= (uint16_t)columns_low(closed, row) << (row * 4);
+        row = (row + 1) % 4;
+        next_tick += tick_us;
+        if (row != 0) {
+            continue;
+        }
+
+        key_change_t changes[KEY_MATRIX_KEYS];
+        int count = key_matrix_scan(&matrix, raw, last_scan, now, changes);
+        if ((size_t)scans == raw_cap) {
+            raw_cap *= 2;
+            raws = realloc(raws, raw_cap * sizeof(uint16_t));
+        }
+        raws[scans++] = raw;
+        last_scan = now;
+        raw = 0;
+
+        for (int c = 0; c < count; c++) {
+            if (!changes[c].pressed) {
+                if (verbose) printf("%10.3f ms  release %c (held %u ms)\n", now / 1000.0,
+                                    key_chars[changes[c].index], changes[c].hold_ms);
+                continue;
+            }
+            // Attribute the press to the injected key it belongs to
+            injected_t *match = NULL;
+            for (int i = first; i < n && keys[i].down_us <= now; i++) {
+                if (keys[i].index == changes[c].index && keys[i].presses == 0) {
+                    match = &keys[i];
+                    break;
+                }
+            }
+            if (match == NULL) {
+                spurious++;
+                if (verbose) printf("%10.3f ms  press %c SPURIOUS\n", now / 1000.0, key_chars[changes[c].index]);
+                continue;
+            }
+            match->presses++;
+            match->pressed_us = now;
+            match->reported_contact_us = changes[c].contact_us;
+            if (verbose) printf("%10.3f ms  press %c (contact at %.3f ms, reported %.3f ms)\n", now / 1000.0,
+                                key_chars[changes[c].index], match->down_us / 1000.0,
+                                changes[c].contact_us / 1000.0);
+        }
+        if (key_matrix_idle(&matrix)) {
+            scanning = false;
+        }
+    }
+
+    // Results
+    int detected = 0, missed = 0, doubled = 0;
+    uint32_t *lat = calloc(n, sizeof(uint32_t));
+    uint32_t hist[BUCKETS] = { 0 };
+    int64_t stamp_err_max = 0, stamp_err_sum = 0;
+    double lat_sum = 0;
+    for (int i = 0; i < n; i++) {
+        injected_t *k = &keys[i];
+        if (k->presses == 0) {
+            missed++;
+            if (verbose) printf("missed %c at %.3f ms (held %lld ms)\n", key_chars[k->index], k->down_us / 1000.0,
+                                (long long)((k->up_us - k->down_us) / 1000));
+            continue;
+        }
+        doubled += k->presses - 1;
+        uint32_t us = (uint32_t)(k->pressed_us - k->down_us);
+        lat[detected++] = us;
+        lat_sum += us;
+        hist[bucket(us)]++;
+        int64_t err = k->reported_contact_us - k->down_us;
+        err = err < 0 ? -err : err;
+        stamp_err_sum += err;
+        if (err > stamp_err_max) stamp_err_max = err;
+    }
+    qsort(lat, detected, sizeof(uint32_t), cmp_u32);
+
+    // Debouncer cost: the recorded scans replayed until 2M were fed
+    double scan_ns = 0;
+    long bench_events = 0;
+    if (scans > 0) {
+        key_matrix_t bench;
+        key_change_t changes[KEY_MATRIX_KEYS];
+        long fed = 0;
+        key_matrix_init(&bench, matrix.debounce_scans);
+        double t0 = now_ns();
+        while (fed < 2000000) {
+            for (long i = 0; i < scans; i++) {
+                bench_events += key_matrix_scan(&bench, raws[i], i, i + 1, changes);
+            }
+            fed += scans;
+        }
+        scan_ns = (now_ns() - t0) / fed;
+    }
+
+    printf("key_bench: seed %u, %d keys in bursts of %d at %d keys/s, bounce <= %d ms, hold ~%d ms\n",
+           args.seed, n, BURST_KEYS, rate, bounce_ms, hold_ms);
+    printf("  scanner: %d us/row, debounce %d scans (%d ms), wake %d us\n",
+           tick_us, debounce_scans, debounce_scans * frame_us / 1000, wake_us);
+    printf("  presses: %d detected, %d missed, %d spurious, %d doubled\n", detected, missed, spurious, doubled);
+    if (detected > 0) {
+        printf("  contact -> press event: avg %.0f us, p50 %u, p99 %u, max %u us\n", lat_sum / detected,
+               lat[detected / 2], lat[(int)(detected * 0.99)], lat[detected - 1]);
+        printf("  histogram (log2 us, as in the \"latency\" telemetry):");
+        for (int b = 0; b < BUCKETS; b++) printf(" %u", hist[b]);
+        printf("\n  reported contact time error: avg %lld us, max %lld us\n",
+               (long long)(stamp_err_sum / detected), (long long)stamp_err_max);
+    }
+    printf("  scanning: %ld wake-ups, %ld scans (%.1f%% of the time), %.1f ns per key_matrix_scan"
+           " (%ld events while timing)\n",
+           wakes, scans, 100.0 * scans * frame_us / end_us, scan_ns, bench_events);
+
+    free(raws);
+    free(lat);
+    free(keys);
+    return 0;
+}
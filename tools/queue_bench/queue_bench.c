@@ -0,0 +1,333 @@
+// Time the inter-task queues on a PC: the SPSC ring backend against the
+// FreeRTOS queue backend of the device's own queue_manager.c.
+//
+// A producer thread sends event_t through send_event() and a consumer thread
+// takes them with receive_event(QUEUE_WAIT_FOREVER), as control_task and
+// comm_task do. The FreeRTOS calls queue_manager.c makes run on the pthread
+// stand-ins below: task notifications for the SPSC ring, and for the xQueue
+// backend a queue under a mutex and condition variables (FreeRTOS copies
+// under a critical section instead). The numbers compare the two backends
+// on the host; they are not ESP32 timings. The producer keeps no more than
+// the queue length in flight, so nothing is dropped.
+//
+// The backend is chosen at compile time (QUEUE_BACKEND), so each is its own
+// binary. -DCONFIG_H skips the contents of config.h, if there is one, so the
+// backend given here applies.
+//
+// Build (from this directory):
+//
+//   for b in FREERTOS SPSC; do gcc -O2 -Wall -pthread -DCONFIG_H -DQUEUE_BACKEND=QUEUE_BACKEND_$b -I../host_include -I../../main/queue_manager -o queue_bench_$b queue_bench.c ../../main/queue_manager/queue_manager.c; done
+//
+// Usage:
+//
+//   ./queue_bench_<backend> [-n items]
+//
+//   -n  Events to pass through the queue (default 2000000)
+//
+// Prints the throughput, the send-to-receive latency (median, 99th
+// percentile, worst case) and the device's own statistics for the queue,
+// then the cost of a send and receive on one thread, without a switch.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_timer.h"
+#include "queue_manager.h"
+
+#define EVENT_QUEUE_LENGTH 10   // EVENT_QUEUE_SIZE in queue_manager.c
+
+// ============================================================================
+// FreeRTOS stand-ins (pthreads)
+// ============================================================================
+
+struct tskTaskControlBlock {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify[configTASK_NOTIFICATION_ARRAY_ENTRIES];
+};
+
+struct QueueDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+static __thread TaskHandle_t current_task;
+static int queues_created;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)(now_ns() / 1000);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_ns() / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task;
+}
+
+// Wait on cond for up to ticks (1 ms each); false on timeout
+static bool wait_ticks(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return pthread_cond_timedwait(cond, lock, &deadline) != ETIMEDOUT;
+}
+
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify[index]++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t ticks)
+{
+    TaskHandle_t task = current_task;
+    pthread_mutex_lock(&task->lock);
+    while (task->notify[index] == 0 && ticks != 0) {
+        if (!wait_ticks(&task->cond, &task->lock, ticks)) {
+            break;
+        }
+    }
+    uint32_t value = task->notify[index];
+    if (value > 0) {
+        task->notify[index] = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t q = calloc(1, sizeof(*q));
+    if (q == NULL || (q->storage = malloc(length * item_size)) == NULL) {
+        free(q);
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    q->length = length;
+    q->item_size = item_size;
+    queues_created++;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    free(q->storage);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length) {
+        if (ticks == 0 || !wait_ticks(&q->not_full, &q->lock, ticks)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(q->storage + ((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        if (ticks == 0 || !wait_ticks(&q->not_empty, &q->lock, ticks)) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(item, q->storage + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+static void task_init(TaskHandle_t task)
+{
+    memset(task, 0, sizeof(*task));
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+}
+
+// ============================================================================
+// Producer and consumer
+// ============================================================================
+
+static struct tskTaskControlBlock producer_task;
+static struct tskTaskControlBlock consumer_task;
+static long item_count;
+static atomic_long received;
+static long send_failures;
+static uint32_t *latency_ns;
+
+static void *producer(void *arg)
+{
+    (void)arg;
+    current_task = &producer_task;
+    event_t event;
+    memset(&event, 0, sizeof(event));
+    event.type = EVT_MOVEMENT;
+
+    for (long i = 0; i < item_count; i++) {
+        while (i - atomic_load_explicit(&received, memory_order_acquire) >= EVENT_QUEUE_LENGTH) {
+            sched_yield();
+        }
+        event.timestamp = (uint32_t)now_ns();
+        while (!send_event(&event)) {
+            send_failures++;    // Queue full: should not happen with the window above
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    (void)arg;
+    current_task = &consumer_task;
+    event_t event;
+
+    for (long i = 0; i < item_count; i++) {
+        if (!receive_event(&event, QUEUE_WAIT_FOREVER)) {
+            break;
+        }
+        latency_ns[i] = (uint32_t)now_ns() - event.timestamp;
+        atomic_store_explicit(&received, i + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+// Send and receive on one thread: the cost of the queue operations alone,
+// without a thread switch
+static void bench_uncontended(long count)
+{
+    current_task = &consumer_task;
+    event_t event;
+    memset(&event, 0, sizeof(event));
+    long passed = 0;
+
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < count; i++) {
+        send_event(&event);
+        passed += receive_event(&event, 0);
+    }
+    uint64_t t1 = now_ns();
+
+    printf("  one thread %.1f ns per send + receive (%ld passed while timing)\n",
+           (double)(t1 - t0) / count, passed);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    item_count = 2000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            item_count = atol(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [-n items]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (item_count < 1) {
+        item_count = 1;
+    }
+    latency_ns = malloc(sizeof(uint32_t) * item_count);
+    if (latency_ns == NULL) {
+        return 2;
+    }
+
+    task_init(&producer_task);
+    task_init(&consumer_task);
+    if (!queue_manager_init()) {
+        fprintf(stderr, "queue_manager_init failed\n");
+        return 1;
+    }
+    printf("backend: %s, %ld events of %zu bytes\n",
+           queues_created ? "FreeRTOS queue (pthread stand-in)" : "SPSC ring", item_count, sizeof(event_t));
+
+    pthread_t threads[2];
+    uint64_t t0 = now_ns();
+    pthread_create(&threads[1], NULL, consumer, NULL);
+    pthread_create(&threads[0], NULL, producer, NULL);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+    uint64_t t1 = now_ns();
+
+    long done = atomic_load(&received);
+    qsort(latency_ns, done, sizeof(uint32_t), compare_u32);
+    printf("  throughput %.2f Mops/s (%ld received, %ld send failures)\n",
+           done * 1000.0 / (t1 - t0), done, send_failures);
+    if (done > 0) {
+        printf("  latency    p50 %.1f us, p99 %.1f us, worst %.1f us\n",
+               latency_ns[done / 2] / 1000.0, latency_ns[done * 99 / 100] / 1000.0, latency_ns[done - 1] / 1000.0);
+    }
+
+    queue_stats_t stats[QUEUE_STATS_COUNT];
+    queue_manager_get_stats(stats, QUEUE_STATS_COUNT);
+    const queue_stats_t *s = &stats[0];
+    while (strcmp(s->name, "Event") != 0) {
+        s++;
+    }
+    printf("  device stats (%s queue): sent %lu, dropped %lu, hwm %lu/%lu, max %lu us\n",
+           s->name, (unsigned long)s->sent, (unsigned long)s->dropped, (unsigned long)s->high_water,
+           (unsigned long)s->length, (unsigned long)s->max_residence_us);
+
+    bench_uncontended(item_count);
+
+    free(latency_ns);
+    return (done == item_count) ? 0 : 1;
+}
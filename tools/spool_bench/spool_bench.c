@@ -0,0 +1,576 @@
+// Check the device's telemetry_spool on a simulated flash partition, on a PC.
+//
+// The flash model behaves like NOR flash: an erase sets a 4 KB sector to
+// 0xFF, a write can only clear bits, and a power cut stops a write part-way.
+// Every boot runs in a fresh fork of this process on the same flash (shared
+// memory), so each mount starts from the module's power-on state, as on the
+// device. Checks:
+//
+//   wrap     offline for several times what the ring holds, sectors erased
+//            as appends reach them: the newest records survive, in order
+//            and intact, kept + dropped equals appended, the same after a
+//            reboot, and erases rotate evenly over the sectors
+//   consume  delivered records are cleared in place and do not come back
+//            after a reboot; the others do, in order
+//   crc      a bit flipped in a stored record before the reboot and one
+//            after mounting, and a page write cut short by power loss: no
+//            damaged record is delivered, the rest are, and so are appends
+//            after the reboot
+//   ram      events copied from RAM on a disconnect are not imported
+//            again, but come back after a reboot unless acked; no copy is
+//            taken while unread records wait
+//   erase    with the next sector erased ahead between appends, as comm_task
+//            does: no append erases, and an ack for a record in the sector
+//            being reclaimed is ignored
+//
+// -DCONFIG_H skips the contents of config.h, if there is one, so the spool
+// runs with its defaults.
+//
+// Build (from this directory):
+//
+//   gcc -O2 -Wall -DCONFIG_H -I../common -I../host_include -I../../main/telemetry_spool -o spool_bench spool_bench.c ../../main/telemetry_spool/telemetry_spool.c
+//
+// Usage:
+//
+//   ./spool_bench [-s seed] [-k sectors] [-v]
+//
+//   -s  Random seed (default 1; same seed, same payload sizes and ack order)
+//   -k  Partition size in 4 KB sectors (default 8, 3..64)
+//   -v  Show the spool's own warnings (dropped, torn and corrupt records)
+//
+// Prints one line per check with what it saw, and exits 1 if any failed.
+
+#define _DEFAULT_SOURCE
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_partition.h"
+#include "telemetry_spool.h"
+
+#define SECTOR_SIZE 4096
+#define MAX_SECTORS 64
+#define RECORD_HEADER_SIZE 16   // record_header_t in telemetry_spool.c
+#define MAX_EVENTS 4096
+
+// ============================================================================
+// Flash model (shared by every boot)
+// ============================================================================
+
+typedef struct {
+    uint8_t flash[MAX_SECTORS * SECTOR_SIZE];
+    uint32_t erases[MAX_SECTORS];   // Per sector, since the last format
+    uint32_t write_sector;          // Sector whose header was written last
+    long cut_budget;                // Bytes left before the power cut, -1 for none
+    bool power_lost;
+
+    // Handed from one boot to the next
+    int count;
+    uint32_t seqs[MAX_EVENTS];
+    uint32_t refs[MAX_EVENTS];
+    bool acked[MAX_EVENTS];
+} shared_t;
+
+static shared_t *shared;
+static esp_partition_t partition = { .type = ESP_PARTITION_TYPE_DATA, .label = "spool" };
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    (void)type; (void)subtype;
+    return strcmp(label, partition.label) == 0 ? &partition : NULL;
+}
+
+static bool in_range(size_t offset, size_t size)
+{
+    return offset <= partition.size && size <= partition.size - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t src_offset, void *dst, size_t size)
+{
+    (void)part;
+    if (!in_range(src_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, shared->flash + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t dst_offset, const void *src, size_t size)
+{
+    (void)part;
+    if (!in_range(dst_offset, size) || shared->power_lost) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (shared->cut_budget >= 0 && (long)size > shared->cut_budget) {
+        size = (size_t)shared->cut_budget;
+        shared->power_lost = true;
+    }
+    if (shared->cut_budget >= 0) {
+        shared->cut_budget -= (long)size;
+    }
+    // Programming only clears bits
+    const uint8_t *in = src;
+    for (size_t i = 0; i < size; i++) {
+        shared->flash[dst_offset + i] &= in[i];
+    }
+    if (dst_offset % SECTOR_SIZE == 0 && size > 0) {
+        shared->write_sector = (uint32_t)(dst_offset / SECTOR_SIZE);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size)
+{
+    (void)part;
+    if (!in_range(offset, size) || offset % SECTOR_SIZE != 0 || size % SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(shared->flash + offset, 0xFF, size);
+    for (size_t s = offset / SECTOR_SIZE; s < (offset + size) / SECTOR_SIZE; s++) {
+        shared->erases[s]++;
+    }
+    return ESP_OK;
+}
+
+static TickType_t ticks;
+
+TickType_t xTaskGetTickCount(void)
+{
+    return ticks;
+}
+
+static void format_flash(int sectors)
+{
+    partition.size = (uint32_t)sectors * SECTOR_SIZE;
+    memset(shared, 0, sizeof(*shared));
+    memset(shared->flash, 0xFF, sizeof(shared->flash));
+    shared->cut_budget = -1;
+}
+
+static bool sector_erased(uint32_t sector)
+{
+    for (int i = 0; i < SECTOR_SIZE; i++) {
+        if (shared->flash[sector * SECTOR_SIZE + i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// Events
+// ============================================================================
+
+static uint32_t seed = 1;
+static int sectors = 8;
+static bool verbose = false;
+
+// Payload length and contents follow from seq, so a read can be checked alone
+static uint32_t mix(uint32_t seq)
+{
+    uint32_t x = (seq + 1) * 2654435761u ^ seed;
+    x ^= x >> 15;
+    x *= 2246822519u;
+    return x ^ (x >> 13);
+}
+
+static uint16_t event_len(uint32_t seq)
+{
+    return (uint16_t)(1 + mix(seq) % TELEMETRY_PAYLOAD_SIZE);
+}
+
+static char event_byte(uint32_t seq, int i)
+{
+    return (char)((mix(seq) >> 8) + (uint32_t)i * 7);
+}
+
+static void make_entry(telemetry_entry_t *entry, uint32_t seq)
+{
+    *entry = (telemetry_entry_t){
+        .payload_len = event_len(seq),
+        .format = (telemetry_format_t)(seq & 1),
+        .seq = seq,
+        .spool_ref = TELEMETRY_SPOOL_REF_NONE,
+    };
+    for (int i = 0; i < entry->payload_len; i++) {
+        entry->payload[i] = event_byte(seq, i);
+    }
+}
+
+static bool append(uint32_t seq)
+{
+    telemetry_entry_t entry;
+    make_entry(&entry, seq);
+    return telemetry_spool_append(&entry);
+}
+
+static bool intact(const telemetry_entry_t *entry)
+{
+    if (entry->payload_len != event_len(entry->seq) || entry->format != (telemetry_format_t)(entry->seq & 1)) {
+        return false;
+    }
+    for (int i = 0; i < entry->payload_len; i++) {
+        if (entry->payload[i] != event_byte(entry->seq, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Write the staged page, as comm_task does once it is old enough
+static void flush(void)
+{
+    ticks += pdMS_TO_TICKS(60000);
+    telemetry_spool_sync();
+}
+
+// Import every unread record into shared->seqs/refs; false if one is
+// damaged or out of order
+static bool drain(void)
+{
+    telemetry_entry_t entry;
+    bool ok = true;
+    shared->count = 0;
+    while (shared->count < MAX_EVENTS && telemetry_spool_read_next(&entry)) {
+        if (!intact(&entry)) {
+            printf("    damaged record delivered (seq=%lu)\n", (unsigned long)entry.seq);
+            ok = false;
+        }
+        if (shared->count > 0 && (int32_t)(entry.seq - shared->seqs[shared->count - 1]) <= 0) {
+            printf("    seq %lu after %lu\n", (unsigned long)entry.seq, (unsigned long)shared->seqs[shared->count - 1]);
+            ok = false;
+        }
+        shared->seqs[shared->count] = entry.seq;
+        shared->refs[shared->count] = entry.spool_ref;
+        shared->count++;
+    }
+    return ok;
+}
+
+static bool report(const char *name, bool ok, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    printf("  %-8s %s  ", name, ok ? "ok  " : "FAIL");
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+    return ok;
+}
+
+// Run one boot in a child on the shared flash
+static bool boot(bool (*fn)(void))
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (!verbose) {
+            // The spool warns about every drop these checks cause on purpose
+            freopen("/dev/null", "w", stderr);
+        }
+        bool ok = telemetry_spool_init() && fn();
+        fflush(stdout);
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ============================================================================
+// Checks
+// ============================================================================
+
+static int ring_events(void)
+{
+    // Largest ring the partition could hold at the smallest record
+    return sectors * (SECTOR_SIZE / (RECORD_HEADER_SIZE + 4));
+}
+
+static bool wrap_offline(void)
+{
+    uint32_t appended = (uint32_t)(4 * ring_events());
+    for (uint32_t seq = 0; seq < appended; seq++) {
+        if (!append(seq)) {
+            return report("wrap", false, "append %lu failed", (unsigned long)seq);
+        }
+    }
+    flush();
+    int kept = telemetry_spool_count();
+    uint32_t lost = telemetry_spool_dropped();
+    bool ok = drain() && shared->count == kept && kept > 0 && (uint32_t)kept + lost == appended &&
+              shared->seqs[kept - 1] == appended - 1 && shared->seqs[0] == appended - (uint32_t)kept;
+    return report("wrap", ok, "appended %lu, kept %d (seq %lu..%lu), dropped %lu", (unsigned long)appended, kept,
+                  (unsigned long)(kept > 0 ? shared->seqs[0] : 0), (unsigned long)(appended - 1), (unsigned long)lost);
+}
+
+static bool wrap_reboot(void)
+{
+    int kept = shared->count;
+    uint32_t first = shared->seqs[0];
+    uint32_t next = telemetry_spool_next_seq();
+    bool ok = telemetry_spool_count() == kept && next == shared->seqs[kept - 1] + 1 &&
+              drain() && shared->count == kept && shared->seqs[0] == first;
+
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (int s = 0; s < sectors; s++) {
+        lo = shared->erases[s] < lo ? shared->erases[s] : lo;
+        hi = shared->erases[s] > hi ? shared->erases[s] : hi;
+    }
+    ok = ok && hi - lo <= 1;
+    return report("", ok, "after reboot: %d kept, next seq %lu, erases per sector %lu..%lu",
+                  telemetry_spool_count(), (unsigned long)next, (unsigned long)lo, (unsigned long)hi);
+}
+
+#define CONSUME_EVENTS 60
+
+static bool consume_ack(void)
+{
+    for (uint32_t seq = 0; seq < CONSUME_EVENTS; seq++) {
+        append(seq);
+    }
+    // Some records are still in the page buffer when acked, the rest in flash
+    if (!drain() || shared->count != CONSUME_EVENTS) {
+        return report("consume", false, "%d of %d read back", shared->count, CONSUME_EVENTS);
+    }
+    int acked = 0;
+    for (int n = 0; n < CONSUME_EVENTS; n++) {
+        int i = (int)(rng() % CONSUME_EVENTS);
+        if (!shared->acked[i]) {
+            shared->acked[i] = true;
+            telemetry_spool_consume(shared->refs[i], shared->seqs[i]);
+            acked++;
+        }
+        if (n == CONSUME_EVENTS / 2) {
+            flush();
+        }
+    }
+    flush();
+    bool ok = telemetry_spool_count() == CONSUME_EVENTS - acked;
+    return report("consume", ok, "%d appended, %d acked in random order, %d left",
+                  CONSUME_EVENTS, acked, telemetry_spool_count());
+}
+
+static bool consume_reboot(void)
+{
+    bool acked[CONSUME_EVENTS];
+    memcpy(acked, shared->acked, sizeof(acked));
+    int left = 0;
+    for (int i = 0; i < CONSUME_EVENTS; i++) {
+        left += !acked[i];
+    }
+
+    int count = telemetry_spool_count();
+    bool ok = drain() && count == left && shared->count == left;
+    for (int i = 0; ok && i < shared->count; i++) {
+        ok = shared->seqs[i] < CONSUME_EVENTS && !acked[shared->seqs[i]];
+    }
+    return report("", ok, "after reboot: %d left, %d read back, none acked", count, shared->count);
+}
+
+#define CRC_EVENTS 40
+#define CRC_BAD_BEFORE 5        // Damaged while powered off
+#define CRC_BAD_AFTER  7        // Damaged after mounting
+#define CRC_CUT_BYTES  100      // Into the page write after the last good one
+
+static void flip_bit(int i)
+{
+    shared->flash[shared->refs[i] + RECORD_HEADER_SIZE + event_len(shared->seqs[i]) / 2] ^= 0x10;
+}
+
+static bool crc_power_cut(void)
+{
+    for (uint32_t seq = 0; seq < CRC_EVENTS; seq++) {
+        append(seq);
+    }
+    flush();
+    if (!drain() || shared->count != CRC_EVENTS) {
+        return report("crc", false, "%d of %d read back", shared->count, CRC_EVENTS);
+    }
+
+    // Keep appending; power fails part-way through a page write
+    shared->cut_budget = CRC_CUT_BYTES;
+    for (uint32_t seq = CRC_EVENTS; !shared->power_lost; seq++) {
+        append(seq);
+        flush();
+    }
+    return true;
+}
+
+static bool crc_reboot(void)
+{
+    flip_bit(CRC_BAD_AFTER);
+
+    // Every undamaged record before the cut comes back, in order
+    bool ok = drain();
+    int expect = 0;
+    uint32_t extra = 0;
+    for (int i = 0; i < shared->count; i++) {
+        uint32_t seq = shared->seqs[i];
+        if (seq >= CRC_EVENTS) {
+            ok = ok && seq == CRC_EVENTS + extra;
+            extra++;
+        } else {
+            ok = ok && seq != CRC_BAD_BEFORE && seq != CRC_BAD_AFTER;
+            expect++;
+        }
+    }
+    ok = ok && expect == CRC_EVENTS - 2 && telemetry_spool_dropped() == 1;
+    report("crc", ok, "%d of %d intact records back, %lu written before the cut; "
+           "damaged seq %d and %d not delivered, %lu counted dropped", expect, CRC_EVENTS - 2,
+           (unsigned long)extra, CRC_BAD_BEFORE, CRC_BAD_AFTER, (unsigned long)telemetry_spool_dropped());
+
+    // Appending resumes past the torn record
+    uint32_t next = telemetry_spool_next_seq();
+    for (uint32_t seq = next; seq < next + 10; seq++) {
+        append(seq);
+    }
+    flush();
+    bool resumed = drain() && shared->count == 10 && shared->seqs[0] == next;
+    return report("", resumed, "%d of 10 appended after the reboot read back", shared->count) && ok;
+}
+
+#define RAM_EVENTS 20
+
+static bool ram_copy(void)
+{
+    telemetry_entry_t entry;
+    int copied = 0;
+    for (uint32_t seq = 0; seq < RAM_EVENTS; seq++) {
+        make_entry(&entry, seq);
+        if (telemetry_spool_append_imported(&entry, &shared->refs[seq])) {
+            shared->seqs[seq] = seq;
+            copied++;
+        }
+    }
+    bool ok = copied == RAM_EVENTS && !telemetry_spool_has_unread() && drain() && shared->count == 0;
+
+    // Acks for every other one
+    for (int i = 0; i < RAM_EVENTS; i += 2) {
+        shared->acked[i] = true;
+        telemetry_spool_consume(shared->refs[i], (uint32_t)i);
+    }
+    flush();
+    return report("ram", ok, "%d of %d copied, %d imported again", copied, RAM_EVENTS, shared->count);
+}
+
+static bool ram_reboot(void)
+{
+    // Unacked copies are unread after a reboot; a copy now would be imported twice
+    bool ok = drain() && shared->count == RAM_EVENTS / 2;
+    for (int i = 0; ok && i < shared->count; i++) {
+        ok = shared->seqs[i] == (uint32_t)(2 * i + 1);
+    }
+    int back = shared->count;
+
+    append(RAM_EVENTS);
+    telemetry_entry_t entry;
+    uint32_t ref;
+    make_entry(&entry, RAM_EVENTS + 1);
+    bool refused = !telemetry_spool_append_imported(&entry, &ref);
+    return report("", ok && refused, "after reboot: %d unacked back; copy behind an unread record %s",
+                  back, refused ? "refused" : "taken");
+}
+
+static bool erase_ahead(void)
+{
+    // Import the first records, then wrap until their sector is reclaimed
+    for (uint32_t seq = 0; seq < 10; seq++) {
+        append(seq);
+    }
+    drain();
+    int imported = shared->count;
+    uint32_t sector = shared->refs[0] / SECTOR_SIZE;
+
+    uint32_t inline_erases = 0;
+    bool tested = false, ignored = false, erased = false;
+    for (uint32_t seq = 10; seq < (uint32_t)(3 * ring_events()); seq++) {
+        uint32_t before = 0, after = 0;
+        for (int s = 0; s < sectors; s++) {
+            before += shared->erases[s];
+        }
+        append(seq);
+        for (int s = 0; s < sectors; s++) {
+            after += shared->erases[s];
+        }
+        inline_erases += after - before;
+
+        bool pending = telemetry_spool_reclaim();
+        if (pending && !tested && (shared->write_sector + 1) % (uint32_t)sectors == sector) {
+            // The MQTT handler acks imported records while the sector is erased
+            int count = telemetry_spool_count();
+            for (int i = 0; i < imported; i++) {
+                telemetry_spool_consume(shared->refs[i], shared->seqs[i]);
+            }
+            ignored = telemetry_spool_count() == count;
+            tested = true;
+            telemetry_spool_erase_ahead();
+            erased = sector_erased(sector);
+        } else if (pending) {
+            telemetry_spool_erase_ahead();
+        }
+    }
+    bool ok = inline_erases == 0 && tested && ignored && erased;
+    return report("erase", ok, "%lu erases inside append; acks for %d records in the reclaimed sector %s",
+                  (unsigned long)inline_erases, imported,
+                  !tested ? "never tried" : ignored && erased ? "ignored" : "applied");
+}
+
+int main(int argc, char **argv)
+{
+    bench_args_t args = { .seed = 1 };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            sectors = atoi(argv[++i]);
+        } else if (!bench_arg(argc, argv, &i, "sv", &args)) {
+            return bench_usage(argv[0], "[-s seed] [-k sectors] [-v]");
+        }
+    }
+    seed = args.seed;
+    verbose = args.verbose;
+    if (sectors < 3 || sectors > MAX_SECTORS) {
+        fprintf(stderr, "-k must be 3..%d\n", MAX_SECTORS);
+        return 2;
+    }
+
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return 2;
+    }
+    rng_seed(seed);
+
+    printf("%d sectors of %d bytes, payloads 1..%d bytes\n", sectors, SECTOR_SIZE, TELEMETRY_PAYLOAD_SIZE);
+    bool ok = true;
+
+    format_flash(sectors);
+    ok &= boot(wrap_offline) && boot(wrap_reboot);
+
+    format_flash(sectors);
+    ok &= boot(consume_ack) && boot(consume_reboot);
+
+    format_flash(sectors);
+    ok &= boot(crc_power_cut);
+    flip_bit(CRC_BAD_BEFORE);
+    shared->cut_budget = -1;
+    shared->power_lost = false;
+    ok &= boot(crc_reboot);
+
+    format_flash(sectors);
+    ok &= boot(ram_copy) && boot(ram_reboot);
+
+    format_flash(sectors);
+    ok &= boot(erase_ahead);
+
+    return ok ? 0 : 1;
+}
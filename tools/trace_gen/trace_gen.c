@@ -0,0 +1,296 @@
+// Write synthetic accelerometer traces for tools/trace_replay.
+//
+// Each trace is a safe at rest on a flat or 30 deg mount, 5 mg sensor
+// noise, and one scenario starting 2-5 s in, with amplitude (+-20%),
+// direction and timing drawn per run:
+//
+//   benign   rest       nothing happens
+//            tilt       floor settles, 20 deg over 4 s
+//            slam       nearby door slam, 9 Hz ringing
+//            truck      truck passing, 3 and 7 Hz rumble for 5 s
+//            footsteps  steps on the floor, two per second for 4 s
+//   tamper   lift       lifted (0.35 g up), then carried
+//            hammer     hammered on the side, three knocks per second
+//            tip        tipped over by 45 deg in 0.6 s
+//            drag       hauled along the floor in tugs for 1.5 s
+//
+// Files are named <benign|tamper>-<scenario>-<flat|30deg>-<run>.bin, in the
+// device's trace format (mpu6050.c), so the false alarm and detection rates
+// of a setting are e.g.
+//
+//   ./trace_gen -o traces
+//   ./trace_replay -q -t 19000 traces/benign-*.bin
+//   ./trace_replay -q -t 19000 traces/tamper-*.bin
+//   ./trace_replay -q -legacy -t 18000 traces/tamper-*.bin
+//
+// Build (from this directory):
+//
+//   gcc -O2 -Wall -I../common -I../../main/mpu6050 -o trace_gen trace_gen.c -lm
+//
+// Usage:
+//
+//   ./trace_gen [-s seed] [-n runs] [-t threshold] [-o dir]
+//
+//   -s  Random seed (default 1; same seed, same traces)
+//   -n  Runs per scenario and mount (default 20: 200 benign, 160 tamper)
+//   -t  Sensitivity recorded in the header (default 19000)
+//   -o  Output directory (default .; must exist)
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "mpu6050.h"
+
+#define SAMPLE_RATE_HZ 50
+#define TRACE_SAMPLES 512       // MPU6050_TRACE_SAMPLES default
+#define NOISE_MG 5
+#define LSB_PER_G 16384.0
+#define PI 3.14159265358979323846
+#define DEG (PI / 180.0)
+
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (rng() / 4294967296.0);
+}
+
+static double gaussian(void)
+{
+    // Box-Muller
+    double u = (rng() + 1.0) / 4294967297.0;
+    double v = rng() / 4294967296.0;
+    return sqrt(-2 * log(u)) * cos(2 * PI * v);
+}
+
+// One run of a scenario: t is seconds since it started (negative before)
+typedef struct {
+    double amp;             // Amplitude scale, 0.8-1.2
+    double dir;             // Horizontal direction of the motion, rad
+    double phase;           // Free phase for periodic motion
+} run_t;
+
+// Motion at time t: acceleration (g, world frame, z up) on top of gravity,
+// and tilt (rad, about the horizontal axis across dir)
+typedef void (*motion_fn)(const run_t *run, double t, double acc[3], double *tilt);
+
+static void horizontal(const run_t *run, double a, double acc[3])
+{
+    acc[0] += a * cos(run->dir);
+    acc[1] += a * sin(run->dir);
+}
+
+// Smooth 0 -> 1 over duration
+static double ramp(double t, double duration)
+{
+    if (t <= 0) {
+        return 0;
+    }
+    return (t >= duration) ? 1 : (1 - cos(PI * t / duration)) / 2;
+}
+
+static void motion_rest(const run_t *run, double t, double acc[3], double *tilt)
+{
+    (void)run; (void)t; (void)acc; (void)tilt;
+}
+
+static void motion_tilt(const run_t *run, double t, double acc[3], double *tilt)
+{
+    (void)acc;
+    *tilt = 20 * DEG * run->amp * ramp(t, 4.0);
+}
+
+static void motion_slam(const run_t *run, double t, double acc[3], double *tilt)
+{
+    (void)tilt;
+    if (t >= 0) {
+        double a = 0.12 * run->amp * exp(-t / 0.12) * sin(2 * PI * 9 * t + run->phase);
+        horizontal(run, a, acc);
+        acc[2] += 0.3 * a;
+    }
+}
+
+static void motion_truck(const run_t *run, double t, double acc[3], double *tilt)
+{
+    (void)tilt;
+    if (t >= 0 && t <= 5) {
+        double a = 0.05 * run->amp * sin(PI * t / 5);
+        double v = a * (0.6 * sin(2 * PI * 3.1 * t) + 0.4 * sin(2 * PI * 7.3 * t + run->phase));
+        acc[2] += v;
+        horizontal(run, 0.4 * v, acc);
+    }
+}
+
+static void motion_footsteps(const run_t *run, double t, double acc[3], double *tilt)
+{
+    (void)tilt;
+    if (t >= 0 && t <= 4) {
+        double since_step = fmod(t, 0.5);
+        acc[2] += 0.05 * run->amp * exp(-since_step / 0.04);
+    }
+}
+
+static void motion_lift(const run_t *run, double t, double acc[3], double *tilt)
+{
+    if (t >= 0 && t < 0.4) {
+        acc[2] += 0.35 * run->amp * sin(PI * t / 0.4);
+    } else if (t >= 0.4 && t <= 4) {
+        horizontal(run, 0.12 * run->amp * sin(2 * PI * 1.2 * t + run->phase), acc);
+        acc[2] += 0.08 * run->amp * sin(2 * PI * 2 * t);
+        *tilt = 10 * DEG * sin(2 * PI * 0.6 * t);
+    }
+}
+
+static void motion_hammer(const run_t *run, double t, double acc[3], double *tilt)
+{
+    (void)tilt;
+    if (t >= 0 && t <= 3) {
+        double since_knock = fmod(t + run->phase / (2 * PI) * 0.02, 0.33);
+        horizontal(run, 0.8 * run->amp * exp(-since_knock / 0.025), acc);
+    }
+}
+
+static void motion_tip(const run_t *run, double t, double acc[3], double *tilt)
+{
+    (void)acc;
+    *tilt = 45 * DEG * ramp(t, 0.6 / run->amp);
+}
+
+static void motion_drag(const run_t *run, double t, double acc[3], double *tilt)
+{
+    (void)tilt;
+    if (t >= 0 && t <= 1.5) {
+        // Hauled in tugs, twice a second: each jerks the safe into motion
+        // and it sticks against the floor again in between
+        double since_tug = fmod(t, 0.5);
+        horizontal(run, 0.34 * run->amp * (since_tug < 0.25 ? 1 : 0), acc);
+    }
+}
+
+typedef struct {
+    const char *name;
+    bool tamper;
+    motion_fn motion;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "rest",      false, motion_rest },
+    { "tilt",      false, motion_tilt },
+    { "slam",      false, motion_slam },
+    { "truck",     false, motion_truck },
+    { "footsteps", false, motion_footsteps },
+    { "lift",      true,  motion_lift },
+    { "hammer",    true,  motion_hammer },
+    { "tip",       true,  motion_tip },
+    { "drag",      true,  motion_drag },
+};
+
+#define SCENARIO_COUNT (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+// Rotate v by angle about the unit axis u (Rodrigues)
+static void rotate(double v[3], const double u[3], double angle)
+{
+    double c = cos(angle);
+    double s = sin(angle);
+    double dot = u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+    double cross[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+    for (int i = 0; i < 3; i++) {
+        v[i] = v[i] * c + cross[i] * s + u[i] * dot * (1 - c);
+    }
+}
+
+static void put_u16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t *p, uint32_t v) { put_u16(p, (uint16_t)v); put_u16(p + 2, (uint16_t)(v >> 16)); }
+
+static int16_t to_lsb(double g)
+{
+    double lsb = round(g * LSB_PER_G + gaussian() * NOISE_MG * LSB_PER_G / 1000);
+    return (int16_t)(lsb > 32767 ? 32767 : lsb < -32768 ? -32768 : lsb);
+}
+
+static bool write_trace(const char *path, const scenario_t *sc, double mount, int32_t threshold)
+{
+    run_t run = { .amp = uniform(0.8, 1.2), .dir = uniform(0, 2 * PI), .phase = uniform(0, 2 * PI) };
+    double start = uniform(2.0, 5.0);
+    uint32_t boot_ms = rng() % 3600000;
+    const double mount_axis[3] = { 1, 0, 0 };
+
+    uint8_t header[20] = { 0 };
+    put_u32(header, MPU6050_TRACE_MAGIC);
+    put_u16(header + 4, SAMPLE_RATE_HZ);
+    put_u16(header + 6, TRACE_SAMPLES);
+    put_u32(header + 8, (uint32_t)threshold);
+    put_u32(header + 12, boot_ms + (TRACE_SAMPLES - 1) * 1000 / SAMPLE_RATE_HZ);
+    put_u16(header + 16, MOVEMENT_HIT_COUNT);
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    fwrite(header, 1, sizeof(header), f);
+
+    for (int i = 0; i < TRACE_SAMPLES; i++) {
+        double t = (double)i / SAMPLE_RATE_HZ;
+        double acc[3] = { 0, 0, 0 };
+        double tilt = 0;
+        sc->motion(&run, t - start, acc, &tilt);
+
+        // Accelerometer reads +1 g up at rest: gravity plus motion, tilted
+        // with the safe, then seen through the mount
+        double v[3] = { acc[0], acc[1], 1 + acc[2] };
+        const double tilt_axis[3] = { -sin(run.dir), cos(run.dir), 0 };
+        rotate(v, tilt_axis, tilt);
+        rotate(v, mount_axis, mount);
+
+        uint8_t raw[8];
+        put_u16(raw, (uint16_t)to_lsb(v[0]));
+        put_u16(raw + 2, (uint16_t)to_lsb(v[1]));
+        put_u16(raw + 4, (uint16_t)to_lsb(v[2]));
+        put_u16(raw + 6, (uint16_t)(boot_ms + i * 1000 / SAMPLE_RATE_HZ));
+        fwrite(raw, 1, sizeof(raw), f);
+    }
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    bench_args_t args = { .seed = 1, .count = 20 };
+    int32_t threshold = 19000;
+    const char *dir = ".";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threshold = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (!bench_arg(argc, argv, &i, "sn", &args)) {
+            return bench_usage(argv[0], "[-s seed] [-n runs] [-t threshold] [-o dir]");
+        }
+    }
+
+    static const struct { const char *name; double angle; } mounts[] = {
+        { "flat", 0 },
+        { "30deg", 30 * DEG },
+    };
+
+    rng_seed(args.seed);
+    int written = 0;
+    for (int s = 0; s < SCENARIO_COUNT; s++) {
+        for (int m = 0; m < 2; m++) {
+            for (int r = 0; r < args.count; r++) {
+                char path[512];
+                snprintf(path, sizeof(path), "%s/%s-%s-%s-%02d.bin", dir,
+                         scenarios[s].tamper ? "tamper" : "benign", scenarios[s].name, mounts[m].name, r);
+                if (!write_trace(path, &scenarios[s], mounts[m].angle, threshold)) {
+                    return 1;
+                }
+                written++;
+            }
+        }
+    }
+    printf("%d traces (%d samples @ %d Hz) in %s\n", written, TRACE_SAMPLES, SAMPLE_RATE_HZ, dir);
+    return 0;
+}
@@ -0,0 +1,321 @@
+// Replay accelerometer alarm traces through the tamper detector on a PC.
+//
+// Traces are published by the device on MQTT_TOPIC_TRACE when movement is
+// confirmed (see MPU6050_TRACE_SAMPLES in config.h). Capture one with e.g.
+//
+//   mosquitto_sub -h <broker> -t smartsafe/smartsafe01/telemetry/trace -C 1 > alarm.bin
+//
+// tools/trace_gen writes synthetic traces (benign and tamper scenarios) for
+// comparing settings and detectors.
+//
+// Build (from this directory; uses the device's own detector source):
+//
+//   gcc -O2 -Wall -I../common -I../../main/mpu6050 -o trace_replay trace_replay.c ../../main/mpu6050/tamper_detector.c -lm
+//
+// Usage:
+//
+//   ./trace_replay [-t threshold] [-legacy] [-q] [-v] trace.bin...
+//
+//   -t       Sensitivity to replay with (17000-45000, default: the one in the trace)
+//   -legacy  Replay the detector the device had before tamper_detector:
+//            |a|^2, gravity included, against threshold^2
+//   -q       Only the summary line
+//   -v       Print every sample as CSV (index, t_ms, x, y, z, score_mg, hits;
+//            with -legacy the score is |a| in mg)
+//
+// For each trace prints the detections, the latency from movement onset
+// (first sample deviating from the initial resting vector by more than the
+// threshold) to the first detection, and the detector cost per sample. Ends
+// with the number of traces that had a detection.
+
+#define _POSIX_C_SOURCE 199309L
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "mpu6050.h"
+#include "tamper_detector.h"
+
+#define HEADER_SIZE 20
+#define SAMPLE_SIZE 8
+#define REST_SAMPLES 16     // Samples averaged for the onset reference
+#define BENCH_SAMPLES 2000000
+#define LSB_PER_G 16384
+
+typedef struct {
+    int16_t x, y, z;
+    uint32_t t_ms;          // Unwrapped, relative to the first sample
+} sample_t;
+
+typedef struct {
+    uint16_t sample_rate_hz;
+    uint16_t count;
+    int32_t threshold;
+    uint32_t trigger_ms;
+    uint16_t hit_count;
+    sample_t *samples;
+} trace_t;
+
+static uint16_t get_u16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_u32(const uint8_t *p) { return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16); }
+
+static bool load_trace(const char *path, trace_t *trace)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    uint8_t header[HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) || get_u32(header) != MPU6050_TRACE_MAGIC) {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        fclose(f);
+        return false;
+    }
+    trace->sample_rate_hz = get_u16(header + 4);
+    trace->count = get_u16(header + 6);
+    trace->threshold = (int32_t)get_u32(header + 8);
+    trace->trigger_ms = get_u32(header + 12);
+    trace->hit_count = get_u16(header + 16);
+    trace->samples = calloc(trace->count ? trace->count : 1, sizeof(sample_t));
+
+    uint32_t t = 0;
+    uint16_t prev = 0;
+    for (int i = 0; i < trace->count; i++) {
+        uint8_t raw[SAMPLE_SIZE];
+        if (fread(raw, 1, sizeof(raw), f) != sizeof(raw)) {
+            fprintf(stderr, "%s: truncated after %d of %d samples\n", path, i, trace->count);
+            trace->count = (uint16_t)i;
+            break;
+        }
+        uint16_t t16 = get_u16(raw + 6);
+        t += (i == 0) ? 0 : (uint16_t)(t16 - prev);   // 16-bit ms counter, wrap-safe
+        prev = t16;
+        trace->samples[i] = (sample_t){ (int16_t)get_u16(raw), (int16_t)get_u16(raw + 2),
+                                        (int16_t)get_u16(raw + 4), t };
+    }
+    fclose(f);
+    return trace->count > 0 && trace->sample_rate_hz > 0;
+}
+
+// First sample whose deviation from the resting vector exceeds threshold_mg
+static int find_onset(const trace_t *trace, int32_t threshold_mg)
+{
+    int rest = trace->count < REST_SAMPLES ? trace->count : REST_SAMPLES;
+    int64_t mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < rest; i++) {
+        mean[0] += trace->samples[i].x;
+        mean[1] += trace->samples[i].y;
+        mean[2] += trace->samples[i].z;
+    }
+    int64_t limit = (int64_t)threshold_mg * 16384 / 1000;
+    for (int i = 0; i < trace->count; i++) {
+        int64_t dx = trace->samples[i].x - mean[0] / rest;
+        int64_t dy = trace->samples[i].y - mean[1] / rest;
+        int64_t dz = trace->samples[i].z - mean[2] / rest;
+        if (dx * dx + dy * dy + dz * dz > limit * limit) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// ============================================================================
+// Detectors
+// ============================================================================
+
+typedef struct {
+    bool legacy;
+    tamper_detector_t det;
+    int legacy_hits;
+    int32_t threshold;      // Legacy LSB
+    int32_t threshold_mg;
+    int hit_count;
+} detector_t;
+
+static void detector_init(detector_t *d, const trace_t *trace, int32_t threshold, bool legacy)
+{
+    memset(d, 0, sizeof(*d));
+    d->legacy = legacy;
+    d->threshold = threshold;
+    d->threshold_mg = tamper_threshold_mg(threshold);
+    d->hit_count = trace->hit_count ? trace->hit_count : MOVEMENT_HIT_COUNT;
+    tamper_detector_init(&d->det, trace->sample_rate_hz);
+}
+
+// The old movement_feed(): |a|^2 against threshold^2, same hit counter
+static bool legacy_feed(detector_t *d, const sample_t *s)
+{
+    int64_t magnitude_sq = (int64_t)s->x * s->x + (int64_t)s->y * s->y + (int64_t)s->z * s->z;
+    if (magnitude_sq > (int64_t)d->threshold * d->threshold) {
+        if (d->legacy_hits < d->hit_count) {
+            d->legacy_hits++;
+        }
+    } else if (d->legacy_hits > 0) {
+        d->legacy_hits--;
+    }
+    if (d->legacy_hits >= d->hit_count) {
+        d->legacy_hits = 0;
+        return true;
+    }
+    return false;
+}
+
+// One sample; true on a confirmed movement. *score_mg (if not NULL) gets the
+// tamper score, or |a| in mg for the legacy detector
+static bool detector_feed(detector_t *d, const sample_t *s, int32_t *score_mg)
+{
+    if (d->legacy) {
+        bool hit = legacy_feed(d, s);
+        if (score_mg) {
+            double magnitude = sqrt((double)s->x * s->x + (double)s->y * s->y + (double)s->z * s->z);
+            *score_mg = (int32_t)(magnitude * 1000 / LSB_PER_G);
+        }
+        return hit;
+    }
+    int32_t score = tamper_detector_update(&d->det, s->x, s->y, s->z);
+    if (score_mg) {
+        *score_mg = score;
+    }
+    return tamper_detector_confirm(&d->det, score, d->threshold_mg, d->hit_count);
+}
+
+static int detector_hits(const detector_t *d)
+{
+    return d->legacy ? d->legacy_hits : d->det.hits;
+}
+
+// Detector cost per sample: the trace replayed until BENCH_SAMPLES were fed
+static void bench(const trace_t *trace, int32_t threshold, bool legacy)
+{
+    detector_t d;
+    detector_init(&d, trace, threshold, legacy);
+    int detections = 0;
+    long fed = 0;
+
+    double t0 = now_ns();
+    uint64_t c0 = cycles();
+    while (fed < BENCH_SAMPLES) {
+        for (int i = 0; i < trace->count; i++) {
+            detections += detector_feed(&d, &trace->samples[i], NULL);
+        }
+        fed += trace->count;
+    }
+    uint64_t c1 = cycles();
+    double t1 = now_ns();
+
+    printf("  cost: %.1f ns/sample", (t1 - t0) / fed);
+    if (c1 != c0) {
+        printf(", %.0f host cycles/sample", (double)(c1 - c0) / fed);
+    }
+    printf(" (%d detections while timing)\n", detections);
+}
+
+// Returns true if the trace had a detection
+static bool replay(const char *path, const trace_t *trace, int32_t threshold, bool legacy, bool quiet, bool verbose)
+{
+    detector_t d;
+    detector_init(&d, trace, threshold, legacy);
+    double ms_per_sample = 1000.0 / trace->sample_rate_hz;
+
+    if (!quiet) {
+        printf("%s: %d samples @ %u Hz (%.1f s), threshold %ld (%ld mg%s), %d hits, device trigger at %lu ms\n",
+               path, trace->count, trace->sample_rate_hz, trace->count * ms_per_sample / 1000.0,
+               (long)threshold, (long)d.threshold_mg, legacy ? " above 1 g, legacy |a| detector" : "",
+               d.hit_count, (unsigned long)trace->trigger_ms);
+    }
+
+    int first_detection = -1;
+    int detections = 0;
+    int32_t max_score = 0;
+
+    if (verbose) {
+        printf("index,t_ms,x,y,z,score_mg,hits\n");
+    }
+    for (int i = 0; i < trace->count; i++) {
+        const sample_t *s = &trace->samples[i];
+        int32_t score;
+        bool hit = detector_feed(&d, s, &score);
+        if (verbose) {
+            printf("%d,%lu,%d,%d,%d,%ld,%d\n", i, (unsigned long)s->t_ms, s->x, s->y, s->z,
+                   (long)score, hit ? d.hit_count : detector_hits(&d));
+        }
+        if (score > max_score) {
+            max_score = score;
+        }
+        if (hit) {
+            detections++;
+            if (first_detection < 0) {
+                first_detection = i;
+            }
+            if (!quiet) {
+                printf("  detection at sample %d (t=%lu ms, score %ld mg)\n", i, (unsigned long)s->t_ms, (long)score);
+            }
+        }
+    }
+    if (quiet) {
+        return detections > 0;
+    }
+
+    printf("  %d detection(s), max score %ld mg", detections, (long)max_score);
+    int onset = find_onset(trace, d.threshold_mg);
+    if (first_detection >= 0 && onset >= 0 && onset <= first_detection) {
+        printf(", onset at sample %d, latency to detect %lu ms",
+               onset, (unsigned long)(trace->samples[first_detection].t_ms - trace->samples[onset].t_ms));
+    }
+    if (first_detection < 0) {
+        printf(" (device alarmed at the last sample; the detector starts cold here)");
+    }
+    printf("\n");
+
+    bench(trace, threshold, legacy);
+    return detections > 0;
+}
+
+int main(int argc, char **argv)
+{
+    int32_t threshold = 0;
+    bool legacy = false;
+    bool quiet = false;
+    bool verbose = false;
+    int first_file = 1;
+
+    for (; first_file < argc && argv[first_file][0] == '-'; first_file++) {
+        if (strcmp(argv[first_file], "-t") == 0 && first_file + 1 < argc) {
+            threshold = atoi(argv[++first_file]);
+        } else if (strcmp(argv[first_file], "-legacy") == 0) {
+            legacy = true;
+        } else if (strcmp(argv[first_file], "-q") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[first_file], "-v") == 0) {
+            verbose = true;
+        } else {
+            first_file = argc;
+            break;
+        }
+    }
+    if (first_file >= argc) {
+        fprintf(stderr, "usage: %s [-t threshold] [-legacy] [-q] [-v] trace.bin...\n", argv[0]);
+        return 2;
+    }
+
+    int failed = 0;
+    int replayed = 0;
+    int detected = 0;
+    for (int i = first_file; i < argc; i++) {
+        trace_t trace;
+        if (!load_trace(argv[i], &trace)) {
+            failed++;
+            continue;
+        }
+        detected += replay(argv[i], &trace, threshold ? threshold : trace.threshold, legacy, quiet, verbose);
+        replayed++;
+        free(trace.samples);
+    }
+    printf("%d/%d traces with a detection (%s detector%s)\n", detected, replayed,
+           legacy ? "legacy |a|" : "tamper", threshold ? "" : ", thresholds from the traces");
+    return failed ? 1 : 0;
+}